@@ -15,6 +15,7 @@ namespace Wolf
 		VkAttachmentStoreOp storeOperation;
 
 		VkImageUsageFlags usageType{};
+		uint32_t arrayLayers = 1; // > 1 enables multiview, one view per layer
 
 		Image* image = nullptr;
 
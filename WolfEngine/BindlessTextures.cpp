@@ -0,0 +1,134 @@
+#include "BindlessTextures.h"
+#include "Debug.h"
+
+#include <array>
+
+Wolf::BindlessTextures::BindlessTextures(VkDevice device, uint32_t maxTextureCount)
+{
+	m_device = device;
+	m_maxTextureCount = maxTextureCount;
+
+	// Layout
+	std::array<VkDescriptorSetLayoutBinding, 2> bindings{};
+	bindings[0].binding = 0;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_ALL;
+
+	// Variable count binding must be the last one
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	bindings[1].descriptorCount = m_maxTextureCount;
+	bindings[1].stageFlags = VK_SHADER_STAGE_ALL;
+
+	// Slots added after recording are unused by pending command buffers
+	std::array<VkDescriptorBindingFlagsEXT, 2> bindingFlags = { VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT,
+		VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT |
+		VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT_EXT };
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+	bindingFlagsInfo.pBindingFlags = bindingFlags.data();
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &bindingFlagsInfo;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+	layoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS)
+		Debug::sendError("Error : create bindless descriptor set layout");
+
+	// Pool, only holds the table
+	std::array<VkDescriptorPoolSize, 2> poolSizes{};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+	poolSizes[0].descriptorCount = 1;
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	poolSizes[1].descriptorCount = m_maxTextureCount;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = 1;
+
+	if (vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS)
+		Debug::sendError("Error : create bindless descriptor pool");
+
+	// Set
+	VkDescriptorSetVariableDescriptorCountAllocateInfoEXT variableCountInfo = {};
+	variableCountInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT;
+	variableCountInfo.descriptorSetCount = 1;
+	variableCountInfo.pDescriptorCounts = &m_maxTextureCount;
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.pNext = &variableCountInfo;
+	allocInfo.descriptorPool = m_descriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &m_descriptorSetLayout;
+
+	if (vkAllocateDescriptorSets(m_device, &allocInfo, &m_descriptorSet) != VK_SUCCESS)
+		Debug::sendError("Error : allocate bindless descriptor set");
+}
+
+Wolf::BindlessTextures::~BindlessTextures()
+{
+	vkDestroyDescriptorPool(m_device, m_descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, nullptr);
+}
+
+int Wolf::BindlessTextures::addTextures(const std::vector<Image*>& images, uint32_t alignment)
+{
+	const uint32_t firstTexture = (m_textureCount + alignment - 1) / alignment * alignment;
+	if (images.empty())
+		return static_cast<int>(firstTexture);
+	if (firstTexture + images.size() > m_maxTextureCount)
+	{
+		Debug::sendError("Bindless texture table is full (" + std::to_string(m_maxTextureCount) + " textures)");
+		return -1;
+	}
+
+	std::vector<VkDescriptorImageInfo> descriptorImageInfos(images.size());
+	for (size_t i(0); i < images.size(); ++i)
+	{
+		descriptorImageInfos[i].imageLayout = images[i]->getImageLayout();
+		descriptorImageInfos[i].imageView = images[i]->getImageView();
+		descriptorImageInfos[i].sampler = VK_NULL_HANDLE;
+	}
+
+	VkWriteDescriptorSet descriptorWrite = {};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = m_descriptorSet;
+	descriptorWrite.dstBinding = 1;
+	descriptorWrite.dstArrayElement = firstTexture;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	descriptorWrite.descriptorCount = static_cast<uint32_t>(descriptorImageInfos.size());
+	descriptorWrite.pImageInfo = descriptorImageInfos.data();
+
+	vkUpdateDescriptorSets(m_device, 1, &descriptorWrite, 0, nullptr);
+
+	m_textureCount = firstTexture + static_cast<uint32_t>(images.size());
+
+	return static_cast<int>(firstTexture);
+}
+
+void Wolf::BindlessTextures::setSampler(Sampler* sampler)
+{
+	VkDescriptorImageInfo descriptorImageInfo = {};
+	descriptorImageInfo.sampler = sampler->getSampler();
+
+	VkWriteDescriptorSet descriptorWrite = {};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = m_descriptorSet;
+	descriptorWrite.dstBinding = 0;
+	descriptorWrite.dstArrayElement = 0;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pImageInfo = &descriptorImageInfo;
+
+	vkUpdateDescriptorSets(m_device, 1, &descriptorWrite, 0, nullptr);
+}
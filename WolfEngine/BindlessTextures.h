@@ -0,0 +1,35 @@
+#pragma once
+
+#include "VulkanElement.h"
+#include "Image.h"
+#include "Sampler.h"
+
+namespace Wolf
+{
+	// Global texture table (descriptor indexing), bound at set BINDLESS_DESCRIPTOR_SET by renderers created with useBindlessTextures.
+	// binding 0 = sampler, binding 1 = sampled images (partially bound, update after bind, variable count).
+	// Textures are referenced by index: adding textures doesn't create layouts or pools and doesn't require re-recording
+	constexpr uint32_t BINDLESS_DESCRIPTOR_SET = 1;
+
+	class BindlessTextures : public VulkanElement
+	{
+	public:
+		BindlessTextures(VkDevice device, uint32_t maxTextureCount = 4096);
+		~BindlessTextures();
+
+		// Returns the index of the first texture (multiple of alignment), -1 if the table is full
+		int addTextures(const std::vector<Image*>& images, uint32_t alignment = 1);
+		void setSampler(Sampler* sampler);
+
+		VkDescriptorSetLayout getDescriptorSetLayout() const { return m_descriptorSetLayout; }
+		VkDescriptorSet getDescriptorSet() const { return m_descriptorSet; }
+		uint32_t getTextureCount() const { return m_textureCount; }
+
+	private:
+		uint32_t m_maxTextureCount;
+		uint32_t m_textureCount = 0;
+
+		VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+	};
+}
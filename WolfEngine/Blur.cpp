@@ -1,16 +1,31 @@
 #include "Blur.h"
 
-Wolf::Blur::Blur(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, int commandBufferID, Image* inputImage, Image* depthImage)
+Wolf::Blur::Blur(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, int commandBufferID, Image* inputImage, Image* depthImage, uint32_t levelCount,
+	bool singleDispatch, bool mipmappedOutput, uint32_t groupSize)
 {
 	m_inputImage = inputImage;
 	m_commandBufferID = commandBufferID;
+	m_singleDispatch = singleDispatch;
 
-	// Downscale
-	m_downscaledImages.resize(3);
-	m_downscaleComputePasses.resize(3);
-	m_downscaleCommandBufferIDs.resize(3);
-	VkExtent2D extent = { inputImage->getExtent().width / 2, inputImage->getExtent().height / 2 };
-	for(int i(0);  i < 3; ++i)
+	// Levels
+	m_levelCount = glm::max(levelCount, 1u);
+	if (m_singleDispatch)
+	{
+		uint32_t maxLevelCount = 1;
+		while ((groupSize >> maxLevelCount) > 0)
+			maxLevelCount++;
+		if (m_levelCount > maxLevelCount)
+		{
+			Debug::sendWarning("Blur: " + std::to_string(m_levelCount) + " levels requested, a single dispatch with groups of " + std::to_string(groupSize) +
+				" can only build " + std::to_string(maxLevelCount));
+			m_levelCount = maxLevelCount;
+		}
+	}
+	while (m_levelCount > 1 && ((inputImage->getExtent().width >> m_levelCount) == 0 || (inputImage->getExtent().height >> m_levelCount) == 0))
+		m_levelCount--;
+
+	const VkExtent2D firstLevelExtent = { inputImage->getExtent().width / 2, inputImage->getExtent().height / 2 };
+	auto createStorageImage = [&](VkExtent2D extent, uint32_t mipLevels)
 	{
 		Image::CreateImageInfo createImageInfo;
 		createImageInfo.extent = { extent.width, extent.height, 1 };
@@ -18,10 +33,49 @@ Wolf::Blur::Blur(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, int com
 		createImageInfo.format = inputImage->getFormat();
 		createImageInfo.sampleCount = VK_SAMPLE_COUNT_1_BIT;
 		createImageInfo.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
-		createImageInfo.mipLevels = 1;
-		m_downscaledImages[i] = engineInstance->createImage({ createImageInfo });
-		m_downscaledImages[i]->setImageLayout(VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+		createImageInfo.mipLevels = mipLevels;
+		Image* image = engineInstance->createImage(createImageInfo);
+		image->setImageLayout(VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		return image;
+	};
+
+	if (mipmappedOutput)
+		m_mipmappedImage = createStorageImage(firstLevelExtent, m_levelCount);
+	else
+	{
+		m_downscaledImages.resize(m_levelCount);
+		VkExtent2D extent = firstLevelExtent;
+		for (uint32_t i(0); i < m_levelCount; ++i)
+		{
+			m_downscaledImages[i] = createStorageImage(extent, 1);
+
+			extent.width /= 2;
+			extent.height /= 2;
+		}
+	}
+
+	const VkExtent2D lastLevelExtent = { firstLevelExtent.width >> (m_levelCount - 1), firstLevelExtent.height >> (m_levelCount - 1) };
+	m_downscaledBlurredImage = createStorageImage(lastLevelExtent, 1);
+	m_downscaledBlurredImage2 = createStorageImage(lastLevelExtent, 1);
+
+	Image* lastLevel = m_mipmappedImage ? m_mipmappedImage : m_downscaledImages.back();
+	const uint32_t lastLevelMip = m_mipmappedImage ? m_levelCount - 1 : 0;
 
+	if (m_singleDispatch)
+	{
+		createSingleDispatch(engineInstance, scene, groupSize);
+		createBlur(engineInstance, scene, lastLevel, lastLevelMip, m_commandBufferID, m_commandBufferID, groupSize);
+
+		return;
+	}
+
+	// Downscale, one dispatch and command buffer per level
+	m_downscaleComputePasses.resize(m_levelCount);
+	m_downscaleCommandBufferIDs.resize(m_levelCount);
+	VkExtent2D extent = firstLevelExtent;
+	for(uint32_t i(0);  i < m_levelCount; ++i)
+	{
 		Scene::CommandBufferCreateInfo commandBufferCreateInfo;
 		commandBufferCreateInfo.finalPipelineStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 		commandBufferCreateInfo.commandType = Scene::CommandType::COMPUTE;
@@ -29,15 +83,21 @@ Wolf::Blur::Blur(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, int com
 
 		Scene::ComputePassCreateInfo downscaleComputePassCreateInfo;
 		downscaleComputePassCreateInfo.extent = extent;
-		downscaleComputePassCreateInfo.dispatchGroups = { 16, 16, 1 };
+		downscaleComputePassCreateInfo.dispatchGroups = { groupSize, groupSize, 1 };
 		downscaleComputePassCreateInfo.computeShaderPath = "Shaders/Blur/downscale.spv";
 		downscaleComputePassCreateInfo.commandBufferID = m_downscaleCommandBufferIDs[i];
 
 		DescriptorSetGenerator descriptorSetGenerator;
-		descriptorSetGenerator.addImages({ i == 0 ? inputImage : m_downscaledImages[i - 1] }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT,
-			0); // Input
-		descriptorSetGenerator.addImages({ m_downscaledImages[i] }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT,
-			1); // Output
+		if (i == 0)
+			descriptorSetGenerator.addImages({ inputImage }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0); // Input
+		else if (m_mipmappedImage)
+			descriptorSetGenerator.addImageMipLevels(m_mipmappedImage, i - 1, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0);
+		else
+			descriptorSetGenerator.addImages({ m_downscaledImages[i - 1] }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0);
+		if (m_mipmappedImage) // Output
+			descriptorSetGenerator.addImageMipLevels(m_mipmappedImage, i, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1);
+		else
+			descriptorSetGenerator.addImages({ m_downscaledImages[i] }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1);
 
 		downscaleComputePassCreateInfo.descriptorSetCreateInfo = descriptorSetGenerator.getDescritorSetCreateInfo();
 
@@ -45,69 +105,113 @@ Wolf::Blur::Blur(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, int com
 
 		extent.width /= 2;
 		extent.height /= 2;
-	}	
+	}
 
-	// Blur
-	{
-		Image::CreateImageInfo createImageInfo;
-		createImageInfo.extent = { m_downscaledImages.back()->getExtent().width, m_downscaledImages.back()->getExtent().height, 1 };
-		createImageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT;
-		createImageInfo.format = inputImage->getFormat();
-		createImageInfo.sampleCount = VK_SAMPLE_COUNT_1_BIT;
-		createImageInfo.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
-		createImageInfo.mipLevels = 1;
-		m_downscaledBlurredImage = engineInstance->createImage(createImageInfo);
-		m_downscaledBlurredImage->setImageLayout(VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	Scene::CommandBufferCreateInfo commandBufferCreateInfo;
+	commandBufferCreateInfo.finalPipelineStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	commandBufferCreateInfo.commandType = Scene::CommandType::COMPUTE;
+	m_horizontalBlurCommandBuffer = scene->addCommandBuffer(commandBufferCreateInfo);
+	m_verticalBlurCommandBuffer = scene->addCommandBuffer(commandBufferCreateInfo);
 
-		Scene::CommandBufferCreateInfo commandBufferCreateInfo;
-		commandBufferCreateInfo.finalPipelineStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
-		commandBufferCreateInfo.commandType = Scene::CommandType::COMPUTE;
-		m_horizontalBlurCommandBuffer = scene->addCommandBuffer(commandBufferCreateInfo);
+	createBlur(engineInstance, scene, lastLevel, lastLevelMip, m_horizontalBlurCommandBuffer, m_verticalBlurCommandBuffer, groupSize);
+}
 
-		// Horizontal
+void Wolf::Blur::createSingleDispatch(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, uint32_t groupSize)
+{
+	// Each thread averages a 2x2 quad of the input for level 0, the group then reduces its groupSize x groupSize tile in shared memory
+	// (or with quad subgroup operations) down to one texel, writing every level on the way
+	Scene::ComputePassCreateInfo downscaleComputePassCreateInfo;
+	downscaleComputePassCreateInfo.name = "Blur downscale chain";
+	downscaleComputePassCreateInfo.extent = { m_inputImage->getExtent().width / 2, m_inputImage->getExtent().height / 2 };
+	downscaleComputePassCreateInfo.dispatchGroups = { groupSize, groupSize, 1 };
+	downscaleComputePassCreateInfo.computeShaderPath = "Shaders/Blur/downscaleChain.spv";
+	downscaleComputePassCreateInfo.specializationConstants = { groupSize, m_levelCount, engineInstance->getHardwareCapabilities().subgroupQuadAvailable ? 1u : 0u };
+	downscaleComputePassCreateInfo.commandBufferID = m_commandBufferID;
+	downscaleComputePassCreateInfo.beforeRecord = computeBarrier; // input is written by the previous pass of the command buffer
+	downscaleComputePassCreateInfo.afterRecord = computeBarrier;
+
+	DescriptorSetGenerator descriptorSetGenerator;
+	descriptorSetGenerator.addImages({ m_inputImage }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0);
+	if (m_mipmappedImage)
+		descriptorSetGenerator.addImageMipLevels(m_mipmappedImage, 0, m_levelCount, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1);
+	else
+		descriptorSetGenerator.addImages(m_downscaledImages, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1);
+
+	downscaleComputePassCreateInfo.descriptorSetCreateInfo = descriptorSetGenerator.getDescritorSetCreateInfo();
+
+	m_downscaleComputePasses = { scene->addComputePass(downscaleComputePassCreateInfo) };
+}
+
+void Wolf::Blur::createBlur(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, Image* lastLevel, uint32_t lastLevelMip, int horizontalCommandBufferID,
+	int verticalCommandBufferID, uint32_t groupSize)
+{
+	const VkExtent2D extent = { m_downscaledBlurredImage->getExtent().width, m_downscaledBlurredImage->getExtent().height };
+
+	// Single dispatch mode: one group per line segment, the segment and its apron are loaded once in shared memory
+	const uint32_t tileSize = groupSize * groupSize;
+
+	// Horizontal
+	{
+		Scene::ComputePassCreateInfo horizontalBlurComputePassCreateInfo;
+		horizontalBlurComputePassCreateInfo.name = "Blur horizontal";
+		horizontalBlurComputePassCreateInfo.extent = extent;
+		horizontalBlurComputePassCreateInfo.commandBufferID = horizontalCommandBufferID;
+		if (m_singleDispatch)
 		{
-			Scene::ComputePassCreateInfo horizontalBlurComputePassCreateInfo;
-			horizontalBlurComputePassCreateInfo.extent = { m_downscaledImages.back()->getExtent().width, m_downscaledImages.back()->getExtent().height };
-			horizontalBlurComputePassCreateInfo.dispatchGroups = { 16, 16, 1 };
+			horizontalBlurComputePassCreateInfo.dispatchGroups = { tileSize, 1, 1 };
+			horizontalBlurComputePassCreateInfo.computeShaderPath = "Shaders/Blur/horizontalTile.spv";
+			horizontalBlurComputePassCreateInfo.specializationConstants = { tileSize };
+			horizontalBlurComputePassCreateInfo.afterRecord = computeBarrier;
+		}
+		else
+		{
+			horizontalBlurComputePassCreateInfo.dispatchGroups = { groupSize, groupSize, 1 };
 			horizontalBlurComputePassCreateInfo.computeShaderPath = "Shaders/Blur/horizontal.spv";
-			horizontalBlurComputePassCreateInfo.commandBufferID = m_horizontalBlurCommandBuffer;
+		}
 
-			DescriptorSetGenerator descriptorSetGenerator;
-			descriptorSetGenerator.addImages({ m_downscaledImages.back() }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0);
-			descriptorSetGenerator.addImages({ m_downscaledBlurredImage }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1);
+		DescriptorSetGenerator descriptorSetGenerator;
+		descriptorSetGenerator.addImageMipLevels(lastLevel, lastLevelMip, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0);
+		descriptorSetGenerator.addImages({ m_downscaledBlurredImage }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1);
 
-			horizontalBlurComputePassCreateInfo.descriptorSetCreateInfo = descriptorSetGenerator.getDescritorSetCreateInfo();
+		horizontalBlurComputePassCreateInfo.descriptorSetCreateInfo = descriptorSetGenerator.getDescritorSetCreateInfo();
 
-			m_horizontalBlurComputePass = scene->addComputePass(horizontalBlurComputePassCreateInfo);
-		}
+		m_horizontalBlurComputePass = scene->addComputePass(horizontalBlurComputePassCreateInfo);
+	}
 
-		// Vertical
+	// Vertical
+	{
+		Scene::ComputePassCreateInfo verticalBlurComputePassCreateInfo;
+		verticalBlurComputePassCreateInfo.name = "Blur vertical";
+		verticalBlurComputePassCreateInfo.extent = extent;
+		verticalBlurComputePassCreateInfo.commandBufferID = verticalCommandBufferID;
+		if (m_singleDispatch)
 		{
-			Image::CreateImageInfo createImageInfo;
-			createImageInfo.extent = { m_downscaledImages.back()->getExtent().width, m_downscaledImages.back()->getExtent().height, 1 };
-			createImageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT;
-			createImageInfo.format = inputImage->getFormat();
-			createImageInfo.sampleCount = VK_SAMPLE_COUNT_1_BIT;
-			createImageInfo.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
-			createImageInfo.mipLevels = 1;
-			m_downscaledBlurredImage2 = engineInstance->createImage(createImageInfo);
-			m_downscaledBlurredImage2->setImageLayout(VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
-
-			m_verticalBlurCommandBuffer = scene->addCommandBuffer(commandBufferCreateInfo);
-
-			Scene::ComputePassCreateInfo verticalBlurComputePassCreateInfo;
-			verticalBlurComputePassCreateInfo.extent = { m_downscaledImages.back()->getExtent().width, m_downscaledImages.back()->getExtent().height };
-			verticalBlurComputePassCreateInfo.dispatchGroups = { 16, 16, 1 };
+			verticalBlurComputePassCreateInfo.dispatchGroups = { 1, tileSize, 1 };
+			verticalBlurComputePassCreateInfo.computeShaderPath = "Shaders/Blur/verticalTile.spv";
+			verticalBlurComputePassCreateInfo.specializationConstants = { tileSize };
+		}
+		else
+		{
+			verticalBlurComputePassCreateInfo.dispatchGroups = { groupSize, groupSize, 1 };
 			verticalBlurComputePassCreateInfo.computeShaderPath = "Shaders/Blur/vertical.spv";
-			verticalBlurComputePassCreateInfo.commandBufferID = m_verticalBlurCommandBuffer;
+		}
 
-			DescriptorSetGenerator descriptorSetGenerator;
-			descriptorSetGenerator.addImages({ m_downscaledBlurredImage }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0);
-			descriptorSetGenerator.addImages({ m_downscaledBlurredImage2 }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1);
+		DescriptorSetGenerator descriptorSetGenerator;
+		descriptorSetGenerator.addImages({ m_downscaledBlurredImage }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0);
+		descriptorSetGenerator.addImages({ m_downscaledBlurredImage2 }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1);
 
-			verticalBlurComputePassCreateInfo.descriptorSetCreateInfo = descriptorSetGenerator.getDescritorSetCreateInfo();
+		verticalBlurComputePassCreateInfo.descriptorSetCreateInfo = descriptorSetGenerator.getDescritorSetCreateInfo();
 
-			m_verticalBlurComputePass = scene->addComputePass(verticalBlurComputePassCreateInfo);
-		}
+		m_verticalBlurComputePass = scene->addComputePass(verticalBlurComputePassCreateInfo);
 	}
 }
+
+void Wolf::Blur::computeBarrier(void* data, VkCommandBuffer commandBuffer)
+{
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
@@ -7,11 +7,23 @@ namespace Wolf
 	class Blur
 	{
 	public:
-		Blur(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, int commandBufferID, Image* inputImage, Image* depthImage);
+		// singleDispatch: the whole downscale chain is built by one dispatch (shared memory, and quad subgroup operations when available) and the blur is
+		// recorded in commandBufferID after the passes writing the input, no command buffer is added.
+		// Otherwise each level has its own dispatch and command buffer, followed by the horizontal and vertical command buffers.
+		// levelCount is clamped to log2(groupSize) + 1 in single dispatch mode, mipmappedOutput writes all levels in one image.
+		Blur(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, int commandBufferID, Image* inputImage, Image* depthImage, uint32_t levelCount = 3,
+			bool singleDispatch = true, bool mipmappedOutput = false, uint32_t groupSize = 16);
 
 		Image* getOutputImage() { return m_downscaledBlurredImage2; }
+		// Level 0 is half the input resolution
+		Image* getDownscaledImage(uint32_t level) { return m_mipmappedImage ? m_mipmappedImage : m_downscaledImages[level]; }
+		uint32_t getLevelCount() const { return m_levelCount; }
+
 		std::vector<int> getCommandBufferIDs()
 		{
+			if (m_singleDispatch)
+				return {};
+
 			std::vector<int> r =  m_downscaleCommandBufferIDs;
 			r.push_back(m_horizontalBlurCommandBuffer);
 			r.push_back(m_verticalBlurCommandBuffer);
@@ -21,6 +33,9 @@ namespace Wolf
 		std::vector<std::pair<int, int>> getCommandBufferSynchronisation()
 		{
 			std::vector<std::pair<int, int>> r;
+			if (m_singleDispatch)
+				return r;
+
 			for(int i(0); i < m_downscaleCommandBufferIDs.size() - 1; ++i)
 			{
 				r.emplace_back(m_downscaleCommandBufferIDs[i], m_downscaleCommandBufferIDs[i + 1]);
@@ -32,15 +47,25 @@ namespace Wolf
 			return r;
 		}
 
+	private:
+		void createSingleDispatch(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, uint32_t groupSize);
+		void createBlur(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, Image* lastLevel, uint32_t lastLevelMip, int horizontalCommandBufferID,
+			int verticalCommandBufferID, uint32_t groupSize);
+
+		static void computeBarrier(void* data, VkCommandBuffer commandBuffer);
+
 	private:
 		// Data
 		Image* m_inputImage;
 		int m_commandBufferID = -2;
+		uint32_t m_levelCount;
+		bool m_singleDispatch;
 
 		// Downscale
 		std::vector<int> m_downscaleCommandBufferIDs;
 		std::vector<int> m_downscaleComputePasses;
 		std::vector<Image*> m_downscaledImages;
+		Image* m_mipmappedImage = nullptr;
 
 		// Blur
 		int m_horizontalBlurComputePass = -1;
@@ -1,52 +1,59 @@
 #include "CascadedShadowMapping.h"
 
 Wolf::CascadedShadowMapping::CascadedShadowMapping(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, Model* model, float cameraNear, float cameraFar, float shadowFar, 
-	float cameraFOV, VkExtent2D extent, Image* depth, glm::mat4 projection, std::array<DepthPass*, CASCADE_COUNT> depthPasses)
+	float cameraFOV, VkExtent2D extent, Image* depth, glm::mat4 projection, std::array<DepthPass*, CASCADE_COUNT> depthPasses, uint32_t cascadeCount, bool fitSplitsToDepth,
+	bool useShadowAtlas, UniformBuffer* renderScaleData)
 {
 	m_engineInstance = engineInstance;
 	m_scene = scene;
+	m_model = model;
 	m_cameraNear = cameraNear;
 	m_cameraFOV = cameraFOV;
 	m_cameraFar = shadowFar;
 	m_ratio = static_cast<float>(extent.height) / static_cast<float>(extent.width);
 	m_extent = extent;
+	m_cascadeCount = glm::clamp(cascadeCount, 1u, static_cast<uint32_t>(CASCADE_COUNT));
+	m_fitSplitsToDepth = fitSplitsToDepth;
 
 	m_shadowMapExtents = { { 2048, 2048 }, { 2048, 2048 }, { 1024, 1024 }, { 1024, 1024 } };
-	if (!depthPasses[0])
+	m_lightSpaceMatrices.fill(glm::mat4(1.0f));
+	m_cascadeUpdated.fill(true);
+
+	// Cascade splits, we don't render shadows on all the range
+	computeCascadeSplits(m_cameraNear, m_cameraFar);
+
+	const std::array<uint32_t, CASCADE_COUNT> cascadeLODs = computeCascadeLODs();
+
+	if (useShadowAtlas)
+	{
+		// All cascades in one pass, the finest LOD is kept for every tile
+		m_shadowAtlas = std::make_unique<ShadowAtlas>(engineInstance, scene, model, m_cascadeCount, m_shadowMapExtents[0].width, cascadeLODs[0], true);
+	}
+	else if (!depthPasses[0])
 	{
-		for (int i(0); i < m_depthPasses.size(); ++i)
+		for (uint32_t i(0); i < m_cascadeCount; ++i)
 		{
 			// We use separate command buffers because we want to update cascade separately -> Crytek paper
 			m_depthPasses[i] = std::make_unique<DepthPass>(engineInstance, scene, false, m_shadowMapExtents[i], VK_SAMPLE_COUNT_1_BIT, model, glm::mat4(1.0f), true,
-				true);
+				true, cascadeLODs[i], true);
 			m_cascadeCommandBuffers[i] = m_depthPasses[i]->getCommandBufferID();
 		}
 	}
 	else
 	{
-		for (int i(0); i < m_depthPasses.size(); ++i)
+		for (uint32_t i(0); i < m_cascadeCount; ++i)
 		{
 			m_depthPasses[i] = std::unique_ptr<DepthPass>(depthPasses[i]);
+			m_depthPasses[i]->setLOD(cascadeLODs[i]);
 			m_cascadeCommandBuffers[i] = m_depthPasses[i]->getCommandBufferID();
 		}
 	}
 
-	// Cascade splits
-	float near = m_cameraNear;
-	float far = m_cameraFar; // we don't render shadows on all the range
-	for (float i(1.0f / CASCADE_COUNT); i <= 1.0f; i += 1.0f / CASCADE_COUNT)
-	{
-		float d_uni = glm::mix(near, far, i);
-		float d_log = near * glm::pow((far / near), i);
-
-		m_cascadeSplits.push_back(glm::mix(d_uni, d_log, 0.5f));
-	}
-
 	// Data
-	m_uboData.cascadeSplits = glm::vec4(m_cascadeSplits[0], m_cascadeSplits[1], m_cascadeSplits[2], m_cascadeSplits[3]);
 	m_uboData.invProjection = glm::inverse(projection);
 	m_uboData.projectionParams.x = cameraFar / (cameraFar - cameraNear);
 	m_uboData.projectionParams.y = (-cameraFar * cameraNear) / (cameraFar - cameraNear);
+	m_uboData.projectionParams.z = static_cast<float>(m_cascadeCount);
 	m_uniformBuffer = engineInstance->createUniformBufferObject(&m_uboData, sizeof(ShadowMaskUBO));
 
 	Image::CreateImageInfo createImageInfo;
@@ -75,20 +82,50 @@ Wolf::CascadedShadowMapping::CascadedShadowMapping(Wolf::WolfInstance* engineIns
 	computePassCreateInfo.dispatchGroups = { 16, 16, 1 };
 	computePassCreateInfo.computeShaderPath = "Shaders/CSM/comp.spv";
 	computePassCreateInfo.commandBufferID = m_shadowMaskCommandBufferID;
+	computePassCreateInfo.dynamicResolution = renderScaleData != nullptr;
 
 	DescriptorSetGenerator descriptorSetGenerator;
 	descriptorSetGenerator.addImages({ depth }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0);
-	std::vector<Image*> depthPassResults(CASCADE_COUNT);
-	for (int i(0); i < CASCADE_COUNT; ++i)
-		depthPassResults[i] = m_depthPasses[i]->getResult();
+	std::array<Image*, CASCADE_COUNT> depthTextures = getDepthTextures();
+	std::vector<Image*> depthPassResults(depthTextures.begin(), depthTextures.end());
 	descriptorSetGenerator.addImages(depthPassResults, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1);
 	descriptorSetGenerator.addImages({ m_shadowMaskOutputImage }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, CASCADE_COUNT + 1);
 	descriptorSetGenerator.addImages({ m_volumetricLightOutputImage }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, CASCADE_COUNT + 2);
 
 	descriptorSetGenerator.addUniformBuffer(m_uniformBuffer, VK_SHADER_STAGE_COMPUTE_BIT, CASCADE_COUNT + 3);
+	if (renderScaleData)
+		descriptorSetGenerator.addUniformBuffer(renderScaleData, VK_SHADER_STAGE_COMPUTE_BIT, CASCADE_COUNT + 4);
 
 	computePassCreateInfo.descriptorSetCreateInfo = descriptorSetGenerator.getDescritorSetCreateInfo();
 
+	// Min/max reduction of the camera depth, recorded before the shadow mask in the same command buffer
+	if (m_fitSplitsToDepth)
+	{
+		m_depthReductionBuffer = engineInstance->createBuffer(2 * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+		Scene::ComputePassCreateInfo depthReductionCreateInfo;
+		depthReductionCreateInfo.name = "CSM depth reduction";
+		depthReductionCreateInfo.extent = { depth->getExtent().width, depth->getExtent().height };
+		depthReductionCreateInfo.dispatchGroups = { 16, 16, 1 };
+		depthReductionCreateInfo.computeShaderPath = "Shaders/CSM/depthReduction.spv";
+		depthReductionCreateInfo.commandBufferID = m_shadowMaskCommandBufferID;
+		depthReductionCreateInfo.dynamicResolution = renderScaleData != nullptr; // texels outside the rendered part are stale
+
+		// Depths are positive floats so their bits are ordered like uints, the shader skips cleared texels (depth 1)
+		DescriptorSetGenerator depthReductionDescriptorSetGenerator;
+		depthReductionDescriptorSetGenerator.addImages({ depth }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0);
+		depthReductionDescriptorSetGenerator.addBuffer(m_depthReductionBuffer, VK_SHADER_STAGE_COMPUTE_BIT, 1);
+		depthReductionCreateInfo.descriptorSetCreateInfo = depthReductionDescriptorSetGenerator.getDescritorSetCreateInfo();
+
+		depthReductionCreateInfo.beforeRecord = resetDepthReduction;
+		depthReductionCreateInfo.dataForBeforeRecordCallback = this;
+		depthReductionCreateInfo.afterRecord = depthReductionBarrier;
+		depthReductionCreateInfo.dataForAfterRecordCallback = this;
+
+		m_depthReductionComputePassID = scene->addComputePass(depthReductionCreateInfo);
+	}
+
 	m_shadowMaskComputePassID = scene->addComputePass(computePassCreateInfo);
 
 	m_blur = std::make_unique<Blur>(engineInstance, scene, m_shadowMaskCommandBufferID, m_volumetricLightOutputImage, nullptr);
@@ -97,18 +134,16 @@ Wolf::CascadedShadowMapping::CascadedShadowMapping(Wolf::WolfInstance* engineIns
 void Wolf::CascadedShadowMapping::updateMatrices(glm::vec3 lightDir,
 	glm::vec3 cameraPosition, glm::vec3 cameraOrientation, glm::mat4 model, glm::mat4 invModelView)
 {	
-	float lastSplitDist = m_cameraNear;
-	for (int cascade(0); cascade < CASCADE_COUNT; ++cascade)
+	if (m_fitSplitsToDepth)
+		updateSplitsFromDepthReduction();
+
+	float lastSplitDist = m_splitNear;
+	for (uint32_t cascade(0); cascade < m_cascadeCount; ++cascade)
 	{
 		const float startCascade = lastSplitDist;
 		const float endCascade = m_cascadeSplits[cascade];
 
-		float radius = (endCascade - startCascade) / 2.0f;
-
-		const float ar = m_ratio;
-		const float cosHalfHFOV = static_cast<float>(glm::cos((m_cameraFOV * (1.0f / ar)) / 2.0f));
-		const float b = endCascade / cosHalfHFOV;
-		radius = glm::sqrt(b * b + (startCascade + radius) * (startCascade + radius) - 2.0f * b * startCascade * cosHalfHFOV);
+		const float radius = computeCascadeRadius(startCascade, endCascade);
 
 		const float texelPerUnit = static_cast<float>(m_shadowMapExtents[cascade].width) / (radius * 2.0f);
 		glm::mat4 scaleMat = glm::scale(glm::mat4(1.0f), glm::vec3(texelPerUnit));
@@ -124,13 +159,156 @@ void Wolf::CascadedShadowMapping::updateMatrices(glm::vec3 lightDir,
 		glm::mat4 lightViewMatrix = glm::lookAt(frustumCenter - 50.0f * glm::normalize(lightDir), frustumCenter, glm::vec3(0.0f, 1.0f, 0.0f));
 
 		glm::mat4 proj = glm::ortho(-radius, radius, -radius, radius, -30.0f * 6.0f, 30.0f * 6.0f);
-		m_lightSpaceMatrices[cascade] = proj * lightViewMatrix * model;
-		m_uboData.lightSpaceMatrices[cascade] = m_lightSpaceMatrices[cascade];
-		m_depthPasses[cascade]->update(m_lightSpaceMatrices[cascade]);
+		const glm::mat4 lightSpaceMatrix = proj * lightViewMatrix * model;
 
 		lastSplitDist += m_cascadeSplits[cascade];
+
+		// Far cascades cover more of the scene per texel and are refreshed less often: cascade i > 0 every 2^i frames, the last one every 2^(i-1)
+		// (1/2/4/4 frames with 4 cascades). Phases are offset so that exactly one far cascade is refreshed per frame.
+		// The center is snapped to texels so the matrix is exactly the same as long as neither the light nor the snapped center moved,
+		// the cascade then keeps its matrix and depth. Skipped cascades also keep their old matrix so it always matches their depth.
+		// The atlas renders every cascade at once, they are refreshed together when one changed
+		const bool lastCascade = cascade == m_cascadeCount - 1;
+		const uint64_t period = cascade == 0 ? 1 : (lastCascade ? 1ull << (cascade - 1) : 1ull << cascade);
+		const uint64_t phase = cascade == 0 || lastCascade ? 1 : 1 + (1ull << (cascade - 1));
+		const bool scheduled = m_shadowAtlas || (m_frameIndex + phase) % period == 0;
+		m_cascadeUpdated[cascade] = m_cascadesInvalidated || (scheduled && lightSpaceMatrix != m_lightSpaceMatrices[cascade]);
+		if (!m_cascadeUpdated[cascade])
+			continue;
+
+		m_lightSpaceMatrices[cascade] = lightSpaceMatrix;
+		if (m_shadowAtlas)
+			m_uboData.lightSpaceMatrices[cascade] = m_shadowAtlas->getTileMatrix(cascade) * m_lightSpaceMatrices[cascade];
+		else
+		{
+			m_uboData.lightSpaceMatrices[cascade] = m_lightSpaceMatrices[cascade];
+			m_depthPasses[cascade]->update(m_lightSpaceMatrices[cascade]);
+		}
+	}
+	if (m_shadowAtlas && std::find(m_cascadeUpdated.begin(), m_cascadeUpdated.begin() + m_cascadeCount, true) != m_cascadeUpdated.begin() + m_cascadeCount)
+		m_shadowAtlas->update(std::vector<glm::mat4>(m_lightSpaceMatrices.begin(), m_lightSpaceMatrices.begin() + m_cascadeCount));
+	for (uint32_t cascade(m_cascadeCount); cascade < CASCADE_COUNT; ++cascade)
+	{
+		m_lightSpaceMatrices[cascade] = m_lightSpaceMatrices[m_cascadeCount - 1];
+		m_uboData.lightSpaceMatrices[cascade] = m_uboData.lightSpaceMatrices[m_cascadeCount - 1];
 	}
+	m_cascadesInvalidated = false;
+	m_frameIndex++;
 
 	m_uboData.invModelView = invModelView;
 	m_uniformBuffer->updateData(&m_uboData);
 }
+
+float Wolf::CascadedShadowMapping::computeCascadeRadius(float startCascade, float endCascade) const
+{
+	const float radius = (endCascade - startCascade) / 2.0f;
+
+	const float ar = m_ratio;
+	const float cosHalfHFOV = static_cast<float>(glm::cos((m_cameraFOV * (1.0f / ar)) / 2.0f));
+	const float b = endCascade / cosHalfHFOV;
+	return glm::sqrt(b * b + (startCascade + radius) * (startCascade + radius) - 2.0f * b * startCascade * cosHalfHFOV);
+}
+
+void Wolf::CascadedShadowMapping::computeCascadeSplits(float near, float far)
+{
+	m_splitNear = near;
+	m_splitFar = far;
+
+	m_cascadeSplits.clear();
+	for (uint32_t cascade(1); cascade <= m_cascadeCount; ++cascade)
+	{
+		const float i = static_cast<float>(cascade) / static_cast<float>(m_cascadeCount);
+		float d_uni = glm::mix(near, far, i);
+		float d_log = near * glm::pow((far / near), i);
+
+		m_cascadeSplits.push_back(glm::mix(d_uni, d_log, 0.5f));
+	}
+	while (m_cascadeSplits.size() < CASCADE_COUNT)
+		m_cascadeSplits.push_back(m_cascadeSplits.back());
+
+	m_uboData.cascadeSplits = glm::vec4(m_cascadeSplits[0], m_cascadeSplits[1], m_cascadeSplits[2], m_cascadeSplits[3]);
+}
+
+void Wolf::CascadedShadowMapping::updateSplitsFromDepthReduction()
+{
+	// Result of the last submitted frame, min > max until the reduction ran once
+	uint32_t* depthRange;
+	m_depthReductionBuffer->map(reinterpret_cast<void**>(&depthRange));
+	const uint32_t minDepthBits = depthRange[0];
+	const uint32_t maxDepthBits = depthRange[1];
+	m_depthReductionBuffer->unmap();
+
+	if (minDepthBits > maxDepthBits)
+		return;
+
+	float minDepth, maxDepth;
+	std::memcpy(&minDepth, &minDepthBits, sizeof(float));
+	std::memcpy(&maxDepth, &maxDepthBits, sizeof(float));
+
+	auto linearizeDepth = [this](float depth) { return m_uboData.projectionParams.y / (depth - m_uboData.projectionParams.x); };
+	const float splitNear = glm::clamp(linearizeDepth(minDepth), m_cameraNear, m_cameraFar);
+	const float splitFar = glm::clamp(linearizeDepth(maxDepth), splitNear + m_cameraNear, m_cameraFar);
+
+	// New splits change every cascade, only refit when the range moved enough to be worth re-rendering them
+	if (glm::abs(splitNear - m_splitNear) < 0.1f * m_splitNear && glm::abs(splitFar - m_splitFar) < 0.05f * m_splitFar)
+		return;
+
+	computeCascadeSplits(splitNear, splitFar);
+	m_cascadesInvalidated = true;
+
+	// Depth passes select their LOD on the next cascade update. The atlas keeps the finest LOD it was created with
+}
+
+std::array<uint32_t, CASCADE_COUNT> Wolf::CascadedShadowMapping::computeCascadeLODs() const
+{
+	// Coarser LODs where shadow map texels cover more of the scene
+	std::array<uint32_t, CASCADE_COUNT> cascadeLODs{};
+	float lastSplitDist = m_splitNear;
+	for (uint32_t cascade(0); cascade < m_cascadeCount; ++cascade)
+	{
+		const float texelPerUnit = static_cast<float>(m_shadowMapExtents[cascade].width) / (computeCascadeRadius(lastSplitDist, m_cascadeSplits[cascade]) * 2.0f);
+		cascadeLODs[cascade] = m_model->selectLOD(texelPerUnit);
+
+		lastSplitDist += m_cascadeSplits[cascade];
+	}
+
+	return cascadeLODs;
+}
+
+void Wolf::CascadedShadowMapping::resetDepthReduction(void* data, VkCommandBuffer commandBuffer)
+{
+	const CascadedShadowMapping* csm = static_cast<CascadedShadowMapping*>(data);
+
+	vkCmdFillBuffer(commandBuffer, csm->m_depthReductionBuffer->getBuffer(), 0, sizeof(uint32_t), 0xFFFFFFFF);
+	vkCmdFillBuffer(commandBuffer, csm->m_depthReductionBuffer->getBuffer(), sizeof(uint32_t), sizeof(uint32_t), 0);
+
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = csm->m_depthReductionBuffer->getBuffer();
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void Wolf::CascadedShadowMapping::depthReductionBarrier(void* data, VkCommandBuffer commandBuffer)
+{
+	const CascadedShadowMapping* csm = static_cast<CascadedShadowMapping*>(data);
+
+	// Read back by the CPU on next update
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = csm->m_depthReductionBuffer->getBuffer();
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
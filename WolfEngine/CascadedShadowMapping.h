@@ -1,24 +1,41 @@
 #pragma once
 
+#include <algorithm>
+
 #include "DepthPass.h"
+#include "ShadowAtlas.h"
 #include "Blur.h"
 #include "Model.h"
 
 namespace Wolf
 {
-	constexpr int CASCADE_COUNT = 4;
+	constexpr int CASCADE_COUNT = 4; // maximum, the shadow mask bindings and UBO are sized for it
 	
 	class CascadedShadowMapping
 	{
 	public:
 		CascadedShadowMapping(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, Model* model, float cameraNear, float cameraFar, float shadowFar, float cameraFOV, VkExtent2D extent,
-			Image* depth, glm::mat4 projection, std::array<DepthPass*, CASCADE_COUNT> depthPasses = { nullptr });
+			Image* depth, glm::mat4 projection, std::array<DepthPass*, CASCADE_COUNT> depthPasses = { nullptr }, uint32_t cascadeCount = CASCADE_COUNT, bool fitSplitsToDepth = false,
+			bool useShadowAtlas = false, UniformBuffer* renderScaleData = nullptr);
 
 		void updateMatrices(glm::vec3 lightDir, glm::vec3 cameraPosition, glm::vec3 cameraOrientation, glm::mat4 model, glm::mat4 invModelView);
+		void invalidateCascades() { m_cascadesInvalidated = true; } // all cascades are rendered on next update, ex: when the geometry moved
 
+		// Only the cascades updated by the last updateMatrices(), query it every frame
 		std::vector<int> getCascadeCommandBuffers()
 		{
-			std::vector<int> r(m_cascadeCommandBuffers.begin(), m_cascadeCommandBuffers.end());
+			std::vector<int> r;
+			if (m_shadowAtlas)
+			{
+				if (std::find(m_cascadeUpdated.begin(), m_cascadeUpdated.begin() + m_cascadeCount, true) != m_cascadeUpdated.begin() + m_cascadeCount)
+					r.push_back(m_shadowAtlas->getCommandBufferID());
+			}
+			else
+			{
+				for (uint32_t i(0); i < m_cascadeCount; ++i)
+					if (m_cascadeUpdated[i])
+						r.push_back(m_cascadeCommandBuffers[i]);
+			}
 			r.push_back(m_shadowMaskCommandBufferID);
 			std::vector<int> blurCommandBuffers = m_blur->getCommandBufferIDs();
 			for (auto& commandBuffer : blurCommandBuffers)
@@ -28,13 +45,20 @@ namespace Wolf
 		std::vector<std::pair<int, int>> getCommandBufferSynchronisation()
 		{
 			std::vector<std::pair<int, int>> r;
-			for(auto& commandBuffer : m_cascadeCommandBuffers)
+			if (m_shadowAtlas)
+				r.emplace_back(m_shadowAtlas->getCommandBufferID(), m_shadowMaskCommandBufferID);
+			else
 			{
-				r.emplace_back(commandBuffer, m_shadowMaskCommandBufferID);
+				for (uint32_t i(0); i < m_cascadeCount; ++i)
+				{
+					r.emplace_back(m_cascadeCommandBuffers[i], m_shadowMaskCommandBufferID);
+				}
 			}
 
+			// Single dispatch blur is recorded in the shadow mask command buffer
 			std::vector<std::pair<int, int>> blurSync = m_blur->getCommandBufferSynchronisation();
-			r.emplace_back(m_shadowMaskCommandBufferID, blurSync[0].first);
+			if (!blurSync.empty())
+				r.emplace_back(m_shadowMaskCommandBufferID, blurSync[0].first);
 			for (auto& sync : blurSync)
 				r.push_back(sync);
 
@@ -44,25 +68,44 @@ namespace Wolf
 		Image* getOutputShadowMaskTexture() { return m_shadowMaskOutputImage; }
 		Image* getOutputVolumetricLightMaskImage() { return m_blur->getOutputImage(); }
 
+		uint32_t getCascadeCount() const { return m_cascadeCount; }
+		// Unused cascades repeat the last one
 		glm::vec4 getCascadeSplits() { return glm::vec4(m_cascadeSplits[0], m_cascadeSplits[1], m_cascadeSplits[2], m_cascadeSplits[3]); }
-		std::array<glm::mat4, CASCADE_COUNT> getLightSpaceMatrices() { return m_lightSpaceMatrices; }
+		// Matrices as sampled: with the shadow atlas they include the tile transform and every cascade returns the atlas
+		std::array<glm::mat4, CASCADE_COUNT> getLightSpaceMatrices() { return m_uboData.lightSpaceMatrices; }
 		std::array<Image*, CASCADE_COUNT> getDepthTextures()
 		{
 			std::array<Image*, CASCADE_COUNT> r{};
 			for (int i(0); i < CASCADE_COUNT; ++i)
-				r[i] = m_depthPasses[i]->getResult();
+				r[i] = m_shadowAtlas ? m_shadowAtlas->getResult() : m_depthPasses[glm::min(static_cast<uint32_t>(i), m_cascadeCount - 1)]->getResult();
 
 			return r;
 		}
 
+	private:
+		float computeCascadeRadius(float startCascade, float endCascade) const;
+		void computeCascadeSplits(float near, float far);
+		void updateSplitsFromDepthReduction();
+		std::array<uint32_t, CASCADE_COUNT> computeCascadeLODs() const;
+		static void resetDepthReduction(void* data, VkCommandBuffer commandBuffer);
+		static void depthReductionBarrier(void* data, VkCommandBuffer commandBuffer);
+
 	private:
 		Wolf::WolfInstance* m_engineInstance;
 		Wolf::Scene* m_scene;
+		Model* m_model;
 	
+		uint32_t m_cascadeCount = CASCADE_COUNT;
 		std::array<std::unique_ptr<DepthPass>, CASCADE_COUNT> m_depthPasses;
+		std::unique_ptr<ShadowAtlas> m_shadowAtlas; // replaces the depth passes
 		std::array<int, CASCADE_COUNT> m_cascadeCommandBuffers;
 		std::array<glm::mat4, CASCADE_COUNT> m_lightSpaceMatrices;
 
+		/* Cascade updates */
+		uint64_t m_frameIndex = 0;
+		bool m_cascadesInvalidated = true;
+		std::array<bool, CASCADE_COUNT> m_cascadeUpdated;
+
 		/* Camera params */
 		float m_cameraNear;
 		float m_cameraFar;
@@ -80,7 +123,7 @@ namespace Wolf
 		{
 			glm::mat4 invModelView;
 			glm::mat4 invProjection;
-			glm::vec4 projectionParams;
+			glm::vec4 projectionParams; // x, y: depth linearization, z: cascade count
 			std::array<glm::mat4, CASCADE_COUNT> lightSpaceMatrices;
 			glm::vec4 cascadeSplits;
 		};
@@ -88,6 +131,13 @@ namespace Wolf
 		UniformBuffer* m_uniformBuffer;
 		
 		std::vector<float> m_cascadeSplits;
+		float m_splitNear;
+		float m_splitFar;
+
+		/* Sample distribution: splits fitted to the min/max of the visible depth */
+		bool m_fitSplitsToDepth = false;
+		Buffer* m_depthReductionBuffer = nullptr;
+		int m_depthReductionComputePassID = -1;
 		std::vector<VkExtent2D> m_shadowMapExtents;
 
 		std::unique_ptr<Blur> m_blur;
@@ -1,7 +1,7 @@
 #include "CascadedShadowMappingStereoscopic.h"
 
 Wolf::CascadedShadowMappingStereoscopic::CascadedShadowMappingStereoscopic(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, Model* model, float cameraNear, float cameraFar, float shadowFar,
-	float cameraFOV, VkExtent2D extent, Image* depth, std::array<glm::mat4, 2> projections)
+	float cameraFOV, VkExtent2D extent, Image* depth, std::array<glm::mat4, 2> projections, bool layeredDepth)
 {
 	m_engineInstance = engineInstance;
 	m_scene = scene;
@@ -63,7 +63,8 @@ Wolf::CascadedShadowMappingStereoscopic::CascadedShadowMappingStereoscopic(Wolf:
 	computePassCreateInfo.name = "Cascaded shadow mapping";
 	computePassCreateInfo.extent = engineInstance->getWindowSize();
 	computePassCreateInfo.dispatchGroups = { 16, 16, 1 };
-	computePassCreateInfo.computeShaderPath = "Shaders/CSM/comp.spv";
+	// Layered depth: 2-layer array from the multiview GBuffer, the shader reads layer x / eyeWidth, masks stay side by side
+	computePassCreateInfo.computeShaderPath = layeredDepth ? "Shaders/CSM/multiviewComp.spv" : "Shaders/CSM/comp.spv";
 	computePassCreateInfo.commandBufferID = m_shadowMaskCommandBufferID;
 
 	DescriptorSetGenerator descriptorSetGenerator;
@@ -12,7 +12,7 @@ namespace Wolf
 	{
 	public:
 		CascadedShadowMappingStereoscopic(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, Model* model, float cameraNear, float cameraFar, float shadowFar, float cameraFOV,
-			VkExtent2D extent, Image* depth, std::array<glm::mat4, 2> projections);
+			VkExtent2D extent, Image* depth, std::array<glm::mat4, 2> projections, bool layeredDepth = false);
 
 		void updateMatrices(glm::vec3 lightDir, glm::vec3 cameraPosition, glm::vec3 cameraOrientation, glm::mat4 model, std::array<glm::mat4, 2> invModelView);
 
@@ -33,8 +33,10 @@ namespace Wolf
 				r.emplace_back(commandBuffer, m_shadowMaskCommandBufferID);
 			}
 
+			// Single dispatch blur is recorded in the shadow mask command buffer
 			std::vector<std::pair<int, int>> blurSync = m_blur->getCommandBufferSynchronisation();
-			r.emplace_back(m_shadowMaskCommandBufferID, blurSync[0].first);
+			if (!blurSync.empty())
+				r.emplace_back(m_shadowMaskCommandBufferID, blurSync[0].first);
 			for (auto& sync : blurSync)
 				r.push_back(sync);
 
@@ -5,7 +5,7 @@
 #include "Debug.h"
 
 Wolf::ComputePass::ComputePass(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, std::string computeShader,
-                               DescriptorSetCreateInfo descriptorSetCreateInfo)
+                               DescriptorSetCreateInfo descriptorSetCreateInfo, const std::vector<uint32_t>& specializationConstants)
 {
 	m_device = device;
 	m_physicalDevice = physicalDevice;
@@ -21,11 +21,22 @@ Wolf::ComputePass::ComputePass(VkDevice device, VkPhysicalDevice physicalDevice,
 	m_descriptorSetLayout = createDescriptorSetLayout(m_device, descriptorLayouts);
 	
 	/* Create pipeline */
-	m_pipeline = std::make_unique<Pipeline>(device, std::move(computeShader), &m_descriptorSetLayout);
+	m_pipeline = std::make_unique<Pipeline>(device, std::move(computeShader), &m_descriptorSetLayout, specializationConstants);
 }
 
-void Wolf::ComputePass::create(VkDescriptorPool descriptorPool)
+Wolf::ComputePass::~ComputePass()
 {
+	if (m_descriptorSetPool)
+		m_descriptorSetPool->freeDescriptorSet(m_descriptorSet);
+	releaseDescriptorSetLayout(m_descriptorSetLayout);
+}
+
+void Wolf::ComputePass::create(DescriptorPool* descriptorPool)
+{
+	if (m_descriptorSetPool)
+		m_descriptorSetPool->freeDescriptorSet(m_descriptorSet);
+
+	m_descriptorSetPool = descriptorPool;
 	m_descriptorSet = createDescriptorSet(m_device, m_descriptorSetLayout, descriptorPool, m_descriptorSetCreateInfo);
 }
 
@@ -16,9 +16,11 @@ namespace Wolf
 	{
 	public:
 		ComputePass(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, std::string computeShader,
-			DescriptorSetCreateInfo descriptorSetCreateInfo);
+			DescriptorSetCreateInfo descriptorSetCreateInfo, const std::vector<uint32_t>& specializationConstants = {});
 
-		void create(VkDescriptorPool descriptorPool);
+		~ComputePass();
+
+		void create(DescriptorPool* descriptorPool); // can be called again, the previous set is released
 		void record(VkCommandBuffer commandBuffer, VkExtent2D extent, VkExtent3D dispatchGroups);
 		
 	private:
@@ -27,7 +29,8 @@ namespace Wolf
 		// Data
 		DescriptorSetCreateInfo m_descriptorSetCreateInfo;
 
-		VkDescriptorSet m_descriptorSet;
+		DescriptorPool* m_descriptorSetPool = nullptr;
+		VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
 		VkDescriptorSetLayout m_descriptorSetLayout;
 	};
 }
@@ -1,10 +1,13 @@
 #include "DepthPass.h"
 
 Wolf::DepthPass::DepthPass(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, bool outputIsSwapChain, VkExtent2D extent, VkSampleCountFlagBits sampleCount,
-	const Model* model, glm::mat4 mvp, bool useAsStorage, bool useAsSampled)
+	const Model* model, glm::mat4 mvp, bool useAsStorage, bool useAsSampled, uint32_t lod, bool cullCasters)
 {
 	m_engineInstance = engineInstance;
 	m_scene = scene;
+	m_model = model;
+	m_lod = lod;
+	m_extent = extent;
 
 	// Command Buffer creation
 	Scene::CommandBufferCreateInfo commandBufferCreateInfo;
@@ -64,13 +67,33 @@ Wolf::DepthPass::DepthPass(Wolf::WolfInstance* engineInstance, Wolf::Scene* scen
 	m_rendererID = scene->addRenderer(rendererCreateInfo);
 
 	Renderer::AddMeshInfo addMeshInfo{};
-	addMeshInfo.vertexBuffer = model->getVertexBuffers()[0];
+	addMeshInfo.vertexBuffer = model->getLODVertexBuffers(m_lod)[0];
 	addMeshInfo.renderPassID = m_renderPassID;
+
+	if (cullCasters && !model->getLODClusters(0).empty())
+	{
+		// Sized for the LOD with the most clusters so setLOD can reuse the buffer
+		for (uint32_t i(0); i < model->getLODCount(); ++i)
+			m_maxCasterDrawCount = glm::max(m_maxCasterDrawCount, static_cast<uint32_t>(model->getLODClusters(i)[0].size()));
+
+		if (m_maxCasterDrawCount > 0)
+		{
+			// Every LOD in one index buffer: setLOD only rewrites the draw commands, nothing is recorded again
+			addMeshInfo.vertexBuffer = model->getAllLODVertexBuffers()[0];
+			m_clusters = model->getLODClusters(m_lod, true)[0];
+			m_casterDrawCommandBuffer = engineInstance->createBuffer(sizeof(VkDrawIndexedIndirectCommand) * m_maxCasterDrawCount, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			updateCasterDrawCommands();
+
+			addMeshInfo.indirectBuffer.drawCommandBuffer = m_casterDrawCommandBuffer->getBuffer();
+			addMeshInfo.indirectBuffer.maxDrawCount = m_maxCasterDrawCount;
+		}
+	}
 	addMeshInfo.rendererID = m_rendererID;
 
 	addMeshInfo.descriptorSetCreateInfo = descriptorSetGenerator.getDescritorSetCreateInfo();
 
-	m_scene->addMesh(addMeshInfo);
+	m_meshID = m_scene->addMesh(addMeshInfo);
 
 	//m_scene->getRenderPassOutput(m_renderPassID, 0, 0)->setImageLayout(VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, useAsStorage ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
 }
@@ -79,4 +102,77 @@ void Wolf::DepthPass::update(glm::mat4 mvp)
 {
 	m_mvp = mvp;
 	m_uboMVP->updateData(&m_mvp);
+
+	// Only re-records when the selected LOD changes
+	if (m_model && m_model->getLODCount() > 1)
+		setLOD(selectLOD());
+
+	if (m_casterDrawCommandBuffer)
+		updateCasterDrawCommands();
+}
+
+void Wolf::DepthPass::setLOD(uint32_t lod)
+{
+	if (lod == m_lod || !m_model)
+		return;
+
+	m_lod = lod;
+	if (m_casterDrawCommandBuffer)
+	{
+		m_clusters = m_model->getLODClusters(m_lod, true)[0];
+		updateCasterDrawCommands();
+		return;
+	}
+
+	VertexBuffer vertexBuffer = m_model->getLODVertexBuffers(m_lod)[0];
+	m_scene->updateVertexBuffer(m_renderPassID, m_rendererID, m_meshID, vertexBuffer);
+}
+
+uint32_t Wolf::DepthPass::selectLOD() const
+{
+	// Model origin behind the camera: keep the current LOD
+	const float distance = m_mvp[3][3];
+	if (distance <= 0.0f)
+		return m_lod;
+
+	// Pixels covered by a model unit at the origin distance (w = 1 for orthographic projections)
+	const glm::vec3 clipX = glm::vec3(m_mvp[0][0], m_mvp[1][0], m_mvp[2][0]);
+	const glm::vec3 clipY = glm::vec3(m_mvp[0][1], m_mvp[1][1], m_mvp[2][1]);
+	const float pixelsPerUnit = glm::max(glm::length(clipX) * m_extent.width, glm::length(clipY) * m_extent.height) * 0.5f / distance;
+
+	// Hysteresis: finer LODs are selected right away, coarser ones only once they stay under the error with a margin
+	const uint32_t finerLOD = m_model->selectLOD(pixelsPerUnit);
+	if (finerLOD < m_lod)
+		return finerLOD;
+	return glm::max(m_lod, m_model->selectLOD(pixelsPerUnit * LOD_HYSTERESIS));
+}
+
+void Wolf::DepthPass::updateCasterDrawCommands()
+{
+	const std::array<glm::vec4, 5> planes = computeShadowCasterPlanes(m_mvp);
+
+	VkDrawIndexedIndirectCommand* drawCommands;
+	m_casterDrawCommandBuffer->map(reinterpret_cast<void**>(&drawCommands));
+
+	m_visibleCasterCount = 0;
+	for (uint32_t i(0); i < m_maxCasterDrawCount; ++i)
+	{
+		VkDrawIndexedIndirectCommand& drawCommand = drawCommands[i];
+		drawCommand.vertexOffset = 0;
+		drawCommand.firstInstance = 0;
+		if (i >= m_clusters.size())
+		{
+			drawCommand.indexCount = 0;
+			drawCommand.instanceCount = 0;
+			drawCommand.firstIndex = 0;
+			continue;
+		}
+
+		drawCommand.indexCount = m_clusters[i].indexCount;
+		drawCommand.firstIndex = m_clusters[i].firstIndex;
+		drawCommand.instanceCount = isSphereOutside(m_clusters[i].boundingSphere, planes.data(), static_cast<uint32_t>(planes.size())) ? 0 : 1;
+		m_visibleCasterCount += drawCommand.instanceCount;
+	}
+
+	m_casterDrawCommandBuffer->unmap();
 }
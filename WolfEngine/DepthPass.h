@@ -12,14 +12,24 @@ namespace Wolf
 	public:
 		DepthPass() = default;
 		DepthPass(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, bool outputIsSwapChain, VkExtent2D extent, VkSampleCountFlagBits sampleCount,
-			const Model* model, glm::mat4 mvp, bool useAsStorage, bool useAsSampled);
+			const Model* model, glm::mat4 mvp, bool useAsStorage, bool useAsSampled, uint32_t lod = 0, bool cullCasters = false);
 		~DepthPass() = default;
 
+		// Also culls the model clusters against mvp when caster culling is enabled, and selects the model LOD from the projected distance to its origin
 		void update(glm::mat4 mvp);
+		void setLOD(uint32_t lod); // with caster culling only the draw commands change, otherwise the scene records its command buffers again on the next frame
+
+		uint32_t getVisibleCasterCount() const { return m_visibleCasterCount; }
+		uint32_t getCasterCount() const { return static_cast<uint32_t>(m_clusters.size()); }
 
 		int getCommandBufferID() { return m_commandBufferID; }
 		Image* getResult() { return m_scene->getRenderPassOutput(m_renderPassID, 0); }
 
+	protected:
+		void updateCasterDrawCommands();
+		uint32_t selectLOD() const;
+		static constexpr float LOD_HYSTERESIS = 1.25f; // pixel error margin before switching to a coarser LOD
+
 	protected:
 		Wolf::WolfInstance* m_engineInstance;
 		Wolf::Scene* m_scene;
@@ -34,6 +44,17 @@ namespace Wolf
 		glm::mat4 m_mvp;
 		int m_rendererID;
 
+		const Model* m_model = nullptr;
+		int m_meshID = -1;
+		uint32_t m_lod = 0;
+		VkExtent2D m_extent = { 0, 0 };
+
+		// Caster culling, one indirect draw per cluster
+		Buffer* m_casterDrawCommandBuffer = nullptr;
+		std::vector<MeshCluster> m_clusters;
+		uint32_t m_maxCasterDrawCount = 0;
+		uint32_t m_visibleCasterCount = 0;
+
 		VkSampleCountFlagBits m_sampleCount = VK_SAMPLE_COUNT_1_BIT;
 	};
 }
@@ -0,0 +1,57 @@
+#include "DepthPyramid.h"
+
+Wolf::DepthPyramid::DepthPyramid(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, int commandBufferID, Image* depth)
+{
+	// Level 0 is half the depth resolution rounded up, stop at 1x1
+	VkExtent2D sourceExtent = { depth->getExtent().width, depth->getExtent().height };
+	VkExtent2D extent = { glm::max((sourceExtent.width + 1) / 2, 1u), glm::max((sourceExtent.height + 1) / 2, 1u) };
+	while (true)
+	{
+		Image::CreateImageInfo createImageInfo;
+		createImageInfo.extent = { extent.width, extent.height, 1 };
+		createImageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT;
+		createImageInfo.format = VK_FORMAT_R32_SFLOAT;
+		createImageInfo.sampleCount = VK_SAMPLE_COUNT_1_BIT;
+		createImageInfo.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+		createImageInfo.mipLevels = 1;
+		Image* level = engineInstance->createImage(createImageInfo);
+		level->setImageLayout(VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		Scene::ComputePassCreateInfo computePassCreateInfo;
+		computePassCreateInfo.extent = extent;
+		computePassCreateInfo.dispatchGroups = { 16, 16, 1 };
+		computePassCreateInfo.computeShaderPath = "Shaders/DepthPyramid/comp.spv";
+		computePassCreateInfo.specializationConstants = { sourceExtent.width % 2, sourceExtent.height % 2 };
+		computePassCreateInfo.commandBufferID = commandBufferID;
+		computePassCreateInfo.name = "Depth pyramid level " + std::to_string(m_levels.size());
+
+		DescriptorSetGenerator descriptorSetGenerator;
+		descriptorSetGenerator.addImages({ m_levels.empty() ? depth : m_levels.back() }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0); // Input
+		descriptorSetGenerator.addImages({ level }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1); // Output
+
+		computePassCreateInfo.descriptorSetCreateInfo = descriptorSetGenerator.getDescritorSetCreateInfo();
+
+		// Next level reads this one in the same command buffer
+		computePassCreateInfo.afterRecord = levelBarrier;
+		computePassCreateInfo.dataForAfterRecordCallback = this;
+
+		m_computePassIDs.push_back(scene->addComputePass(computePassCreateInfo));
+		m_levels.push_back(level);
+
+		if (extent.width == 1 && extent.height == 1)
+			break;
+		sourceExtent = extent;
+		extent.width = glm::max((extent.width + 1) / 2, 1u);
+		extent.height = glm::max((extent.height + 1) / 2, 1u);
+	}
+}
+
+void Wolf::DepthPyramid::levelBarrier(void* data, VkCommandBuffer commandBuffer)
+{
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
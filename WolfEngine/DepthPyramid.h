@@ -0,0 +1,26 @@
+#pragma once
+
+#include "WolfEngine.h"
+
+namespace Wolf
+{
+	// Hierarchical-Z: each level keeps the farthest depth of the previous one over the same UV footprint. Sizes are halved rounding up, so an output texel
+	// covers up to 3 source texels along an odd source dimension: the shader then reads 3 instead of 2 along that axis (2x2, 3x2, 2x3 or 3x3),
+	// starting at floor(outputTexel * sourceSize / outputSize) and clamped to the source size, so the pyramid stays conservative.
+	// Specialization constants: 0 = source width is odd, 1 = source height is odd
+	class DepthPyramid
+	{
+	public:
+		DepthPyramid(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, int commandBufferID, Image* depth);
+
+		std::vector<Image*> getLevels() const { return m_levels; }
+		VkExtent2D getExtent() const { return { m_levels[0]->getExtent().width, m_levels[0]->getExtent().height }; }
+
+	private:
+		static void levelBarrier(void* data, VkCommandBuffer commandBuffer);
+
+	private:
+		std::vector<Image*> m_levels;
+		std::vector<int> m_computePassIDs;
+	};
+}
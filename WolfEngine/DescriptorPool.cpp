@@ -1,12 +1,29 @@
 #include "DescriptorPool.h"
 #include <array>
+#include <algorithm>
 
-void Wolf::DescriptorPool::allocate(VkDevice device)
+#include "Debug.h"
+
+namespace
+{
+	constexpr uint32_t MAX_SETS_PER_POOL = 4096;
+}
+
+void Wolf::DescriptorPool::initialize(VkDevice device)
 {
-	uint32_t maxSets = m_uniformBufferCount + m_combinedImageSamplerCount + m_storageImageCount + m_samplerCount + m_sampledImageCount + m_storageBufferCount;
+	if (isInitialized())
+		return;
+	m_device = device;
+
+	// First pool is sized for the declared needs so that a static scene still uses a single pool
+	const uint32_t maxSets = m_uniformBufferCount + m_combinedImageSamplerCount + m_storageImageCount + m_samplerCount + m_sampledImageCount + m_storageBufferCount +
+		m_accelerationStructureCount;
 	if (maxSets == 0)
+	{
+		addPool();
 		return;
-	
+	}
+
 	std::vector<VkDescriptorPoolSize> poolSizes{};
 	addDescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, m_uniformBufferCount, poolSizes);
 	addDescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_combinedImageSamplerCount, poolSizes);
@@ -15,21 +32,116 @@ void Wolf::DescriptorPool::allocate(VkDevice device)
 	addDescriptorPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, m_sampledImageCount, poolSizes);
 	addDescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_storageBufferCount, poolSizes);
 	addDescriptorPoolSize(VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_NV, m_accelerationStructureCount, poolSizes);
-	
-	VkDescriptorPoolCreateInfo poolInfo = {};
-	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-	poolInfo.pPoolSizes = poolSizes.data();
-	poolInfo.maxSets = maxSets;
-	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
 
-	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS)
-		throw std::runtime_error("Error : create descriptor pool");
+	m_pools.push_back({ createPool(poolSizes, maxSets), maxSets });
+	m_currentPool = 0;
+}
+
+VkDescriptorSet Wolf::DescriptorPool::allocateDescriptorSet(VkDescriptorSetLayout descriptorSetLayout)
+{
+	if (!isInitialized())
+	{
+		Debug::sendError("Error : descriptor set allocated from an uninitialized pool");
+		return VK_NULL_HANDLE;
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &descriptorSetLayout;
+
+	while (true)
+	{
+		// Pools with freed sets are tried before creating a new one
+		bool newPool = false;
+		if (m_pools[m_currentPool].full)
+		{
+			m_currentPool = 0;
+			while (m_currentPool < m_pools.size() && m_pools[m_currentPool].full)
+				m_currentPool++;
+			if (m_currentPool == m_pools.size())
+			{
+				addPool();
+				newPool = true;
+			}
+		}
+
+		allocInfo.descriptorPool = m_pools[m_currentPool].descriptorPool;
+
+		VkDescriptorSet descriptorSet;
+		const VkResult result = vkAllocateDescriptorSets(m_device, &allocInfo, &descriptorSet);
+		if (result == VK_SUCCESS)
+		{
+			if (m_freeDescriptorSets)
+				m_descriptorSetPools[descriptorSet] = m_currentPool;
+			return descriptorSet;
+		}
+
+		if (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL)
+		{
+			Debug::sendError("Error : allocate descriptor set");
+			return VK_NULL_HANDLE;
+		}
+
+		// Set bigger than an empty pool: replaced by a bigger one
+		if (newPool)
+		{
+			const bool biggestPool = m_pools.back().maxSets >= MAX_SETS_PER_POOL;
+			vkDestroyDescriptorPool(m_device, m_pools.back().descriptorPool, nullptr);
+			m_pools.pop_back();
+			m_currentPool = 0;
+
+			if (biggestPool)
+			{
+				Debug::sendError("Error : descriptor set layout doesn't fit in a descriptor pool");
+				return VK_NULL_HANDLE;
+			}
+		}
+		else
+			m_pools[m_currentPool].full = true;
+	}
+}
+
+void Wolf::DescriptorPool::freeDescriptorSet(VkDescriptorSet descriptorSet)
+{
+	if (descriptorSet == VK_NULL_HANDLE)
+		return;
+	if (!m_freeDescriptorSets)
+	{
+		Debug::sendWarning("Descriptor sets of this pool can only be released with reset()");
+		return;
+	}
+
+	const auto it = m_descriptorSetPools.find(descriptorSet);
+	if (it == m_descriptorSetPools.end())
+	{
+		Debug::sendWarning("Freeing a descriptor set not allocated from this pool");
+		return;
+	}
+
+	vkFreeDescriptorSets(m_device, m_pools[it->second].descriptorPool, 1, &descriptorSet);
+	m_pools[it->second].full = false;
+	m_descriptorSetPools.erase(it);
+}
+
+void Wolf::DescriptorPool::reset()
+{
+	for (Pool& pool : m_pools)
+	{
+		vkResetDescriptorPool(m_device, pool.descriptorPool, 0);
+		pool.full = false;
+	}
+	m_currentPool = 0;
+	m_descriptorSetPools.clear();
 }
 
-void Wolf::DescriptorPool::cleanup(VkDevice device)
+void Wolf::DescriptorPool::cleanup()
 {
-	vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+	for (Pool& pool : m_pools)
+		vkDestroyDescriptorPool(m_device, pool.descriptorPool, nullptr);
+	m_pools.clear();
+	m_descriptorSetPools.clear();
+	m_currentPool = 0;
 }
 
 void Wolf::DescriptorPool::addDescriptorPoolSize(VkDescriptorType descriptorType, uint32_t descriptorCount,
@@ -40,7 +152,42 @@ void Wolf::DescriptorPool::addDescriptorPoolSize(VkDescriptorType descriptorType
 		VkDescriptorPoolSize poolSize;
 		poolSize.type = descriptorType;
 		poolSize.descriptorCount = descriptorCount;
-		
+
 		poolSizes.emplace_back(poolSize);
 	}
 }
+
+VkDescriptorPool Wolf::DescriptorPool::createPool(const std::vector<VkDescriptorPoolSize>& poolSizes, uint32_t maxSets) const
+{
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	poolInfo.pPoolSizes = poolSizes.data();
+	poolInfo.maxSets = maxSets;
+	poolInfo.flags = m_freeDescriptorSets ? VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT : 0;
+
+	VkDescriptorPool descriptorPool;
+	if (vkCreateDescriptorPool(m_device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
+		throw std::runtime_error("Error : create descriptor pool");
+
+	return descriptorPool;
+}
+
+void Wolf::DescriptorPool::addPool()
+{
+	// Descriptors per set, enough for the engine's passes
+	std::vector<VkDescriptorPoolSize> poolSizes{};
+	addDescriptorPoolSize(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 * m_setsPerPool, poolSizes);
+	addDescriptorPoolSize(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 * m_setsPerPool, poolSizes);
+	addDescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 4 * m_setsPerPool, poolSizes);
+	addDescriptorPoolSize(VK_DESCRIPTOR_TYPE_SAMPLER, m_setsPerPool, poolSizes);
+	addDescriptorPoolSize(VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 8 * m_setsPerPool, poolSizes);
+	addDescriptorPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 * m_setsPerPool, poolSizes);
+	if (m_accelerationStructureCount > 0)
+		addDescriptorPoolSize(VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_NV, m_setsPerPool, poolSizes);
+
+	m_pools.push_back({ createPool(poolSizes, m_setsPerPool), m_setsPerPool });
+	m_currentPool = m_pools.size() - 1;
+
+	m_setsPerPool = std::min(2 * m_setsPerPool, MAX_SETS_PER_POOL);
+}
@@ -1,13 +1,20 @@
 #pragma once
 
+#include <unordered_map>
+
 #include "VulkanHelper.h"
 
 namespace Wolf
 {
+	// Growable descriptor set allocator: keeps a list of pools and creates a new one when the current one is exhausted.
+	// add* give the expected descriptor counts and size the first pool, following pools are sized with default ratios.
 	class DescriptorPool
 	{
 	public:
-		DescriptorPool() = default;
+		// freeDescriptorSets = false: sets can't be freed one by one, only reset() (ex: per-frame pool), cheaper allocations
+		DescriptorPool(bool freeDescriptorSets = true) : m_freeDescriptorSets(freeDescriptorSets) {}
+		DescriptorPool(const DescriptorPool&) = delete;
+		~DescriptorPool() { cleanup(); }
 
 		void addUniformBuffer(unsigned int count) { m_uniformBufferCount += count; };
 		void addCombinedImageSampler(unsigned int count) { m_combinedImageSamplerCount += count; }
@@ -16,15 +23,22 @@ namespace Wolf
 		void addSampledImage(unsigned int count) { m_sampledImageCount += count; }
 		void addStorageBuffer(unsigned int count) { m_storageBufferCount += count; }
 		void addAccelerationStructure(unsigned int count) { m_accelerationStructureCount += count; }
-		
-		void allocate(VkDevice device);
 
-		void cleanup(VkDevice device);
+		void initialize(VkDevice device);
+		bool isInitialized() const { return m_device != VK_NULL_HANDLE; }
+
+		VkDescriptorSet allocateDescriptorSet(VkDescriptorSetLayout descriptorSetLayout);
+		void freeDescriptorSet(VkDescriptorSet descriptorSet); // memory is reused by the next allocations
+		void reset(); // frees every set, pools are kept
+
+		void cleanup();
 
-		VkDescriptorPool getDescriptorPool() const { return m_descriptorPool; }
+		size_t getPoolCount() const { return m_pools.size(); }
 
 	private:
 		static void addDescriptorPoolSize(VkDescriptorType descriptorType, uint32_t descriptorCount, std::vector<VkDescriptorPoolSize>& poolSizes);
+		VkDescriptorPool createPool(const std::vector<VkDescriptorPoolSize>& poolSizes, uint32_t maxSets) const;
+		void addPool();
 
 	private:
 		unsigned int m_uniformBufferCount = 0;
@@ -34,9 +48,20 @@ namespace Wolf
 		unsigned int m_sampledImageCount = 0;
 		unsigned int m_storageBufferCount = 0;
 		unsigned int m_accelerationStructureCount = 0;
-		
-		VkDescriptorPool m_descriptorPool;
-	};
 
+		VkDevice m_device = VK_NULL_HANDLE;
+		bool m_freeDescriptorSets;
+
+		struct Pool
+		{
+			VkDescriptorPool descriptorPool;
+			uint32_t maxSets;
+			bool full = false; // cleared when a set is freed or the pool is reset
+		};
+		std::vector<Pool> m_pools;
+		size_t m_currentPool = 0;
+		uint32_t m_setsPerPool = 64; // doubled for each new pool
 
+		std::unordered_map<VkDescriptorSet, size_t> m_descriptorSetPools;
+	};
 }
@@ -1,9 +1,189 @@
 #include "DescriptorSet.h"
 
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
 #include "Debug.h"
 
+namespace
+{
+	// Layouts are shared between identical binding lists, the update template is created with the first set
+	struct CachedDescriptorSetLayout
+	{
+		VkDevice device;
+		std::vector<Wolf::DescriptorLayout> bindings; // sorted by binding
+		size_t hash;
+		uint32_t referenceCount = 0;
+
+		VkDescriptorUpdateTemplateKHR updateTemplate = VK_NULL_HANDLE;
+		std::vector<size_t> offsets; // in the packed data, per binding
+		size_t dataSize = 0;
+	};
+
+	std::mutex s_layoutCacheMutex;
+	std::unordered_map<VkDescriptorSetLayout, CachedDescriptorSetLayout> s_layoutCache;
+	std::unordered_multimap<size_t, VkDescriptorSetLayout> s_layoutsByHash;
+	bool s_useUpdateTemplates = false;
+
+	size_t hashDescriptorLayouts(const std::vector<Wolf::DescriptorLayout>& descriptorLayouts)
+	{
+		size_t hash = descriptorLayouts.size();
+		for (const Wolf::DescriptorLayout& descriptorLayout : descriptorLayouts)
+			for (const size_t value : { static_cast<size_t>(descriptorLayout.binding), static_cast<size_t>(descriptorLayout.descriptorType),
+				static_cast<size_t>(descriptorLayout.count), static_cast<size_t>(descriptorLayout.accessibility) })
+				hash ^= value + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+
+		return hash;
+	}
+
+	bool sameDescriptorLayouts(const std::vector<Wolf::DescriptorLayout>& a, const std::vector<Wolf::DescriptorLayout>& b)
+	{
+		if (a.size() != b.size())
+			return false;
+		for (size_t i(0); i < a.size(); ++i)
+			if (a[i].binding != b[i].binding || a[i].descriptorType != b[i].descriptorType || a[i].count != b[i].count || a[i].accessibility != b[i].accessibility)
+				return false;
+
+		return true;
+	}
+
+	VkDescriptorImageInfo getDescriptorImageInfo(const Wolf::DescriptorSetCreateInfo::ImageData& imageData)
+	{
+		VkDescriptorImageInfo descriptorImageInfo = {};
+		if (imageData.image)
+		{
+			descriptorImageInfo.imageLayout = imageData.image->getImageLayout();
+			descriptorImageInfo.imageView = imageData.mipLevel == UINT32_MAX ? imageData.image->getImageView() : imageData.image->getImageView(imageData.mipLevel);
+		}
+		if (imageData.sampler)
+			descriptorImageInfo.sampler = imageData.sampler->getSampler();
+
+		return descriptorImageInfo;
+	}
+
+	void createUpdateTemplate(VkDescriptorSetLayout descriptorSetLayout, CachedDescriptorSetLayout& cachedLayout)
+	{
+		std::vector<VkDescriptorUpdateTemplateEntryKHR> entries(cachedLayout.bindings.size());
+		cachedLayout.offsets.resize(cachedLayout.bindings.size());
+		cachedLayout.dataSize = 0;
+		for (size_t i(0); i < cachedLayout.bindings.size(); ++i)
+		{
+			const Wolf::DescriptorLayout& binding = cachedLayout.bindings[i];
+			const bool isBuffer = binding.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER || binding.descriptorType == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			const size_t stride = isBuffer ? sizeof(VkDescriptorBufferInfo) : sizeof(VkDescriptorImageInfo);
+
+			entries[i].dstBinding = binding.binding;
+			entries[i].dstArrayElement = 0;
+			entries[i].descriptorCount = binding.count;
+			entries[i].descriptorType = binding.descriptorType;
+			entries[i].offset = cachedLayout.dataSize;
+			entries[i].stride = stride;
+
+			cachedLayout.offsets[i] = cachedLayout.dataSize;
+			cachedLayout.dataSize += stride * binding.count;
+		}
+
+		VkDescriptorUpdateTemplateCreateInfoKHR templateInfo = {};
+		templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO_KHR;
+		templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+		templateInfo.pDescriptorUpdateEntries = entries.data();
+		templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET_KHR;
+		templateInfo.descriptorSetLayout = descriptorSetLayout;
+
+		if (vkCreateDescriptorUpdateTemplateKHR(cachedLayout.device, &templateInfo, nullptr, &cachedLayout.updateTemplate) != VK_SUCCESS)
+			Wolf::Debug::sendError("Error : create descriptor update template");
+	}
+
+	// Packs the descriptors in the template layout and writes them in one call, false if the set can't use the template
+	bool updateDescriptorSetWithTemplate(VkDevice device, VkDescriptorSet descriptorSet, VkDescriptorSetLayout descriptorSetLayout,
+		const Wolf::DescriptorSetCreateInfo& descriptorSetCreateInfo)
+	{
+		if (!s_useUpdateTemplates || !descriptorSetCreateInfo.descriptorDefault.empty())
+			return false;
+
+		// The cache entry can be released or moved once the lock is released: what the packing needs is copied, the reference keeps the template alive
+		VkDescriptorUpdateTemplateKHR updateTemplate;
+		static thread_local std::vector<Wolf::DescriptorLayout> bindings;
+		static thread_local std::vector<size_t> offsets;
+		size_t dataSize;
+		{
+			std::lock_guard<std::mutex> lock(s_layoutCacheMutex);
+			const auto it = s_layoutCache.find(descriptorSetLayout);
+			if (it == s_layoutCache.end())
+				return false;
+			if (it->second.updateTemplate == VK_NULL_HANDLE)
+				createUpdateTemplate(descriptorSetLayout, it->second);
+			if (it->second.updateTemplate == VK_NULL_HANDLE)
+				return false;
+
+			it->second.referenceCount++;
+			updateTemplate = it->second.updateTemplate;
+			bindings.assign(it->second.bindings.begin(), it->second.bindings.end());
+			offsets.assign(it->second.offsets.begin(), it->second.offsets.end());
+			dataSize = it->second.dataSize;
+		}
+
+		// Reused between calls, only grows
+		static thread_local std::vector<uint8_t> data;
+		data.resize(dataSize);
+
+		size_t packedBindingCount = 0;
+		for (const auto& descriptorBuffer : descriptorSetCreateInfo.descriptorBuffers)
+			for (size_t i(0); i < bindings.size(); ++i)
+				if (bindings[i].binding == descriptorBuffer.second.binding && descriptorBuffer.first.size() == bindings[i].count)
+				{
+					auto* descriptorBufferInfos = reinterpret_cast<VkDescriptorBufferInfo*>(data.data() + offsets[i]);
+					for (size_t j(0); j < descriptorBuffer.first.size(); ++j)
+						descriptorBufferInfos[j] = { descriptorBuffer.first[j].buffer, 0, descriptorBuffer.first[j].size };
+					packedBindingCount++;
+					break;
+				}
+		for (const auto& descriptorImage : descriptorSetCreateInfo.descriptorImages)
+			for (size_t i(0); i < bindings.size(); ++i)
+				if (bindings[i].binding == descriptorImage.second.binding && descriptorImage.first.size() == bindings[i].count)
+				{
+					auto* descriptorImageInfos = reinterpret_cast<VkDescriptorImageInfo*>(data.data() + offsets[i]);
+					for (size_t j(0); j < descriptorImage.first.size(); ++j)
+						descriptorImageInfos[j] = getDescriptorImageInfo(descriptorImage.first[j]);
+					packedBindingCount++;
+					break;
+				}
+
+		// Create info doesn't match the layout (ex: set created with another layout), the template would read garbage
+		const bool packed = packedBindingCount == bindings.size();
+		if (packed)
+			vkUpdateDescriptorSetWithTemplateKHR(device, descriptorSet, updateTemplate, data.data());
+
+		Wolf::releaseDescriptorSetLayout(descriptorSetLayout);
+		return packed;
+	}
+}
+
+void Wolf::setDescriptorUpdateTemplatesEnabled(bool enabled)
+{
+	s_useUpdateTemplates = enabled;
+}
+
 VkDescriptorSetLayout Wolf::createDescriptorSetLayout(VkDevice device, std::vector<DescriptorLayout> descriptorLayouts)
 {
+	std::sort(descriptorLayouts.begin(), descriptorLayouts.end(), [](const DescriptorLayout& a, const DescriptorLayout& b) { return a.binding < b.binding; });
+	const size_t hash = hashDescriptorLayouts(descriptorLayouts);
+
+	std::lock_guard<std::mutex> lock(s_layoutCacheMutex);
+	const auto range = s_layoutsByHash.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		// Handle copied and referenced under the lock, the caller owns one reference
+		const auto cachedLayout = s_layoutCache.find(it->second);
+		if (cachedLayout != s_layoutCache.end() && cachedLayout->second.device == device && sameDescriptorLayouts(cachedLayout->second.bindings, descriptorLayouts))
+		{
+			cachedLayout->second.referenceCount++;
+			const VkDescriptorSetLayout descriptorSetLayout = it->second;
+			return descriptorSetLayout;
+		}
+	}
+
 	std::vector<VkDescriptorSetLayoutBinding> bindings;
 
 	for (auto descriptorLayout : descriptorLayouts)
@@ -25,23 +205,57 @@ VkDescriptorSetLayout Wolf::createDescriptorSetLayout(VkDevice device, std::vect
 
 	VkDescriptorSetLayout descriptorSetLayout;
 	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS)
+	{
 		Debug::sendError("Error : create descriptor set layout");
+		return VK_NULL_HANDLE;
+	}
+
+	CachedDescriptorSetLayout& cachedLayout = s_layoutCache[descriptorSetLayout];
+	cachedLayout.device = device;
+	cachedLayout.bindings = std::move(descriptorLayouts);
+	cachedLayout.hash = hash;
+	cachedLayout.referenceCount = 1;
+	s_layoutsByHash.emplace(hash, descriptorSetLayout);
 
 	return descriptorSetLayout;
 }
 
-VkDescriptorSet Wolf::createDescriptorSet(VkDevice device, VkDescriptorSetLayout descriptorSetLayout, VkDescriptorPool descriptorPool, DescriptorSetCreateInfo descriptorSetCreateInfo)
+void Wolf::releaseDescriptorSetLayout(VkDescriptorSetLayout descriptorSetLayout)
 {
-	VkDescriptorSetLayout layouts[] = { descriptorSetLayout };
-	VkDescriptorSetAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	allocInfo.descriptorPool = descriptorPool;
-	allocInfo.descriptorSetCount = 1;
-	allocInfo.pSetLayouts = layouts;
+	std::lock_guard<std::mutex> lock(s_layoutCacheMutex);
+	const auto it = s_layoutCache.find(descriptorSetLayout);
+	if (it == s_layoutCache.end() || --it->second.referenceCount > 0)
+		return;
+
+	const auto range = s_layoutsByHash.equal_range(it->second.hash);
+	for (auto hashIt = range.first; hashIt != range.second; ++hashIt)
+		if (hashIt->second == descriptorSetLayout)
+		{
+			s_layoutsByHash.erase(hashIt);
+			break;
+		}
 
-	VkDescriptorSet descriptorSet;
-	if (vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet) != VK_SUCCESS)
-		Debug::sendError("Error : allocate descriptor set");
+	if (it->second.updateTemplate != VK_NULL_HANDLE)
+		vkDestroyDescriptorUpdateTemplateKHR(it->second.device, it->second.updateTemplate, nullptr);
+	vkDestroyDescriptorSetLayout(it->second.device, descriptorSetLayout, nullptr);
+	s_layoutCache.erase(it);
+}
+
+VkDescriptorSet Wolf::createDescriptorSet(VkDevice device, VkDescriptorSetLayout descriptorSetLayout, DescriptorPool* descriptorPool, DescriptorSetCreateInfo descriptorSetCreateInfo)
+{
+	VkDescriptorSet descriptorSet = descriptorPool->allocateDescriptorSet(descriptorSetLayout);
+	if (descriptorSet == VK_NULL_HANDLE)
+		return VK_NULL_HANDLE;
+
+	updateDescriptorSet(device, descriptorSet, descriptorSetLayout, descriptorSetCreateInfo);
+
+	return descriptorSet;
+}
+
+void Wolf::updateDescriptorSet(VkDevice device, VkDescriptorSet descriptorSet, VkDescriptorSetLayout descriptorSetLayout, const DescriptorSetCreateInfo& descriptorSetCreateInfo)
+{
+	if (updateDescriptorSetWithTemplate(device, descriptorSet, descriptorSetLayout, descriptorSetCreateInfo))
+		return;
 
 	std::vector<VkWriteDescriptorSet> descriptorWrites;
 
@@ -74,15 +288,7 @@ VkDescriptorSet Wolf::createDescriptorSet(VkDevice device, VkDescriptorSetLayout
 	{
 		descriptorImageInfos[i].resize(descriptorSetCreateInfo.descriptorImages[i].first.size());
 		for (int j(0); j < descriptorImageInfos[i].size(); ++j)
-		{
-			if(descriptorSetCreateInfo.descriptorImages[i].first[j].image)
-			{
-				descriptorImageInfos[i][j].imageLayout = descriptorSetCreateInfo.descriptorImages[i].first[j].image->getImageLayout();
-				descriptorImageInfos[i][j].imageView = descriptorSetCreateInfo.descriptorImages[i].first[j].image->getImageView();
-			}
-			if(descriptorSetCreateInfo.descriptorImages[i].first[j].sampler)
-				descriptorImageInfos[i][j].sampler = descriptorSetCreateInfo.descriptorImages[i].first[j].sampler->getSampler();
-		}
+			descriptorImageInfos[i][j] = getDescriptorImageInfo(descriptorSetCreateInfo.descriptorImages[i].first[j]);
 
 		VkWriteDescriptorSet descriptorWrite;
 		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -113,8 +319,6 @@ VkDescriptorSet Wolf::createDescriptorSet(VkDevice device, VkDescriptorSetLayout
 	}
 
 	vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-
-	return descriptorSet;
 }
 
 void Wolf::DescriptorSetGenerator::addUniformBuffer(UniformBuffer* ubo, VkShaderStageFlags accessibility,
@@ -156,6 +360,28 @@ void Wolf::DescriptorSetGenerator::addImages(std::vector<Image*> images, VkDescr
 	);
 }
 
+void Wolf::DescriptorSetGenerator::addImageMipLevels(Image* image, uint32_t baseMipLevel, uint32_t mipLevelCount, VkDescriptorType descriptorType,
+	VkShaderStageFlags accessibility, uint32_t binding)
+{
+	std::vector<DescriptorSetCreateInfo::ImageData> imageData(mipLevelCount);
+	for (uint32_t i(0); i < mipLevelCount; ++i)
+	{
+		imageData[i].image = image;
+		imageData[i].mipLevel = baseMipLevel + i;
+	}
+
+	DescriptorLayout descriptorLayout;
+	descriptorLayout.accessibility = accessibility;
+	descriptorLayout.binding = binding;
+	descriptorLayout.descriptorType = descriptorType;
+	descriptorLayout.count = mipLevelCount;
+
+	m_descriptorSetCreateInfo.descriptorImages.emplace_back(
+		imageData,
+		descriptorLayout
+	);
+}
+
 void Wolf::DescriptorSetGenerator::addCombinedImageSampler(Image* image, Sampler* sampler,
 	VkShaderStageFlags accessibility, uint32_t binding)
 {
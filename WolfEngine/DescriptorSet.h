@@ -6,6 +6,7 @@
 #include "VulkanHelper.h"
 #include "AccelerationStructure.h"
 #include "Buffer.h"
+#include "DescriptorPool.h"
 
 namespace Wolf
 {
@@ -30,20 +31,29 @@ namespace Wolf
 		{
 			Image* image = nullptr;
 			Sampler* sampler = nullptr;
+			uint32_t mipLevel = UINT32_MAX; // all levels
 		};
 		std::vector<std::pair<std::vector<ImageData>, DescriptorLayout>> descriptorImages;
 
 		std::vector<std::pair<std::vector<VkWriteDescriptorSetAccelerationStructureNV>, DescriptorLayout>> descriptorDefault;
 	};
 
+	// Cached: identical binding lists (any order) share the same layout, each call must be matched by releaseDescriptorSetLayout
 	VkDescriptorSetLayout createDescriptorSetLayout(VkDevice device, std::vector<DescriptorLayout> descriptorLayouts);
-	VkDescriptorSet createDescriptorSet(VkDevice device, VkDescriptorSetLayout descriptorSetLayout, VkDescriptorPool descriptorPool, DescriptorSetCreateInfo descriptorSetCreateInfo);
+	void releaseDescriptorSetLayout(VkDescriptorSetLayout descriptorSetLayout);
+
+	// Sets with a cached layout are written with one descriptor update template call when enabled (requires VK_KHR_descriptor_update_template)
+	void setDescriptorUpdateTemplatesEnabled(bool enabled);
+	VkDescriptorSet createDescriptorSet(VkDevice device, VkDescriptorSetLayout descriptorSetLayout, DescriptorPool* descriptorPool, DescriptorSetCreateInfo descriptorSetCreateInfo);
+	void updateDescriptorSet(VkDevice device, VkDescriptorSet descriptorSet, VkDescriptorSetLayout descriptorSetLayout, const DescriptorSetCreateInfo& descriptorSetCreateInfo);
 
 	class DescriptorSetGenerator
 	{
 	public:
 		void addUniformBuffer(UniformBuffer* ubo, VkShaderStageFlags accessibility, uint32_t binding);
 		void addImages(std::vector<Image*> images, VkDescriptorType descriptorType, VkShaderStageFlags accessibility, uint32_t binding);
+		// One descriptor per level, as an array
+		void addImageMipLevels(Image* image, uint32_t baseMipLevel, uint32_t mipLevelCount, VkDescriptorType descriptorType, VkShaderStageFlags accessibility, uint32_t binding);
 		void addCombinedImageSampler(Image* image, Sampler* sampler, VkShaderStageFlags accessibility, uint32_t binding);
 		void addSampler(Sampler* sampler, VkShaderStageFlags accessibility, uint32_t binding);
 		void addAccelerationStructure(AccelerationStructure* accelerationStructure, VkShaderStageFlags accessibility, uint32_t binding);
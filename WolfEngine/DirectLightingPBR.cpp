@@ -2,7 +2,7 @@
 
 Wolf::DirectLightingPBR::DirectLightingPBR(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, int commandBufferID,
 	VkExtent2D extent, Image* depth, Image* albedoImage, Image* normalRoughnessMetal, Image* shadowMask, Image* volumetricLight, Image* aoMaskImage, Image* lightPropagationVolumes,
-	glm::mat4 projection, float near, float far)
+	glm::mat4 projection, float near, float far, UniformBuffer* lightPropagationVolumesData, UniformBuffer* renderScaleData)
 {
 	// Data
 	Image::CreateImageInfo createImageInfo;
@@ -28,6 +28,7 @@ Wolf::DirectLightingPBR::DirectLightingPBR(Wolf::WolfInstance* engineInstance, W
 	computePassCreateInfo.dispatchGroups = { 16, 16, 1 };
 	computePassCreateInfo.computeShaderPath = "Shaders/directLighting/comp.spv";
 	computePassCreateInfo.commandBufferID = commandBufferID;
+	computePassCreateInfo.dynamicResolution = renderScaleData != nullptr;
 
 	DescriptorSetGenerator descriptorSetGenerator;
 	descriptorSetGenerator.addImages({ depth }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0);
@@ -39,6 +40,10 @@ Wolf::DirectLightingPBR::DirectLightingPBR(Wolf::WolfInstance* engineInstance, W
 	descriptorSetGenerator.addImages({ lightPropagationVolumes }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 6);
 	descriptorSetGenerator.addImages({ m_outputImage }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 7);
 	descriptorSetGenerator.addUniformBuffer(m_ubo, VK_SHADER_STAGE_COMPUTE_BIT, 8);
+	if (lightPropagationVolumesData) // LPV cascades, origins and grid size
+		descriptorSetGenerator.addUniformBuffer(lightPropagationVolumesData, VK_SHADER_STAGE_COMPUTE_BIT, 9);
+	if (renderScaleData)
+		descriptorSetGenerator.addUniformBuffer(renderScaleData, VK_SHADER_STAGE_COMPUTE_BIT, 10);
 
 	computePassCreateInfo.descriptorSetCreateInfo = descriptorSetGenerator.getDescritorSetCreateInfo();
 
@@ -10,7 +10,7 @@ namespace Wolf
 	public:
 		DirectLightingPBR(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, int commandBufferID,
 			VkExtent2D extent, Image* depth, Image* albedoImage, Image* normalRoughnessMetal, Image* shadowMask, Image* volumetricLight, Image* aoMaskImage, Image* lightPropagationVolumes,
-			glm::mat4 projection, float near, float far);
+			glm::mat4 projection, float near, float far, UniformBuffer* lightPropagationVolumesData = nullptr, UniformBuffer* renderScaleData = nullptr);
 
 		void update(glm::vec3 lightDirectionInViewPosSpace, glm::mat4 voxelProjection);
 
@@ -2,7 +2,7 @@
 
 Wolf::DirectLightingStereoscopic::DirectLightingStereoscopic(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, int commandBufferID, VkExtent2D extent, 
 	Image* depth, Image* albedoImage, Image* normalRoughnessMetal, Image* shadowMask, Image* volumetricLight, Image* aoMaskImage, Image* lightPropagationVolumes, 
-	std::array<glm::mat4, 2> projections, float near, float far)
+	std::array<glm::mat4, 2> projections, float near, float far, bool layeredInput)
 {
 	// Data
 	Image::CreateImageInfo createImageInfo;
@@ -26,7 +26,8 @@ Wolf::DirectLightingStereoscopic::DirectLightingStereoscopic(Wolf::WolfInstance*
 	Scene::ComputePassCreateInfo computePassCreateInfo;
 	computePassCreateInfo.extent = engineInstance->getWindowSize();
 	computePassCreateInfo.dispatchGroups = { 16, 16, 1 };
-	computePassCreateInfo.computeShaderPath = "Shaders/directLighting/comp.spv";
+	// Layered input: GBuffer images are 2-layer arrays (multiview), the shader reads layer x / eyeWidth, output stays side by side
+	computePassCreateInfo.computeShaderPath = layeredInput ? "Shaders/directLighting/multiviewComp.spv" : "Shaders/directLighting/comp.spv";
 	computePassCreateInfo.commandBufferID = commandBufferID;
 
 	DescriptorSetGenerator descriptorSetGenerator;
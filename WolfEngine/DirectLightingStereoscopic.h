@@ -10,7 +10,7 @@ namespace Wolf
 	public:
 		DirectLightingStereoscopic(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, int commandBufferID,
 			VkExtent2D extent, Image* depth, Image* albedoImage, Image* normalRoughnessMetal, Image* shadowMask, Image* volumetricLight, Image* aoMaskImage, Image* lightPropagationVolumes,
-			std::array<glm::mat4, 2> projections, float near, float far);
+			std::array<glm::mat4, 2> projections, float near, float far, bool layeredInput = false);
 
 		void update(std::array<glm::vec3, 2> lightDirectionsInViewPosSpace, glm::mat4 voxelProjection);
 
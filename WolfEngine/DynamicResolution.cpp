@@ -0,0 +1,44 @@
+#include "DynamicResolution.h"
+
+Wolf::DynamicResolution::DynamicResolution(float targetFrameTime, float minScale, float maxScale, float scaleStep, uint32_t cooldownFrames)
+{
+	m_targetFrameTime = targetFrameTime;
+	m_minScale = glm::clamp(minScale, 0.1f, 1.0f);
+	m_maxScale = glm::clamp(maxScale, m_minScale, 1.0f);
+	m_scaleStep = glm::max(scaleStep, 0.01f);
+	m_cooldownFrames = cooldownFrames;
+
+	m_scale = m_maxScale;
+}
+
+bool Wolf::DynamicResolution::update(float gpuFrameTime)
+{
+	m_framesSinceChange++;
+	if (gpuFrameTime <= 0.0f)
+		return false;
+
+	// Exponential average, one slow frame shouldn't change the resolution
+	if (m_filteredGPUFrameTime < 0.0f)
+		m_filteredGPUFrameTime = gpuFrameTime;
+	else
+		m_filteredGPUFrameTime = glm::mix(m_filteredGPUFrameTime, gpuFrameTime, 0.1f);
+
+	if (m_framesSinceChange < m_cooldownFrames)
+		return false;
+
+	// Aim a bit below the target, and only go up with a clear margin to avoid oscillating between two steps
+	const float ratio = m_filteredGPUFrameTime / m_targetFrameTime;
+	if (ratio < 1.0f && ratio > 0.8f)
+		return false;
+
+	const float idealScale = m_scale * glm::sqrt(0.9f / ratio);
+	float newScale = glm::round(idealScale / m_scaleStep) * m_scaleStep;
+	newScale = glm::clamp(newScale, m_minScale, m_maxScale);
+	if (glm::abs(newScale - m_scale) < m_scaleStep * 0.5f)
+		return false;
+
+	m_scale = newScale;
+	m_framesSinceChange = 0;
+
+	return true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace Wolf
+{
+	// Render scale controller: moves the scale toward the target GPU frame time.
+	// Pixel cost is assumed proportional to scale^2, the scale is quantized and changed at most every cooldownFrames frames because
+	// every change records the command buffers again (Scene::setRenderScale) and timings need a few frames to settle.
+	class DynamicResolution
+	{
+	public:
+		DynamicResolution(float targetFrameTime = 16.6f, float minScale = 0.5f, float maxScale = 1.0f, float scaleStep = 0.05f, uint32_t cooldownFrames = 10);
+
+		// GPU time of the frame in ms, negative values (timings not available yet) are ignored. Returns true when the scale changed
+		bool update(float gpuFrameTime);
+
+		float getScale() const { return m_scale; }
+		float getFilteredGPUFrameTime() const { return m_filteredGPUFrameTime; }
+		void setTargetFrameTime(float targetFrameTime) { m_targetFrameTime = targetFrameTime; }
+
+	private:
+		float m_targetFrameTime;
+		float m_minScale;
+		float m_maxScale;
+		float m_scaleStep;
+		uint32_t m_cooldownFrames;
+
+		float m_scale;
+		float m_filteredGPUFrameTime = -1.0f;
+		uint32_t m_framesSinceChange = 0;
+	};
+}
@@ -1,6 +1,178 @@
 #include "Font.h"
 
-Wolf::Font::Font(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, Queue graphicsQueue, int ySize, std::string path)
+#include <algorithm>
+#include <numeric>
+#include <thread>
+
+namespace
+{
+	constexpr uint32_t MAX_ATLAS_SIZE = 2048;
+	constexpr uint32_t GLYPH_PADDING = 1; // avoids bleeding between glyphs with linear filtering
+
+	struct GlyphBitmap
+	{
+		unsigned int width = 0;
+		unsigned int height = 0;
+		int left = 0;
+		int top = 0;
+		std::vector<unsigned char> pixels; // padded by the SDF spread in SDF mode
+	};
+
+	// Distance to the nearest pixel of the other side (coverage threshold 0.5), searched in a spread radius, mapped to [0, 255] with 128 on the edge
+	void computeDistanceField(const std::vector<unsigned char>& coverage, unsigned int width, unsigned int height, int spread, GlyphBitmap& output)
+	{
+		const int paddedWidth = static_cast<int>(width) + 2 * spread;
+		const int paddedHeight = static_cast<int>(height) + 2 * spread;
+		auto inside = [&](int x, int y)
+		{
+			x -= spread;
+			y -= spread;
+			return x >= 0 && y >= 0 && x < static_cast<int>(width) && y < static_cast<int>(height) && coverage[static_cast<size_t>(y) * width + x] >= 128;
+		};
+
+		output.width = paddedWidth;
+		output.height = paddedHeight;
+		output.pixels.resize(static_cast<size_t>(paddedWidth) * paddedHeight);
+		for (int y(0); y < paddedHeight; ++y)
+		{
+			for (int x(0); x < paddedWidth; ++x)
+			{
+				const bool isInside = inside(x, y);
+				int minDistanceSquared = spread * spread;
+				for (int offsetY(-spread); offsetY <= spread; ++offsetY)
+				{
+					for (int offsetX(-spread); offsetX <= spread; ++offsetX)
+					{
+						const int distanceSquared = offsetX * offsetX + offsetY * offsetY;
+						if (distanceSquared < minDistanceSquared && inside(x + offsetX, y + offsetY) != isInside)
+							minDistanceSquared = distanceSquared;
+					}
+				}
+
+				// Edge is between the pixel centres
+				const float distance = std::sqrt(static_cast<float>(minDistanceSquared)) - 0.5f;
+				const float signedDistance = isInside ? distance : -distance;
+				output.pixels[static_cast<size_t>(y) * paddedWidth + x] = static_cast<unsigned char>(glm::clamp(0.5f + signedDistance / (2.0f * spread), 0.0f, 1.0f) * 255.0f);
+			}
+		}
+	}
+
+	// Loads characters[first + i * step], each caller needs its own library and face (FreeType objects aren't shared between threads)
+	void rasterizeGlyphs(const std::string& path, int ySize, int sdfSpread, const std::vector<wchar_t>& characters, size_t first, size_t step,
+		std::vector<GlyphBitmap>& glyphs, std::string& error)
+	{
+		FT_Library ft;
+		if (FT_Init_FreeType(&ft))
+		{
+			error = "Error : freeType init";
+			return;
+		}
+
+		FT_Face face;
+		if (FT_New_Face(ft, path.c_str(), 0, &face))
+		{
+			error = "Error : font loading";
+			FT_Done_FreeType(ft);
+			return;
+		}
+
+		FT_Set_Pixel_Sizes(face, 0, ySize);
+
+		std::vector<unsigned char> coverage;
+		for (size_t i = first; i < characters.size(); i += step)
+		{
+			const wchar_t c = characters[i];
+			if (FT_Load_Char(face, c, FT_LOAD_RENDER))
+			{
+				error = "Error : character loading " + std::to_string(static_cast<int>(c));
+				break;
+			}
+
+			if (FT_Render_Glyph(face->glyph, FT_RENDER_MODE_NORMAL)) /* convert to an anti-aliased bitmap */
+			{
+				error = "Error : render glyph " + std::to_string(static_cast<int>(c));
+				break;
+			}
+
+			const unsigned int texWidth = face->glyph->bitmap.width;
+			const unsigned int texHeight = face->glyph->bitmap.rows;
+
+			if (texWidth == 0 || texHeight == 0)
+			{
+				error = "Error : create pixel from character " + std::to_string(static_cast<int>(c));
+				break;
+			}
+
+			coverage.resize(static_cast<size_t>(texWidth) * texHeight);
+			for (unsigned int y(0); y < texHeight; ++y)
+				memcpy(coverage.data() + static_cast<size_t>(y) * texWidth, face->glyph->bitmap.buffer + static_cast<ptrdiff_t>(y) * face->glyph->bitmap.pitch, texWidth);
+
+			GlyphBitmap& glyph = glyphs[i];
+			glyph.left = face->glyph->bitmap_left;
+			glyph.top = face->glyph->bitmap_top;
+			if (sdfSpread > 0)
+				computeDistanceField(coverage, texWidth, texHeight, sdfSpread, glyph);
+			else
+			{
+				glyph.width = texWidth;
+				glyph.height = texHeight;
+				glyph.pixels = coverage;
+			}
+		}
+
+		FT_Done_Face(face);
+		FT_Done_FreeType(ft);
+	}
+
+	// Horizontal kerning in pixels of ySize: dense for the first basicCount characters, nonzero pairs with another character in extraKerning.
+	// Left empty if the font has no kerning table
+	void loadKerning(const std::string& path, int ySize, const std::vector<wchar_t>& characters, size_t basicCount, std::vector<float>& kerning,
+		std::unordered_map<uint64_t, float>& extraKerning)
+	{
+		FT_Library ft;
+		if (FT_Init_FreeType(&ft))
+			return;
+
+		FT_Face face;
+		if (FT_New_Face(ft, path.c_str(), 0, &face))
+		{
+			FT_Done_FreeType(ft);
+			return;
+		}
+
+		if (FT_HAS_KERNING(face))
+		{
+			FT_Set_Pixel_Sizes(face, 0, ySize);
+
+			std::vector<FT_UInt> glyphIndices(characters.size());
+			for (size_t i(0); i < characters.size(); ++i)
+				glyphIndices[i] = FT_Get_Char_Index(face, characters[i]);
+
+			kerning.assign(basicCount * basicCount, 0.0f);
+			for (size_t left(0); left < characters.size(); ++left)
+			{
+				for (size_t right(0); right < characters.size(); ++right)
+				{
+					FT_Vector delta;
+					if (FT_Get_Kerning(face, glyphIndices[left], glyphIndices[right], FT_KERNING_DEFAULT, &delta) != 0)
+						continue;
+
+					const float value = static_cast<float>(delta.x) / 64.0f; // 26.6 fixed point
+					if (left < basicCount && right < basicCount)
+						kerning[left * basicCount + right] = value;
+					else if (value != 0.0f)
+						extraKerning[(static_cast<uint64_t>(left) << 32) | right] = value;
+				}
+			}
+		}
+
+		FT_Done_Face(face);
+		FT_Done_FreeType(ft);
+	}
+}
+
+Wolf::Font::Font(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, Queue graphicsQueue, int ySize, std::string path, bool signedDistanceField,
+	const std::wstring& extraCharacters)
 {
 	m_device = device;
 	m_physicalDevice = physicalDevice;
@@ -8,57 +180,109 @@ Wolf::Font::Font(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool
 	m_graphicsQueue = graphicsQueue;
 
 	m_maxYSize = ySize;
+	m_sdfSpread = signedDistanceField ? std::max(2, ySize / 8) : 0;
 
-	unsigned int texWidth(0), texHeight(0), texChannels(0);
-	FT_Library ft;
-	if (FT_Init_FreeType(&ft))
-		throw std::runtime_error("Error : freeType init");
+	// Glyph table order
+	std::vector<wchar_t> characters;
+	for (wchar_t c = FIRST_CHARACTER; c <= LAST_CHARACTER; ++c)
+		characters.push_back(c);
+	for (const wchar_t c : extraCharacters)
+	{
+		if (c == ' ' || getGlyphIndex(c) != INVALID_GLYPH)
+			continue;
+		m_extraGlyphIndices[c] = static_cast<uint32_t>(characters.size());
+		characters.push_back(c);
+	}
 
-	FT_Face face;
-	if (FT_New_Face(ft, path.c_str(), 0, &face))
-		throw std::runtime_error("Error : font loading");
+	// Distance fields are costly: characters are split between worker threads, kerning is read by another one
+	std::vector<GlyphBitmap> bitmaps(characters.size());
+	const unsigned int threadCount = signedDistanceField ? std::max(1u, std::min(std::thread::hardware_concurrency(), 8u)) : 1;
+	std::vector<std::string> errors(threadCount);
+	std::vector<std::thread> threads;
+	threads.emplace_back(loadKerning, std::cref(path), ySize, std::cref(characters), static_cast<size_t>(BASIC_GLYPH_COUNT), std::ref(m_kerning), std::ref(m_extraKerning));
+	for (unsigned int i(1); i < threadCount; ++i)
+		threads.emplace_back(rasterizeGlyphs, std::cref(path), ySize, m_sdfSpread, std::cref(characters), i, threadCount, std::ref(bitmaps), std::ref(errors[i]));
+	rasterizeGlyphs(path, ySize, m_sdfSpread, characters, 0, threadCount, bitmaps, errors[0]);
+	for (std::thread& thread : threads)
+		thread.join();
 
-	FT_Set_Pixel_Sizes(face, 0, ySize);
+	for (const std::string& error : errors)
+		if (!error.empty())
+			throw std::runtime_error(error);
 
-	for (wchar_t c = 33; c < 123; ++c)
+	m_glyphs.resize(bitmaps.size());
+	uint32_t totalArea = 0;
+	for (size_t i(0); i < bitmaps.size(); ++i)
 	{
-		if (FT_Load_Char(face, c, FT_LOAD_RENDER))
-			throw std::runtime_error(&"Error : character loading "[c]);
+		Glyph& glyph = m_glyphs[i];
+		glyph.xSize = bitmaps[i].width - 2 * m_sdfSpread;
+		glyph.ySize = bitmaps[i].height - 2 * m_sdfSpread;
+		glyph.bearingX = bitmaps[i].left;
+		glyph.bearingY = static_cast<int>(glyph.ySize) - bitmaps[i].top;
 
-		if (FT_Render_Glyph(face->glyph, FT_RENDER_MODE_NORMAL)) /* convert to an anti-aliased bitmap */
-			throw std::runtime_error(&"Error : render glyph "[c]);
+		totalArea += (bitmaps[i].width + GLYPH_PADDING) * (bitmaps[i].height + GLYPH_PADDING);
+	}
 
-		texWidth = face->glyph->bitmap.width;
-		texHeight = face->glyph->bitmap.rows;
+	const float referenceXSize = static_cast<float>(getXSize('a'));
+	m_spaceAdvance = referenceXSize * 0.5f;
+	m_letterSpacing = referenceXSize * 0.1f;
 
-		if (texWidth == 0 || texHeight == 0)
-			throw std::runtime_error(&"Error : create pixel from character "[c]);
+	// Smallest power of two square holding every glyph with some packing loss, extra glyphs go in new pages
+	uint32_t atlasSize = 64;
+	while (atlasSize < MAX_ATLAS_SIZE && atlasSize * atlasSize < totalArea + totalArea / 4)
+		atlasSize *= 2;
 
-		auto* pixels = new unsigned char[static_cast<size_t>(texWidth) * texHeight];
-		memcpy(pixels, face->glyph->bitmap.buffer, static_cast<size_t>(texWidth) * texHeight);
+	// Shelf packing, tallest glyphs first
+	std::vector<size_t> order(m_glyphs.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return bitmaps[a].height > bitmaps[b].height; });
 
-		m_characters[c].xSize = texWidth;
-		m_characters[c].ySize = texHeight;
-		m_characters[c].bearingX = face->glyph->bitmap_left;
-		m_characters[c].bearingY = texHeight - face->glyph->bitmap_top;
+	std::vector<std::vector<unsigned char>> pages(1, std::vector<unsigned char>(static_cast<size_t>(atlasSize) * atlasSize, 0));
+	uint32_t shelfX = GLYPH_PADDING, shelfY = GLYPH_PADDING, shelfHeight = 0;
+	for (size_t i : order)
+	{
+		const GlyphBitmap& bitmap = bitmaps[i];
+		if (bitmap.width + 2 * GLYPH_PADDING > atlasSize || bitmap.height + 2 * GLYPH_PADDING > atlasSize)
+			throw std::runtime_error("Error : glyph bigger than the font atlas");
 
-		m_images.emplace_back();
-		VkExtent3D extent3D = { texWidth, texHeight, 1 };
+		if (shelfX + bitmap.width + GLYPH_PADDING > atlasSize)
+		{
+			shelfX = GLYPH_PADDING;
+			shelfY += shelfHeight + GLYPH_PADDING;
+			shelfHeight = 0;
+		}
+		if (shelfY + bitmap.height + GLYPH_PADDING > atlasSize)
+		{
+			pages.emplace_back(static_cast<size_t>(atlasSize) * atlasSize, 0);
+			shelfX = GLYPH_PADDING;
+			shelfY = GLYPH_PADDING;
+			shelfHeight = 0;
+		}
 
-		Image::CreateImageInfo createImageInfo;
-		createImageInfo.extent = extent3D;
-		createImageInfo.format = VK_FORMAT_R8_UNORM;
-		createImageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-		m_images[m_images.size() - 1] = std::make_unique<Image>(m_device, m_physicalDevice, m_commandPool, m_graphicsQueue, createImageInfo);
-		m_images.back()->copyPixels(pixels);
+		std::vector<unsigned char>& page = pages.back();
+		for (unsigned int y(0); y < bitmap.height; ++y)
+			memcpy(page.data() + static_cast<size_t>(shelfY + y) * atlasSize + shelfX, bitmap.pixels.data() + static_cast<size_t>(y) * bitmap.width, bitmap.width);
 
-		m_characters[c].textureID = static_cast<unsigned int>(m_images.size() - 1);
+		Glyph& glyph = m_glyphs[i];
+		glyph.page = static_cast<unsigned int>(pages.size() - 1);
+		glyph.uvMin = glm::vec2(shelfX, shelfY) / static_cast<float>(atlasSize);
+		glyph.uvMax = glm::vec2(shelfX + bitmap.width, shelfY + bitmap.height) / static_cast<float>(atlasSize);
 
-		delete[] pixels;
+		shelfX += bitmap.width + GLYPH_PADDING;
+		shelfHeight = std::max(shelfHeight, bitmap.height);
 	}
 
-	FT_Done_Face(face);
-	FT_Done_FreeType(ft);
+	// One upload per page, no mips as they would mix neighbour glyphs
+	for (std::vector<unsigned char>& page : pages)
+	{
+		Image::CreateImageInfo createImageInfo;
+		createImageInfo.extent = { atlasSize, atlasSize, 1 };
+		createImageInfo.format = VK_FORMAT_R8_UNORM;
+		createImageInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		createImageInfo.mipLevels = 1;
+		m_images.push_back(std::make_unique<Image>(m_device, m_physicalDevice, m_commandPool, m_graphicsQueue, createImageInfo));
+		m_images.back()->copyPixels(page.data());
+	}
 
 	m_sampler = std::make_unique<Sampler>(device, VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE, 1.0f, VK_FILTER_LINEAR);
 }
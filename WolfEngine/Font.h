@@ -3,42 +3,30 @@
 #include <ft2build.h>
 #include FT_FREETYPE_H
 
-#include <map>
-
 #include "VulkanElement.h"
 #include "Image.h"
 #include "Sampler.h"
+#include "FontLayout.h"
 
 namespace Wolf
 {
-	class Font : public VulkanElement
+	// Glyphs are packed in a few R8 atlas pages (uploaded once each), metrics, kerning and layout are in FontLayout.
+	// signedDistanceField: pages store distances to the glyph edge (0.5 on the edge, +-0.5 at getSDFSpread() pixels of ySize) generated on worker threads,
+	// a single font then serves every text size: the shader reconstructs the edge with smoothstep(0.5 - w, 0.5 + w, distance), w ~ fwidth(distance)
+	class Font : public VulkanElement, public FontLayout
 	{
 	public:
-		Font(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, Queue graphicsQueue, int ySize, std::string path);
+		Font(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, Queue graphicsQueue, int ySize, std::string path, bool signedDistanceField = false,
+			const std::wstring& extraCharacters = L"");
 
-		unsigned int getXSize(const wchar_t character) { return m_characters[character].xSize; }
-		unsigned int getYSize(const wchar_t character) { return m_characters[character].ySize; }
-		unsigned int getBearingX(const wchar_t character) { return m_characters[character].bearingX; }
-		unsigned int getBearingY(const wchar_t character) { return m_characters[character].bearingY; }
-		int getMaxSizeY() const { return m_maxYSize; }
-		unsigned int getMaterialID(const wchar_t character) { return m_characters[character].textureID; }
+		unsigned int getMaterialID(const wchar_t character) const { return getGlyph(getGlyphIndex(character)).page; } // atlas page
+		glm::vec2 getUVMin(const wchar_t character) const { return getGlyph(getGlyphIndex(character)).uvMin; }
+		glm::vec2 getUVMax(const wchar_t character) const { return getGlyph(getGlyphIndex(character)).uvMax; }
 		std::vector<Image*> getImages();
 		Wolf::Sampler* getSampler() { return m_sampler.get(); }
 
 	private:
-		struct Character
-		{
-			unsigned int xSize = 0; // in pixel
-			unsigned int ySize = 0;
-			unsigned int bearingX = 0;
-			unsigned int bearingY = 0;
-
-			unsigned int textureID = 0;;
-		};
-
-		std::map<wchar_t, Character> m_characters;
 		std::vector<std::unique_ptr<Image>> m_images;
 		std::unique_ptr<Sampler> m_sampler;
-		int m_maxYSize;
 	};
-}
\ No newline at end of file
+}
@@ -0,0 +1,91 @@
+#include "FontLayout.h"
+
+void Wolf::FontLayout::GlyphLayout::clear()
+{
+	minX.clear();
+	minY.clear();
+	maxX.clear();
+	maxY.clear();
+	glyphIndices.clear();
+	firstGlyphs.clear();
+	widths.clear();
+}
+
+void Wolf::FontLayout::layout(const std::wstring* const* strings, size_t stringCount, GlyphLayout& output) const
+{
+	output.clear();
+
+	// Pen positions and glyph metrics (minX = pen, maxX = width, minY = top, maxY = bottom)
+	const float maxSizeY = static_cast<float>(m_maxYSize);
+	for (size_t i(0); i < stringCount; ++i)
+	{
+		output.firstGlyphs.push_back(static_cast<uint32_t>(output.glyphIndices.size()));
+
+		float penX = 0.0f;
+		uint32_t previousGlyphIndex = INVALID_GLYPH;
+		for (const wchar_t character : *strings[i])
+		{
+			const uint32_t glyphIndex = getGlyphIndex(character);
+			if (glyphIndex == INVALID_GLYPH) // spaces and unknown characters
+			{
+				penX += m_spaceAdvance;
+				previousGlyphIndex = INVALID_GLYPH;
+				continue;
+			}
+
+			if (previousGlyphIndex != INVALID_GLYPH)
+				penX += getKerning(previousGlyphIndex, glyphIndex);
+
+			const Glyph& glyph = m_glyphs[glyphIndex];
+			output.glyphIndices.push_back(glyphIndex);
+			output.minX.push_back(penX);
+			output.maxX.push_back(static_cast<float>(glyph.xSize));
+			output.minY.push_back(maxSizeY - static_cast<float>(glyph.ySize) + static_cast<float>(glyph.bearingY));
+			output.maxY.push_back(maxSizeY + static_cast<float>(glyph.bearingY));
+
+			penX += static_cast<float>(glyph.xSize) + m_letterSpacing;
+			previousGlyphIndex = glyphIndex;
+		}
+
+		output.widths.push_back(penX);
+	}
+	output.firstGlyphs.push_back(static_cast<uint32_t>(output.glyphIndices.size()));
+
+	// Boxes, independent iterations on contiguous arrays (vectorized by the compiler)
+	const float spread = static_cast<float>(m_sdfSpread);
+	const size_t glyphCount = output.glyphIndices.size();
+	float* minX = output.minX.data();
+	float* minY = output.minY.data();
+	float* maxX = output.maxX.data();
+	float* maxY = output.maxY.data();
+	for (size_t i(0); i < glyphCount; ++i)
+	{
+		maxX[i] = minX[i] + maxX[i] + spread;
+		minX[i] -= spread;
+		minY[i] -= spread;
+		maxY[i] += spread;
+	}
+}
+
+float Wolf::FontLayout::getWidth(const std::wstring& string) const
+{
+	float width = 0.0f;
+	uint32_t previousGlyphIndex = INVALID_GLYPH;
+	for (const wchar_t character : string)
+	{
+		const uint32_t glyphIndex = getGlyphIndex(character);
+		if (glyphIndex == INVALID_GLYPH)
+		{
+			width += m_spaceAdvance;
+			previousGlyphIndex = INVALID_GLYPH;
+			continue;
+		}
+
+		if (previousGlyphIndex != INVALID_GLYPH)
+			width += getKerning(previousGlyphIndex, glyphIndex);
+		width += static_cast<float>(m_glyphs[glyphIndex].xSize) + m_letterSpacing;
+		previousGlyphIndex = glyphIndex;
+	}
+
+	return width;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+namespace Wolf
+{
+	// CPU side of a font: flat glyph table and kerning, and the string layout. Characters 33-122 are indexed directly,
+	// extra characters (ex: accented letters) are found with a hash map. Kerning of characters 33-122 is a dense table,
+	// nonzero pairs involving extra characters are kept in a hash map. Filled by Font, no Vulkan or FreeType dependency
+	class FontLayout
+	{
+	public:
+		struct Glyph
+		{
+			unsigned int xSize = 0; // in pixel
+			unsigned int ySize = 0;
+			int bearingX = 0;
+			int bearingY = 0;
+
+			unsigned int page = 0;
+			glm::vec2 uvMin = glm::vec2(0.0f);
+			glm::vec2 uvMax = glm::vec2(0.0f);
+		};
+		static constexpr uint32_t INVALID_GLYPH = UINT32_MAX;
+		uint32_t getGlyphIndex(const wchar_t character) const
+		{
+			if (character >= FIRST_CHARACTER && character <= LAST_CHARACTER)
+				return character - FIRST_CHARACTER;
+			const auto it = m_extraGlyphIndices.find(character);
+			return it != m_extraGlyphIndices.end() ? it->second : INVALID_GLYPH;
+		}
+		const Glyph& getGlyph(uint32_t glyphIndex) const { return glyphIndex < m_glyphs.size() ? m_glyphs[glyphIndex] : m_emptyGlyph; }
+		float getKerning(uint32_t leftGlyphIndex, uint32_t rightGlyphIndex) const
+		{
+			if (leftGlyphIndex < BASIC_GLYPH_COUNT && rightGlyphIndex < BASIC_GLYPH_COUNT)
+				return m_kerning.empty() ? 0.0f : m_kerning[leftGlyphIndex * BASIC_GLYPH_COUNT + rightGlyphIndex];
+			if (m_extraKerning.empty())
+				return 0.0f;
+			const auto it = m_extraKerning.find(getKerningKey(leftGlyphIndex, rightGlyphIndex));
+			return it != m_extraKerning.end() ? it->second : 0.0f;
+		}
+
+		unsigned int getXSize(const wchar_t character) const { return getGlyph(getGlyphIndex(character)).xSize; }
+		unsigned int getYSize(const wchar_t character) const { return getGlyph(getGlyphIndex(character)).ySize; }
+		int getBearingX(const wchar_t character) const { return getGlyph(getGlyphIndex(character)).bearingX; }
+		int getBearingY(const wchar_t character) const { return getGlyph(getGlyphIndex(character)).bearingY; }
+		int getMaxSizeY() const { return m_maxYSize; }
+		int getSDFSpread() const { return m_sdfSpread; } // glyph quads are extended by this size (pixels of ySize), 0 for bitmap fonts
+
+		// Glyph quads of many strings, in pixels of ySize from each string origin (SDF spread included), as flat arrays
+		struct GlyphLayout
+		{
+			std::vector<float> minX;
+			std::vector<float> minY;
+			std::vector<float> maxX;
+			std::vector<float> maxY;
+			std::vector<uint32_t> glyphIndices;
+			std::vector<uint32_t> firstGlyphs; // per string, + total glyph count
+			std::vector<float> widths; // per string
+
+			void clear();
+		};
+		// One pass over every string: table lookups and kerning, then box arithmetic on contiguous arrays. Output memory is reused between calls
+		void layout(const std::wstring* const* strings, size_t stringCount, GlyphLayout& output) const;
+		float getWidth(const std::wstring& string) const; // in pixels of ySize
+
+		static constexpr wchar_t FIRST_CHARACTER = 33;
+		static constexpr wchar_t LAST_CHARACTER = 122;
+		static constexpr uint32_t BASIC_GLYPH_COUNT = LAST_CHARACTER - FIRST_CHARACTER + 1;
+
+	protected:
+		static uint64_t getKerningKey(uint32_t leftGlyphIndex, uint32_t rightGlyphIndex) { return (static_cast<uint64_t>(leftGlyphIndex) << 32) | rightGlyphIndex; }
+
+	protected:
+		std::vector<Glyph> m_glyphs; // FIRST_CHARACTER to LAST_CHARACTER, then extra characters
+		std::unordered_map<wchar_t, uint32_t> m_extraGlyphIndices;
+		std::vector<float> m_kerning; // BASIC_GLYPH_COUNT * BASIC_GLYPH_COUNT, empty if the font has no kerning
+		std::unordered_map<uint64_t, float> m_extraKerning; // nonzero pairs with an extra glyph, see getKerningKey
+		Glyph m_emptyGlyph;
+		float m_spaceAdvance = 0.0f;
+		float m_letterSpacing = 0.0f;
+
+		int m_maxYSize = 0;
+		int m_sdfSpread = 0;
+	};
+}
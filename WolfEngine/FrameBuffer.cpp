@@ -30,6 +30,7 @@ bool Wolf::Framebuffer::initialize(VkDevice device, VkPhysicalDevice physicalDev
 			createImageInfo.sampleCount = attachments[i].sampleCount;
 			createImageInfo.aspect = aspect;
 			createImageInfo.mipLevels = 1;
+			createImageInfo.arrayLayers = attachments[i].arrayLayers;
 			m_images[i] = std::make_unique<Image>(device, physicalDevice, commandPool, graphicsQueue, createImageInfo);
 			imageViewAttachments[i] = m_images[i]->getImageView();
 		}
@@ -92,6 +93,7 @@ bool Wolf::Framebuffer::initialize(VkDevice device, VkPhysicalDevice physicalDev
 			createImageInfo.sampleCount = attachments[i].sampleCount;
 			createImageInfo.aspect = aspect;
 			createImageInfo.mipLevels = 1;
+			createImageInfo.arrayLayers = attachments[i].arrayLayers;
 			m_images[currentImage] = std::make_unique<Image>(device, physicalDevice, commandPool, graphicsQueue, createImageInfo);
 
 			imageViewAttachments[i] = m_images[currentImage]->getImageView();
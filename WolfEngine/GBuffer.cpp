@@ -1,7 +1,7 @@
 #include "GBuffer.h"
 
 Wolf::GBuffer::GBuffer(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, int commandBufferID, VkExtent2D extent,
-	VkSampleCountFlagBits sampleCount, Model* model, glm::mat4 mvp, bool useDepthAsStorage)
+	VkSampleCountFlagBits sampleCount, Model* model, glm::mat4 mvp, bool useDepthAsStorage, bool useDepthPrePass, bool dynamicResolution)
 {
 	m_engineInstance = engineInstance;
 	m_scene = scene;
@@ -12,6 +12,7 @@ Wolf::GBuffer::GBuffer(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, i
 	renderPassCreateInfo.name = "GBuffer";
 	renderPassCreateInfo.commandBufferID = commandBufferID;
 	renderPassCreateInfo.outputIsSwapChain = false;
+	renderPassCreateInfo.dynamicResolution = dynamicResolution;
 
 	// Attachments -> depth + (normal compressed + roughness + metal) + (albedo + alpha)
 	m_attachments.resize(3);
@@ -52,6 +53,60 @@ Wolf::GBuffer::GBuffer(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, i
 	// Data
 	m_uboMVP = engineInstance->createUniformBufferObject(&m_mvp, 3 * sizeof(glm::mat4));
 
+	// Bindless: textures are read from the global table (set 1), the layout doesn't depend on the material count.
+	// Vertex material IDs are local to the model, the first material of the model in the table is pushed (uint, fragment stage, offset 0)
+	BindlessTextures* bindlessTextures = model->getBindlessTextures();
+	const uint32_t firstBindlessMaterial = model->getFirstBindlessMaterial();
+	const VkPushConstantRange bindlessPushConstantRange = { VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(uint32_t) };
+
+	DescriptorSetGenerator descriptorSetGenerator;
+	descriptorSetGenerator.addUniformBuffer(m_uboMVP, VK_SHADER_STAGE_VERTEX_BIT, 0);
+	if (!bindlessTextures)
+	{
+		descriptorSetGenerator.addSampler(model->getSampler(), VK_SHADER_STAGE_FRAGMENT_BIT, 1);
+		descriptorSetGenerator.addImages(model->getImages(), VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT, 2);
+	}
+
+	// Depth pre-pass: renderers are recorded in creation order so depth is filled before the material pass.
+	// Same vertex shader as the material pass so depths match exactly, the fragment shader only alpha tests.
+	if (useDepthPrePass)
+	{
+		RendererCreateInfo depthPrePassCreateInfo;
+
+		ShaderCreateInfo vertexShaderCreateInfo{};
+		vertexShaderCreateInfo.filename = "Shaders/GBuffer/vert.spv";
+		vertexShaderCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+		depthPrePassCreateInfo.pipelineCreateInfo.shaderCreateInfos.push_back(vertexShaderCreateInfo);
+
+		ShaderCreateInfo fragmentShaderCreateInfo{};
+		fragmentShaderCreateInfo.filename = bindlessTextures ? "Shaders/GBuffer/depthPrePassBindlessFrag.spv" : "Shaders/GBuffer/depthPrePassFrag.spv";
+		fragmentShaderCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		depthPrePassCreateInfo.pipelineCreateInfo.shaderCreateInfos.push_back(fragmentShaderCreateInfo);
+
+		depthPrePassCreateInfo.inputVerticesTemplate = InputVertexTemplate::FULL_3D_MATERIAL;
+		depthPrePassCreateInfo.instanceTemplate = InstanceTemplate::NO;
+		depthPrePassCreateInfo.renderPassID = m_renderPassID;
+		depthPrePassCreateInfo.pipelineCreateInfo.extent = extent;
+		depthPrePassCreateInfo.pipelineCreateInfo.alphaBlending = { false, false };
+		depthPrePassCreateInfo.pipelineCreateInfo.enableColorWrites = false;
+		depthPrePassCreateInfo.descriptorSetLayout = descriptorSetGenerator.getDescriptorLayouts();
+		depthPrePassCreateInfo.bindlessTextures = bindlessTextures;
+		if (bindlessTextures)
+			depthPrePassCreateInfo.pipelineCreateInfo.pushConstantRanges.push_back(bindlessPushConstantRange);
+
+		m_depthPrePassRendererID = m_scene->addRenderer(depthPrePassCreateInfo);
+
+		Renderer::AddMeshInfo addMeshInfo{};
+		addMeshInfo.vertexBuffer = model->getVertexBuffers()[0];
+		addMeshInfo.renderPassID = m_renderPassID;
+		addMeshInfo.rendererID = m_depthPrePassRendererID;
+		addMeshInfo.descriptorSetCreateInfo = descriptorSetGenerator.getDescritorSetCreateInfo();
+		if (bindlessTextures)
+			addMeshInfo.setPushConstants(firstBindlessMaterial);
+
+		m_scene->addMesh(addMeshInfo);
+	}
+
 	// Renderer
 	RendererCreateInfo rendererCreateInfo;
 
@@ -61,7 +116,7 @@ Wolf::GBuffer::GBuffer(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, i
 	rendererCreateInfo.pipelineCreateInfo.shaderCreateInfos.push_back(vertexShaderCreateInfo);
 
 	ShaderCreateInfo fragmentShaderCreateInfo{};
-	fragmentShaderCreateInfo.filename = "Shaders/GBuffer/frag.spv";
+	fragmentShaderCreateInfo.filename = bindlessTextures ? "Shaders/GBuffer/bindlessFrag.spv" : "Shaders/GBuffer/frag.spv";
 	fragmentShaderCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 	rendererCreateInfo.pipelineCreateInfo.shaderCreateInfos.push_back(fragmentShaderCreateInfo);
 	
@@ -70,12 +125,17 @@ Wolf::GBuffer::GBuffer(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, i
 	rendererCreateInfo.renderPassID = m_renderPassID;
 	rendererCreateInfo.pipelineCreateInfo.extent = extent;
 
-	DescriptorSetGenerator descriptorSetGenerator;
-	descriptorSetGenerator.addUniformBuffer(m_uboMVP, VK_SHADER_STAGE_VERTEX_BIT, 0);
-	descriptorSetGenerator.addSampler(model->getSampler(), VK_SHADER_STAGE_FRAGMENT_BIT, 1);
-	descriptorSetGenerator.addImages(model->getImages(), VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT, 2);
+	// Only the visible surface remains after the pre-pass, no overdraw on the material outputs
+	if (useDepthPrePass)
+	{
+		rendererCreateInfo.pipelineCreateInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+		rendererCreateInfo.pipelineCreateInfo.enableDepthWrite = VK_FALSE;
+	}
 
 	rendererCreateInfo.descriptorSetLayout = descriptorSetGenerator.getDescriptorLayouts();
+	rendererCreateInfo.bindlessTextures = bindlessTextures;
+	if (bindlessTextures)
+		rendererCreateInfo.pipelineCreateInfo.pushConstantRanges.push_back(bindlessPushConstantRange);
 	
 	rendererCreateInfo.pipelineCreateInfo.alphaBlending = { false, false };
 
@@ -87,6 +147,8 @@ Wolf::GBuffer::GBuffer(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, i
 	addMeshInfo.rendererID = m_rendererID;
 
 	addMeshInfo.descriptorSetCreateInfo = descriptorSetGenerator.getDescritorSetCreateInfo();
+	if (bindlessTextures)
+		addMeshInfo.setPushConstants(firstBindlessMaterial);
 
 	m_scene->addMesh(addMeshInfo);
 }
@@ -11,13 +11,14 @@ namespace Wolf
 	{
 	public:
 		GBuffer(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, int commandBufferID, VkExtent2D extent, VkSampleCountFlagBits sampleCount,
-			Model* model, glm::mat4 mvp, bool useDepthAsStorage);
+			Model* model, glm::mat4 mvp, bool useDepthAsStorage, bool useDepthPrePass = false, bool dynamicResolution = false);
 
 		void updateMVPMatrix(glm::mat4 m, glm::mat4 v, glm::mat4 p);
 		Image* getDepth() { return m_scene->getRenderPassOutput(m_renderPassID, 0); }
 		Image* getAlbedo() { return m_scene->getRenderPassOutput(m_renderPassID, 2); }
 		//Image* getViewPos() { return m_scene->getRenderPassOutput(m_renderPassID, 1); }
 		Image* getNormalRoughnessMetal() { return m_scene->getRenderPassOutput(m_renderPassID, 1); }
+		float getGPUTime() const { return m_scene->getRenderPassGPUTime(m_renderPassID); } // requires SceneCreateInfo::enableGPUTimings
 		//Image* getRoughnessMetalAO() { return m_scene->getRenderPassOutput(m_renderPassID, 4); }
 		
 	private:
@@ -32,6 +33,7 @@ namespace Wolf
 		UniformBuffer* m_uboMVP;
 		std::array<glm::mat4, 3> m_mvp;
 		int m_rendererID;
+		int m_depthPrePassRendererID = -1;
 
 		VkSampleCountFlagBits m_sampleCount = VK_SAMPLE_COUNT_1_BIT;
 	};
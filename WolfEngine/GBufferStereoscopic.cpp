@@ -1,12 +1,24 @@
 #include "GBufferStereoscopic.h"
 
 Wolf::GBufferStereoscopic::GBufferStereoscopic(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, int commandBufferID, 
-	VkExtent2D extent, VkSampleCountFlagBits sampleCount, Model* model, glm::mat4 mvp, bool useDepthAsStorage)
+	VkExtent2D extent, VkSampleCountFlagBits sampleCount, Model* model, glm::mat4 mvp, bool useDepthAsStorage, bool useMultiview)
 {
 	m_engineInstance = engineInstance;
 	m_scene = scene;
 	m_sampleCount = sampleCount;
 
+	m_useMultiview = useMultiview;
+	if (m_useMultiview && !engineInstance->getHardwareCapabilities().multiviewAvailable)
+	{
+		Debug::sendWarning("Multiview is not supported, rendering each eye separately");
+		m_useMultiview = false;
+	}
+
+	// Multiview renders each eye in its own layer
+	const uint32_t layerCount = m_useMultiview ? 2 : 1;
+	if (m_useMultiview)
+		extent.width /= 2;
+
 	// Render Pass
 	Scene::RenderPassCreateInfo renderPassCreateInfo{};
 	renderPassCreateInfo.name = "GBuffer Stereoscopic";
@@ -31,6 +43,8 @@ Wolf::GBufferStereoscopic::GBufferStereoscopic(Wolf::WolfInstance* engineInstanc
 	m_attachments[0] = Attachment(extent, VK_FORMAT_D32_SFLOAT, m_sampleCount, depthFinalLayout, depthStoreOp, depthUsage);
 	m_attachments[1] = Attachment(extent, VK_FORMAT_R8G8B8A8_UNORM, m_sampleCount, VK_IMAGE_LAYOUT_GENERAL, VK_ATTACHMENT_STORE_OP_STORE, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
 	m_attachments[2] = Attachment(extent, VK_FORMAT_R8G8B8A8_UNORM, m_sampleCount, VK_IMAGE_LAYOUT_GENERAL, VK_ATTACHMENT_STORE_OP_STORE, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
+	for (Attachment& attachment : m_attachments)
+		attachment.arrayLayers = layerCount;
 
 	m_clearValues.resize(3);
 	m_clearValues[0] = { 1.0f };
@@ -49,6 +63,52 @@ Wolf::GBufferStereoscopic::GBufferStereoscopic(Wolf::WolfInstance* engineInstanc
 
 	m_renderPassID = m_scene->addRenderPass(renderPassCreateInfo);
 
+	if (m_useMultiview)
+	{
+		// Data
+		m_ubMultiviewMatrices = engineInstance->createUniformBufferObject(&m_multiviewMatrices, sizeof(MultiviewMatrices));
+
+		// Renderer
+		RendererCreateInfo rendererCreateInfo;
+
+		ShaderCreateInfo vertexShaderCreateInfo{};
+		vertexShaderCreateInfo.filename = "Shaders/GBuffer/multiviewVert.spv";
+		vertexShaderCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+		rendererCreateInfo.pipelineCreateInfo.shaderCreateInfos.push_back(vertexShaderCreateInfo);
+
+		ShaderCreateInfo fragmentShaderCreateInfo{};
+		fragmentShaderCreateInfo.filename = "Shaders/GBuffer/frag.spv";
+		fragmentShaderCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		rendererCreateInfo.pipelineCreateInfo.shaderCreateInfos.push_back(fragmentShaderCreateInfo);
+
+		rendererCreateInfo.inputVerticesTemplate = InputVertexTemplate::FULL_3D_MATERIAL;
+		rendererCreateInfo.instanceTemplate = InstanceTemplate::NO;
+		rendererCreateInfo.renderPassID = m_renderPassID;
+		rendererCreateInfo.pipelineCreateInfo.extent = extent;
+
+		DescriptorSetGenerator descriptorSetGenerator;
+		descriptorSetGenerator.addUniformBuffer(m_ubMultiviewMatrices, VK_SHADER_STAGE_VERTEX_BIT, 0);
+		descriptorSetGenerator.addSampler(model->getSampler(), VK_SHADER_STAGE_FRAGMENT_BIT, 1);
+		descriptorSetGenerator.addImages(model->getImages(), VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT, 2);
+
+		rendererCreateInfo.descriptorSetLayout = descriptorSetGenerator.getDescriptorLayouts();
+
+		rendererCreateInfo.pipelineCreateInfo.alphaBlending = { false, false };
+
+		m_multiviewRendererID = m_scene->addRenderer(rendererCreateInfo);
+
+		Renderer::AddMeshInfo addMeshInfo{};
+		addMeshInfo.vertexBuffer = model->getVertexBuffers()[0];
+		addMeshInfo.renderPassID = m_renderPassID;
+		addMeshInfo.rendererID = m_multiviewRendererID;
+
+		addMeshInfo.descriptorSetCreateInfo = descriptorSetGenerator.getDescritorSetCreateInfo();
+
+		m_scene->addMesh(addMeshInfo);
+
+		return;
+	}
+
 	for (int eye = 0; eye < 2; ++eye)
 	{
 		// Data
@@ -104,6 +164,13 @@ Wolf::GBufferStereoscopic::GBufferStereoscopic(Wolf::WolfInstance* engineInstanc
 
 void Wolf::GBufferStereoscopic::updateMatrices(glm::mat4 m, glm::mat4 v0, glm::mat4 v1, glm::mat4 p0, glm::mat4 p1)
 {
+	if (m_useMultiview)
+	{
+		m_multiviewMatrices = { { p0, p1 }, m, { v0, v1 } };
+		m_ubMultiviewMatrices->updateData(&m_multiviewMatrices);
+		return;
+	}
+
 	m_renderElements[0].mvp = { p0, m, v0 };
 	m_renderElements[0].ubMVP->updateData(&m_renderElements[0].mvp);
 
@@ -11,7 +11,7 @@ namespace Wolf
 	{
 	public:
 		GBufferStereoscopic(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, int commandBufferID, VkExtent2D extent, VkSampleCountFlagBits sampleCount,
-			Model* model, glm::mat4 mvp, bool useDepthAsStorage);
+			Model* model, glm::mat4 mvp, bool useDepthAsStorage, bool useMultiview = false);
 
 		void updateMatrices(glm::mat4 m, glm::mat4 v0, glm::mat4 v1, glm::mat4 p0, glm::mat4 p1);
 
@@ -19,6 +19,9 @@ namespace Wolf
 		Image* getAlbedo() { return m_scene->getRenderPassOutput(m_renderPassID, 2); }
 		Image* getNormalRoughnessMetal() { return m_scene->getRenderPassOutput(m_renderPassID, 1); }
 
+		// Outputs are 2-layer arrays (layer = eye) at half width instead of side by side images
+		bool isMultiview() const { return m_useMultiview; }
+
 	private:
 		Wolf::WolfInstance* m_engineInstance;
 		Wolf::Scene* m_scene;
@@ -36,6 +39,18 @@ namespace Wolf
 		};
 		std::array<RenderElements, 2> m_renderElements;
 
+		// Multiview: one renderer, matrices indexed by gl_ViewIndex
+		struct MultiviewMatrices
+		{
+			std::array<glm::mat4, 2> projections;
+			glm::mat4 model;
+			std::array<glm::mat4, 2> views;
+		};
+		MultiviewMatrices m_multiviewMatrices;
+		UniformBuffer* m_ubMultiviewMatrices = nullptr;
+		int m_multiviewRendererID = -1;
+		bool m_useMultiview = false;
+
 		VkSampleCountFlagBits m_sampleCount = VK_SAMPLE_COUNT_1_BIT;
 	};
 }
@@ -0,0 +1,149 @@
+#include "GPUCulling.h"
+
+Wolf::GPUCulling::GPUCulling(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, const std::vector<ObjectInfo>& objects, const DepthPyramid* depthPyramid)
+{
+	if (objects.empty())
+	{
+		Debug::sendError("GPU culling requires at least one object");
+		return;
+	}
+
+	m_objectCount = static_cast<uint32_t>(objects.size());
+	m_useDrawCount = engineInstance->getHardwareCapabilities().drawIndirectCountAvailable;
+
+	// Object data
+	std::vector<ObjectData> objectData(objects.size());
+	for (size_t i(0); i < objects.size(); ++i)
+	{
+		objectData[i].boundingSphere = glm::vec4(objects[i].boundingSphereCenter, objects[i].boundingSphereRadius);
+		objectData[i].drawInfo = glm::uvec4(objects[i].firstIndex, objects[i].indexCount, static_cast<uint32_t>(objects[i].vertexOffset), 0);
+	}
+
+	const VkDeviceSize objectBufferSize = sizeof(ObjectData) * objectData.size();
+	m_objectBuffer = engineInstance->createBuffer(objectBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	{
+		// Copy waits for completion, the staging buffer is released right after
+		std::unique_ptr<Buffer> stagingBuffer = engineInstance->createStagingBuffer(objectBufferSize);
+		void* data;
+		stagingBuffer->map(&data);
+		memcpy(data, objectData.data(), static_cast<size_t>(objectBufferSize));
+		stagingBuffer->unmap();
+
+		m_objectBuffer->copy(stagingBuffer.get());
+	}
+
+	// Draw commands
+	m_drawCommandBuffer = engineInstance->createBuffer(sizeof(VkDrawIndexedIndirectCommand) * m_objectCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+	if (m_useDrawCount)
+		m_drawCountBuffer = engineInstance->createBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	m_useOcclusion = depthPyramid != nullptr;
+	m_uboData.params = glm::uvec4(m_objectCount, m_useDrawCount ? 1 : 0, 0, 0);
+	m_uboData.previousViewProjection = glm::mat4(1.0f);
+	m_uboData.depthPyramidParams = glm::vec4(0.0f);
+	if (m_useOcclusion)
+		m_uboData.depthPyramidParams = glm::vec4(static_cast<float>(depthPyramid->getExtent().width), static_cast<float>(depthPyramid->getExtent().height),
+			static_cast<float>(depthPyramid->getLevels().size()), 0.0f);
+	extractFrustumPlanes(glm::mat4(1.0f));
+	m_uniformBuffer = engineInstance->createUniformBufferObject(&m_uboData, sizeof(UBOData));
+
+	// Waiting draws read the commands once the culling command buffer has signaled its semaphore
+	Scene::CommandBufferCreateInfo commandBufferCreateInfo;
+	commandBufferCreateInfo.commandType = Scene::CommandType::GRAPHICS;
+	commandBufferCreateInfo.finalPipelineStage = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+	m_commandBufferID = scene->addCommandBuffer(commandBufferCreateInfo);
+
+	Scene::ComputePassCreateInfo computePassCreateInfo;
+	computePassCreateInfo.extent = { m_objectCount, 1 };
+	computePassCreateInfo.dispatchGroups = { 64, 1, 1 };
+	computePassCreateInfo.computeShaderPath = "Shaders/GPUCulling/comp.spv";
+	computePassCreateInfo.commandBufferID = m_commandBufferID;
+	computePassCreateInfo.name = "GPU culling";
+
+	DescriptorSetGenerator descriptorSetGenerator;
+	descriptorSetGenerator.addBuffer(m_objectBuffer, VK_SHADER_STAGE_COMPUTE_BIT, 0);
+	descriptorSetGenerator.addBuffer(m_drawCommandBuffer, VK_SHADER_STAGE_COMPUTE_BIT, 1);
+	// Without draw count the shader writes every command and sets instanceCount to 0 for culled objects
+	descriptorSetGenerator.addBuffer(m_useDrawCount ? m_drawCountBuffer->getBuffer() : m_drawCommandBuffer->getBuffer(), sizeof(uint32_t), VK_SHADER_STAGE_COMPUTE_BIT, 2);
+	descriptorSetGenerator.addUniformBuffer(m_uniformBuffer, VK_SHADER_STAGE_COMPUTE_BIT, 3);
+	if (m_useOcclusion)
+		descriptorSetGenerator.addImages(depthPyramid->getLevels(), VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 4);
+
+	computePassCreateInfo.descriptorSetCreateInfo = descriptorSetGenerator.getDescritorSetCreateInfo();
+
+	if (m_useDrawCount)
+	{
+		computePassCreateInfo.beforeRecord = resetDrawCount;
+		computePassCreateInfo.dataForBeforeRecordCallback = this;
+	}
+
+	m_computePassID = scene->addComputePass(computePassCreateInfo);
+}
+
+void Wolf::GPUCulling::update(glm::mat4 viewProjection)
+{
+	extractFrustumPlanes(viewProjection);
+
+	// The depth pyramid is built after this frame draws, it still holds last frame's depth
+	m_uboData.previousViewProjection = m_previousViewProjection;
+	m_uboData.params.z = m_useOcclusion && m_hasPreviousFrame ? 1 : 0;
+	m_previousViewProjection = viewProjection;
+	m_hasPreviousFrame = true;
+
+	if (m_uniformBuffer)
+		m_uniformBuffer->updateData(&m_uboData);
+}
+
+void Wolf::GPUCulling::extractFrustumPlanes(glm::mat4 viewProjection)
+{
+	// Gribb-Hartmann, depth in [0, 1]
+	const glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+	const glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+	const glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+	const glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+	m_uboData.frustumPlanes[0] = row3 + row0;
+	m_uboData.frustumPlanes[1] = row3 - row0;
+	m_uboData.frustumPlanes[2] = row3 + row1;
+	m_uboData.frustumPlanes[3] = row3 - row1;
+	m_uboData.frustumPlanes[4] = row2;
+	m_uboData.frustumPlanes[5] = row3 - row2;
+
+	for (glm::vec4& plane : m_uboData.frustumPlanes)
+	{
+		const float length = glm::length(glm::vec3(plane));
+		if (length > 0.0f)
+			plane /= length;
+	}
+}
+
+Wolf::IndirectBuffer Wolf::GPUCulling::getIndirectBuffer() const
+{
+	IndirectBuffer indirectBuffer;
+	indirectBuffer.drawCommandBuffer = m_drawCommandBuffer->getBuffer();
+	indirectBuffer.countBuffer = m_drawCountBuffer ? m_drawCountBuffer->getBuffer() : VK_NULL_HANDLE;
+	indirectBuffer.maxDrawCount = m_objectCount;
+
+	return indirectBuffer;
+}
+
+void Wolf::GPUCulling::resetDrawCount(void* data, VkCommandBuffer commandBuffer)
+{
+	const GPUCulling* gpuCulling = static_cast<GPUCulling*>(data);
+
+	vkCmdFillBuffer(commandBuffer, gpuCulling->m_drawCountBuffer->getBuffer(), 0, sizeof(uint32_t), 0);
+
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = gpuCulling->m_drawCountBuffer->getBuffer();
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
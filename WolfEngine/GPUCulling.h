@@ -0,0 +1,68 @@
+#pragma once
+
+#include "WolfEngine.h"
+#include "DepthPyramid.h"
+
+namespace Wolf
+{
+	// Frustum (and optional occlusion) culling of many objects sharing vertex / index buffers, writes one indexed indirect command per object.
+	// Opt-in, not used by the templates. Scene command buffers record render passes before compute passes, so culling has its own command buffer (graphics queue):
+	// submit getCommandBufferID() each frame with { getCommandBufferID(), <draw command buffer> } in the frame synchronization, and set getIndirectBuffer() as AddMeshInfo::indirectBuffer
+	class GPUCulling
+	{
+	public:
+		struct ObjectInfo
+		{
+			glm::vec3 boundingSphereCenter;
+			float boundingSphereRadius;
+
+			// Sub-range of the shared vertex / index buffers
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			int32_t vertexOffset;
+		};
+
+		// With a depth pyramid, objects are also tested against last frame's depth reprojected with last frame's view projection
+		GPUCulling(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, const std::vector<ObjectInfo>& objects, const DepthPyramid* depthPyramid = nullptr);
+
+		void update(glm::mat4 viewProjection);
+		void resetOcclusionHistory() { m_hasPreviousFrame = false; } // camera cuts, the previous depth doesn't match anymore
+
+		int getCommandBufferID() const { return m_commandBufferID; }
+		IndirectBuffer getIndirectBuffer() const;
+		Buffer* getObjectBuffer() { return m_objectBuffer; }
+
+	private:
+		static void resetDrawCount(void* data, VkCommandBuffer commandBuffer);
+		void extractFrustumPlanes(glm::mat4 viewProjection);
+
+	private:
+		int m_commandBufferID = -1;
+		int m_computePassID = -1;
+		uint32_t m_objectCount = 0;
+		bool m_useDrawCount = false;
+		bool m_useOcclusion = false;
+		bool m_hasPreviousFrame = false;
+		glm::mat4 m_previousViewProjection = glm::mat4(1.0f);
+
+		// GPU layout of ObjectInfo (std430)
+		struct ObjectData
+		{
+			glm::vec4 boundingSphere;
+			glm::uvec4 drawInfo; // first index, index count, vertex offset, unused
+		};
+		Buffer* m_objectBuffer = nullptr;
+		Buffer* m_drawCommandBuffer = nullptr;
+		Buffer* m_drawCountBuffer = nullptr;
+
+		struct UBOData
+		{
+			std::array<glm::vec4, 6> frustumPlanes;
+			glm::uvec4 params; // object count, compact commands (draw count available), occlusion test enabled
+			glm::mat4 previousViewProjection;
+			glm::vec4 depthPyramidParams; // level 0 width, height, level count
+		};
+		UBOData m_uboData;
+		UniformBuffer* m_uniformBuffer = nullptr;
+	};
+}
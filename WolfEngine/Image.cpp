@@ -25,9 +25,22 @@ Wolf::Image::Image(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPo
 
 	if (m_extent.depth == 1)
 	{
-		m_imageView = createImageView(device, m_image, m_imageFormat, createImageInfo.aspect, m_mipLevels, m_arrayLayers == 6 ? VK_IMAGE_VIEW_TYPE_CUBE : VK_IMAGE_VIEW_TYPE_2D);
+		VkImageViewType viewType = VK_IMAGE_VIEW_TYPE_2D;
+		if (m_arrayLayers == 6)
+			viewType = VK_IMAGE_VIEW_TYPE_CUBE;
+		else if (m_arrayLayers > 1)
+			viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY; // ex: multiview attachments, one layer per view
+		m_imageView = createImageView(device, m_image, m_imageFormat, createImageInfo.aspect, m_mipLevels, viewType, m_arrayLayers);
 	}
 	else m_imageView = createImageView(device, m_image, m_imageFormat, createImageInfo.aspect, m_mipLevels, VK_IMAGE_VIEW_TYPE_3D);
+
+	// Storage image descriptors can only address one level
+	if (m_mipLevels > 1 && m_extent.depth == 1 && m_arrayLayers == 1 && (createImageInfo.usage & VK_IMAGE_USAGE_STORAGE_BIT))
+	{
+		m_mipImageViews.resize(m_mipLevels);
+		for (uint32_t mipLevel(0); mipLevel < m_mipLevels; ++mipLevel)
+			m_mipImageViews[mipLevel] = createImageView(device, m_image, m_imageFormat, createImageInfo.aspect, 1, VK_IMAGE_VIEW_TYPE_2D, 1, mipLevel);
+	}
 }
 
 
@@ -199,13 +212,15 @@ Wolf::Image::~Image()
 		return;
 	
 	vkDestroyImageView(m_device, m_imageView, nullptr);
+	for (VkImageView mipImageView : m_mipImageViews)
+		vkDestroyImageView(m_device, mipImageView, nullptr);
 	vkDestroyImage(m_device, m_image, nullptr);
 	vkFreeMemory(m_device, m_imageMemory, nullptr);
 }
 
 void Wolf::Image::setImageLayout(VkImageLayout newLayout, VkPipelineStageFlags sourceStage, VkPipelineStageFlags destinationStage)
 {
-	transitionImageLayout(m_device, m_commandPool, m_graphicsQueue, m_image, m_imageFormat, m_imageLayout, newLayout, m_mipLevels, 1, sourceStage, destinationStage);
+	transitionImageLayout(m_device, m_commandPool, m_graphicsQueue, m_image, m_imageFormat, m_imageLayout, newLayout, m_mipLevels, m_arrayLayers, sourceStage, destinationStage);
 	m_imageLayout = newLayout;
 }
 
@@ -254,7 +269,8 @@ void Wolf::Image::createImage(VkDevice device, VkPhysicalDevice physicalDevice,
 	vkBindImageMemory(device, image, imageMemory, 0);
 }
 
-VkImageView Wolf::Image::createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels, VkImageViewType viewType)
+VkImageView Wolf::Image::createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels, VkImageViewType viewType, uint32_t layerCount,
+	uint32_t baseMipLevel)
 {
 	VkImageViewCreateInfo viewInfo = {};
 	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -262,10 +278,10 @@ VkImageView Wolf::Image::createImageView(VkDevice device, VkImage image, VkForma
 	viewInfo.viewType = viewType;
 	viewInfo.format = format;
 	viewInfo.subresourceRange.aspectMask = aspectFlags;
-	viewInfo.subresourceRange.baseMipLevel = 0;
+	viewInfo.subresourceRange.baseMipLevel = baseMipLevel;
 	viewInfo.subresourceRange.levelCount = mipLevels;
 	viewInfo.subresourceRange.baseArrayLayer = 0;
-	viewInfo.subresourceRange.layerCount = viewType == VK_IMAGE_VIEW_TYPE_CUBE ? 6 : 1;
+	viewInfo.subresourceRange.layerCount = viewType == VK_IMAGE_VIEW_TYPE_CUBE ? 6 : layerCount;
 
 	VkImageView imageView;
 	if (vkCreateImageView(device, &viewInfo, nullptr, &imageView) != VK_SUCCESS)
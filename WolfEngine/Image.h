@@ -47,6 +47,7 @@ namespace Wolf
 		VkImage getImage() { return m_image; }
 		VkDeviceMemory getImageMemory() { return m_imageMemory; }
 		VkImageView getImageView() { return m_imageView; }
+		VkImageView getImageView(uint32_t mipLevel) { return mipLevel < m_mipImageViews.size() ? m_mipImageViews[mipLevel] : m_imageView; } // storage access to a single level
 		VkFormat getFormat() { return m_imageFormat; }
 		VkSampleCountFlagBits getSampleCount() { return m_sampleCount; }
 		VkExtent3D getExtent() { return m_extent; }
@@ -57,6 +58,7 @@ namespace Wolf
 		VkImage m_image;
 		VkDeviceMemory  m_imageMemory = VK_NULL_HANDLE;
 		VkImageView m_imageView = VK_NULL_HANDLE;
+		std::vector<VkImageView> m_mipImageViews;
 
 		VkImageLayout m_imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 		VkFormat m_imageFormat;
@@ -64,13 +66,14 @@ namespace Wolf
 		uint32_t m_mipLevels;
 		VkExtent3D m_extent;
 		VkSampleCountFlagBits m_sampleCount;
-		uint32_t m_arrayLayers;
+		uint32_t m_arrayLayers = 1;
 
 	private:
 		static void createImage(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t width, uint32_t height, uint32_t depth, uint32_t mipLevels, VkSampleCountFlagBits numSamples, 
 			VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, uint32_t arrayLayers, VkImageCreateFlags flags, VkImageLayout initialLayout,
 			VkImage& image, VkDeviceMemory& imageMemory);
-		static VkImageView createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels, VkImageViewType viewType);
+		static VkImageView createImageView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels, VkImageViewType viewType, uint32_t layerCount = 1,
+			uint32_t baseMipLevel = 0);
 		static void transitionImageLayout(VkDevice device, VkCommandPool commandPool, Queue graphicsQueue, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout,
 			uint32_t mipLevels, uint32_t arrayLayers, VkPipelineStageFlags sourceStage, VkPipelineStageFlags destinationStage);
 		static void copyBufferToImage(VkDevice device, VkCommandPool commandPool, Queue graphicsQueue, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t baseArrayLayer);
@@ -9,6 +9,7 @@ namespace Wolf
 	{
 		VkBuffer instanceBuffer = VK_NULL_HANDLE;
 		uint32_t nInstances = 0;
+		uint32_t firstInstance = 0;
 	};
 
 	class InstanceParent : public VulkanElement
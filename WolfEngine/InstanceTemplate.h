@@ -5,7 +5,7 @@
 
 namespace Wolf
 {
-	enum class InstanceTemplate { NO, SINGLE_ID };
+	enum class InstanceTemplate { NO, SINGLE_ID, TRANSFORM };
 	
 	struct InstanceSingleID
 	{
@@ -33,4 +33,35 @@ namespace Wolf
 			return attributeDescriptions;
 		}
 	};
+
+	// Engine managed when used as renderer template (automatic instancing)
+	struct InstanceTransform
+	{
+		glm::mat4 transform;
+
+		static VkVertexInputBindingDescription getBindingDescription(uint32_t binding)
+		{
+			VkVertexInputBindingDescription bindingDescription = {};
+			bindingDescription.binding = binding;
+			bindingDescription.stride = sizeof(InstanceTransform);
+			bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+			return bindingDescription;
+		}
+
+		static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(uint32_t binding, uint32_t startLocation)
+		{
+			std::vector<VkVertexInputAttributeDescription> attributeDescriptions(4);
+
+			for (uint32_t i(0); i < 4; ++i)
+			{
+				attributeDescriptions[i].binding = binding;
+				attributeDescriptions[i].location = startLocation + i;
+				attributeDescriptions[i].format = VK_FORMAT_R32G32B32A32_SFLOAT;
+				attributeDescriptions[i].offset = sizeof(glm::vec4) * i;
+			}
+
+			return attributeDescriptions;
+		}
+	};
 }
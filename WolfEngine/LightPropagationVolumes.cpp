@@ -1,13 +1,26 @@
 #include "LightPropagationVolumes.h"
 
 Wolf::LightPropagationVolumes::LightPropagationVolumes(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, Model* model, glm::mat4 projection, glm::mat4 modelMat, glm::vec3 lightDir,
-	glm::vec4 cascadeSplits, std::array<Image*, 4> depthTextures)
+	glm::vec4 cascadeSplits, std::array<Image*, 4> depthTextures, uint32_t gridSize, uint32_t cascadeCount, float cascadeExtent, std::vector<uint32_t> propagationIterations)
 {
 	m_engineInstance = engineInstance;
 	m_scene = scene;
+	m_modelMatrix = modelMat;
+
+	// Compute passes run 8x8x8 groups
+	m_gridSize = glm::max(gridSize / 8 * 8, 8u);
+	if (m_gridSize != gridSize)
+		Debug::sendWarning("LPV grid size must be a multiple of 8, using " + std::to_string(m_gridSize));
+
+	m_cascades.resize(glm::clamp(cascadeCount, 1u, LPV_MAX_CASCADES));
+	for (uint32_t i(0); i < m_cascades.size(); ++i)
+	{
+		m_cascades[i].extent = cascadeExtent * static_cast<float>(1u << i);
+		m_cascades[i].voxelSize = m_cascades[i].extent / static_cast<float>(m_gridSize);
+	}
 
 	Image::CreateImageInfo createImageInfo;
-	createImageInfo.extent = { VOXEL_SIZE, VOXEL_SIZE, VOXEL_SIZE };
+	createImageInfo.extent = { m_gridSize, m_gridSize, m_gridSize * static_cast<uint32_t>(m_cascades.size()) };
 	createImageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT;
 	createImageInfo.format = VK_FORMAT_R8_UNORM;
 	createImageInfo.sampleCount = VK_SAMPLE_COUNT_1_BIT;
@@ -16,113 +29,15 @@ Wolf::LightPropagationVolumes::LightPropagationVolumes(Wolf::WolfInstance* engin
 	m_voxelImage = engineInstance->createImage(createImageInfo);
 	m_voxelImage->setImageLayout(VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
 
-	//modelMat = glm::mat4(1.0f);
-	// X
-	m_projections[0] = glm::ortho(-32.0f, 32.0f, -4.0f, 16.0f, 0.0f, 64.0f) *
-		glm::lookAt(glm::vec3(-32.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
-		modelMat;
-
-	// Y
-	glm::mat4 YLookAtMatrix = glm::mat4(1.0f);
-	glm::vec3 f(0.0f, 1.0f, 0.0f);
-	glm::vec3 s(1.0f, 0.0f, 0.0f);
-	glm::vec3 u(0.0f, 0.0f, 1.0f);
-
-	glm::vec3 eye(0.0f, -4.0f, 0.0f);
-	
-	YLookAtMatrix[0][0] = s.x;
-	YLookAtMatrix[1][0] = s.y;
-	YLookAtMatrix[2][0] = s.z;
-	YLookAtMatrix[0][1] = u.x;
-	YLookAtMatrix[1][1] = u.y;
-	YLookAtMatrix[2][1] = u.z;
-	YLookAtMatrix[0][2] = -f.x;
-	YLookAtMatrix[1][2] = -f.y;
-	YLookAtMatrix[2][2] = -f.z;
-	YLookAtMatrix[3][0] = -dot(s, eye);
-	YLookAtMatrix[3][1] = -dot(u, eye);
-	YLookAtMatrix[3][2] = dot(f, eye);
-	
-	m_projections[1] = glm::ortho(-32.0f, 32.0f, -32.0f, 32.0f, 0.0f, 20.0f) * YLookAtMatrix *
-		/*glm::lookAt(glm::vec3(0.0f, -4.0f, 0.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)) **/
-		modelMat;
-
-	// Z	
-	m_projections[2] = glm::ortho(-32.0f, 32.0f, -4.0f, 16.0f, 0.0f, 64.0f) *
-		glm::lookAt(glm::vec3(0.0f, 0.0f, -32.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)) *
-		modelMat;
-
-	m_uboVoxelization = engineInstance->createUniformBufferObject(&m_projections, 3 * sizeof(glm::mat4));
-
-	Scene::CommandBufferCreateInfo commandBufferCreateInfo;
-	commandBufferCreateInfo.finalPipelineStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-	commandBufferCreateInfo.commandType = Scene::CommandType::GRAPHICS;
-	m_commandBufferID = scene->addCommandBuffer(commandBufferCreateInfo);
-
-	Scene::RenderPassCreateInfo renderPassCreateInfo{};
-	renderPassCreateInfo.name = "Light Propagation Volumes";
-	renderPassCreateInfo.commandBufferID = m_commandBufferID;
-	renderPassCreateInfo.outputIsSwapChain = false;
-	renderPassCreateInfo.extent = { VOXEL_SIZE, VOXEL_SIZE };
-
-	m_attachments.resize(1);
-	m_attachments[0] = Attachment({ VOXEL_SIZE, VOXEL_SIZE }, VK_FORMAT_R8G8B8A8_UNORM, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_ATTACHMENT_STORE_OP_STORE, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
-	m_clearValues.resize(1);
-	m_clearValues[0] = { 0.5f, 0.0f, 0.5f, 1.0f };
-
-	int i(0);
-	for (auto& attachment : m_attachments)
-	{
-		Scene::RenderPassOutput renderPassOutput;
-		renderPassOutput.attachment = attachment;
-		renderPassOutput.clearValue = m_clearValues[i++];
-
-		renderPassCreateInfo.outputs.push_back(renderPassOutput);
-	}
-
-	m_renderPassID = m_scene->addRenderPass(renderPassCreateInfo);
-
-	{
-		RendererCreateInfo rendererCreateInfo;
-
-		ShaderCreateInfo vertexShaderCreateInfo{};
-		vertexShaderCreateInfo.filename = "Shaders/LightPropagationVolumes/vert.spv";
-		vertexShaderCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-		rendererCreateInfo.pipelineCreateInfo.shaderCreateInfos.push_back(vertexShaderCreateInfo);
-
-		ShaderCreateInfo fragmentShaderCreateInfo{};
-		fragmentShaderCreateInfo.filename = "Shaders/LightPropagationVolumes/frag.spv";
-		fragmentShaderCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		rendererCreateInfo.pipelineCreateInfo.shaderCreateInfos.push_back(fragmentShaderCreateInfo);
-
-		rendererCreateInfo.inputVerticesTemplate = InputVertexTemplate::FULL_3D_MATERIAL;
-		rendererCreateInfo.instanceTemplate = InstanceTemplate::NO;
-		rendererCreateInfo.renderPassID = m_renderPassID;
-		rendererCreateInfo.pipelineCreateInfo.extent = { VOXEL_SIZE, VOXEL_SIZE };
-		rendererCreateInfo.pipelineCreateInfo.enableDepthTesting = false;
-		rendererCreateInfo.pipelineCreateInfo.enableConservativeRasterization = false;
-		rendererCreateInfo.pipelineCreateInfo.alphaBlending = { false };
-
-		DescriptorSetGenerator descriptorSetGenerator;
-		descriptorSetGenerator.addImages({ m_voxelImage }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT, 1);
-		descriptorSetGenerator.addUniformBuffer(m_uboVoxelization, VK_SHADER_STAGE_VERTEX_BIT, 0);
-
-		rendererCreateInfo.descriptorSetLayout = descriptorSetGenerator.getDescriptorLayouts();
-
-		m_voxelisationRendererID = m_scene->addRenderer(rendererCreateInfo);
-
-		Renderer::AddMeshInfo addMeshInfo{};
-		addMeshInfo.vertexBuffer = model->getVertexBuffers()[0];
-		addMeshInfo.renderPassID = m_renderPassID;
-		addMeshInfo.rendererID = m_voxelisationRendererID;
-
-		addMeshInfo.descriptorSetCreateInfo = descriptorSetGenerator.getDescritorSetCreateInfo();
+	buildVoxelization(model);
+	buildInjection(model, cascadeSplits, depthTextures);
+	buildPropagation(propagationIterations);
 
-		m_scene->addMesh(addMeshInfo);
-	}
+	// Sampling
+	m_samplingData.gridParams = glm::uvec4(m_gridSize, static_cast<uint32_t>(m_cascades.size()), 0, 0);
+	m_uboSampling = engineInstance->createUniformBufferObject(&m_samplingData, sizeof(SamplingUBO));
 
-	buildInjection(model, cascadeSplits, depthTextures);
-	buildPropagation();
+	Scene::CommandBufferCreateInfo commandBufferCreateInfo;
 
 	// Voxel viewer
 	{
@@ -140,7 +55,7 @@ Wolf::LightPropagationVolumes::LightPropagationVolumes(Wolf::WolfInstance* engin
 			glm::lookAt(glm::vec3(0.0f, 0.0f, -32.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 		m_voxelViewerMatrices[1] = glm::inverse(projection);
 		m_uboVoxelViewer = engineInstance->createUniformBufferObject(&m_voxelViewerMatrices, 3 * sizeof(glm::mat4));
-		
+
 		commandBufferCreateInfo.finalPipelineStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 		commandBufferCreateInfo.commandType = Scene::CommandType::COMPUTE;
 		m_viewerBufferID = scene->addCommandBuffer(commandBufferCreateInfo);
@@ -171,12 +86,13 @@ Wolf::LightPropagationVolumes::LightPropagationVolumes(Wolf::WolfInstance* engin
 		commandBufferCreateInfo.commandType = Scene::CommandType::COMPUTE;
 		m_clearCommandBufferID = scene->addCommandBuffer(commandBufferCreateInfo);
 
+		// Light is injected every frame in all cascades
 		Scene::ComputePassCreateInfo clearComputePassCreateInfo;
-		clearComputePassCreateInfo.extent = { VOXEL_SIZE, VOXEL_SIZE };
+		clearComputePassCreateInfo.extent = { m_gridSize, m_gridSize };
 		clearComputePassCreateInfo.computeShaderPath = "Shaders/LightPropagationVolumes/clear.spv";
 		clearComputePassCreateInfo.outputIsSwapChain = false;
 		clearComputePassCreateInfo.commandBufferID = m_clearCommandBufferID;
-		clearComputePassCreateInfo.dispatchGroups = { 8, 8, VOXEL_SIZE / 8 };
+		clearComputePassCreateInfo.dispatchGroups = { 8, 8, m_gridSize * static_cast<uint32_t>(m_cascades.size()) / 8 };
 
 		DescriptorSetGenerator descriptorSetGenerator;
 
@@ -184,20 +100,298 @@ Wolf::LightPropagationVolumes::LightPropagationVolumes(Wolf::WolfInstance* engin
 			descriptorSetGenerator.addImages({ m_injectionImages[i] }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, i);
 
 		clearComputePassCreateInfo.descriptorSetCreateInfo = descriptorSetGenerator.getDescritorSetCreateInfo();
-			
+
 		m_clearComputePassID = scene->addComputePass(clearComputePassCreateInfo);
+
+		// Geometry is only cleared in the dirty regions of each cascade, the rest is kept from previous frames
+		for (Cascade& cascade : m_cascades)
+		{
+			Scene::ComputePassCreateInfo voxelClearComputePassCreateInfo;
+			voxelClearComputePassCreateInfo.name = "LPV voxel clear";
+			voxelClearComputePassCreateInfo.extent = { m_gridSize, m_gridSize };
+			voxelClearComputePassCreateInfo.computeShaderPath = "Shaders/LightPropagationVolumes/clearVoxels.spv";
+			voxelClearComputePassCreateInfo.outputIsSwapChain = false;
+			voxelClearComputePassCreateInfo.commandBufferID = m_clearCommandBufferID;
+			voxelClearComputePassCreateInfo.dispatchGroups = { 8, 8, m_gridSize / 8 };
+
+			DescriptorSetGenerator voxelClearDescriptorSetGenerator;
+			voxelClearDescriptorSetGenerator.addImages({ m_voxelImage }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0);
+			voxelClearDescriptorSetGenerator.addUniformBuffer(cascade.ubo, VK_SHADER_STAGE_COMPUTE_BIT, 1);
+
+			voxelClearComputePassCreateInfo.descriptorSetCreateInfo = voxelClearDescriptorSetGenerator.getDescritorSetCreateInfo();
+
+			cascade.voxelClearComputePassID = scene->addComputePass(voxelClearComputePassCreateInfo);
+		}
 	}
-	
+
 }
 
-void Wolf::LightPropagationVolumes::update(glm::mat4 view, std::array<glm::mat4, 4> lightSpaceMatrices, glm::mat4 modelMat)
+void Wolf::LightPropagationVolumes::update(glm::mat4 view, std::array<glm::mat4, 4> lightSpaceMatrices, glm::mat4 modelMat, glm::vec4 cascadeSplits)
 {
-	m_uboInjectionData.lightSpaceMatrices = std::move(lightSpaceMatrices);
-	m_uboInjectionData.modelView = view * modelMat;
-	m_uboInjection->updateData(&m_uboInjectionData);
-	
-	m_voxelViewerMatrices[0] = glm::inverse(view);
+	const glm::mat4 invView = glm::inverse(view);
+	const glm::vec3 cameraPosition = glm::vec3(invView[3]);
+
+	// Voxels are cached, they are only rebuilt when the model moves, when cascades move or for invalidated regions
+	if (modelMat != m_modelMatrix)
+		invalidateVoxelization();
+	m_modelMatrix = modelMat;
+
+	m_voxelizationNeeded = false;
+	m_voxelizedClusterCount = 0;
+	for (uint32_t i(0); i < m_cascades.size(); ++i)
+	{
+		Cascade& cascade = m_cascades[i];
+		updateCascade(i, cameraPosition, modelMat);
+		updateVoxelizationDrawCommands(cascade, modelMat);
+		cascade.ubo->updateData(&cascade.uboData);
+
+		cascade.injectionData.lightSpaceMatrices = lightSpaceMatrices;
+		cascade.injectionData.cascadeSplits = cascadeSplits; // can be refitted by CSM every frame
+		cascade.injectionData.modelView = view * modelMat;
+		cascade.uboInjection->updateData(&cascade.injectionData);
+
+		m_samplingData.viewToVoxel[i] = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f / cascade.voxelSize)) * invView;
+		m_samplingData.origins[i] = cascade.uboData.origin;
+	}
+	m_uboSampling->updateData(&m_samplingData);
+
+	m_voxelViewerMatrices[0] = invView;
 	m_uboVoxelViewer->updateData(&m_voxelViewerMatrices);
+
+	if (m_voxelizationNeeded)
+		m_voxelizedFrameCount++;
+	m_frameIndex++;
+}
+
+void Wolf::LightPropagationVolumes::invalidateRegion(glm::vec3 worldMin, glm::vec3 worldMax)
+{
+	for (Cascade& cascade : m_cascades)
+	{
+		const glm::ivec3 regionMin = glm::ivec3(glm::floor(worldMin / cascade.voxelSize));
+		const glm::ivec3 regionMax = glm::ivec3(glm::ceil(worldMax / cascade.voxelSize));
+
+		// Pending regions are merged until the next update
+		cascade.invalidatedMin = cascade.hasInvalidatedRegion ? glm::min(cascade.invalidatedMin, regionMin) : regionMin;
+		cascade.invalidatedMax = cascade.hasInvalidatedRegion ? glm::max(cascade.invalidatedMax, regionMax) : regionMax;
+		cascade.hasInvalidatedRegion = true;
+	}
+}
+
+void Wolf::LightPropagationVolumes::updateCascade(uint32_t cascadeIndex, glm::vec3 cameraPosition, glm::mat4 modelMat)
+{
+	Cascade& cascade = m_cascades[cascadeIndex];
+	const int gridSize = static_cast<int>(m_gridSize);
+
+	// Snapped to the voxel lattice, voxels keep their world position when the cascade moves
+	const glm::ivec3 origin = glm::ivec3(glm::floor(cameraPosition / cascade.voxelSize)) - glm::ivec3(gridSize / 2);
+	const glm::ivec3 delta = origin - cascade.origin;
+
+	uint32_t dirtyBoxCount = 0;
+	if (!cascade.valid || glm::any(glm::greaterThanEqual(glm::abs(delta), glm::ivec3(gridSize))))
+	{
+		cascade.uboData.dirtyMin[0] = glm::ivec4(origin, 0);
+		cascade.uboData.dirtyMax[0] = glm::ivec4(origin + glm::ivec3(gridSize), 0);
+		dirtyBoxCount = 1;
+	}
+	else
+	{
+		// Toroidal addressing: only the slabs entering the cascade along each moved axis are new
+		for (int axis(0); axis < 3; ++axis)
+		{
+			if (delta[axis] == 0)
+				continue;
+
+			glm::ivec3 boxMin = origin, boxMax = origin + glm::ivec3(gridSize);
+			if (delta[axis] > 0)
+				boxMin[axis] = boxMax[axis] - delta[axis];
+			else
+				boxMax[axis] = boxMin[axis] - delta[axis];
+
+			cascade.uboData.dirtyMin[dirtyBoxCount] = glm::ivec4(boxMin, 0);
+			cascade.uboData.dirtyMax[dirtyBoxCount] = glm::ivec4(boxMax, 0);
+			dirtyBoxCount++;
+		}
+
+		// Invalidated geometry, clipped to the cascade
+		if (cascade.hasInvalidatedRegion)
+		{
+			const glm::ivec3 boxMin = glm::max(cascade.invalidatedMin, origin);
+			const glm::ivec3 boxMax = glm::min(cascade.invalidatedMax, origin + glm::ivec3(gridSize));
+			if (glm::all(glm::lessThan(boxMin, boxMax)))
+			{
+				cascade.uboData.dirtyMin[dirtyBoxCount] = glm::ivec4(boxMin, 0);
+				cascade.uboData.dirtyMax[dirtyBoxCount] = glm::ivec4(boxMax, 0);
+				dirtyBoxCount++;
+			}
+		}
+	}
+	cascade.origin = origin;
+	cascade.valid = true;
+	cascade.hasInvalidatedRegion = false;
+
+	// Voxelization and injection projections covering the cascade box
+	const float halfExtent = cascade.extent / 2.0f;
+	const glm::vec3 center = glm::vec3(origin) * cascade.voxelSize + glm::vec3(halfExtent);
+	const glm::mat4 ortho = glm::ortho(-halfExtent, halfExtent, -halfExtent, halfExtent, 0.0f, cascade.extent);
+	cascade.uboData.projections[0] = ortho * glm::lookAt(center - glm::vec3(halfExtent, 0.0f, 0.0f), center, glm::vec3(0.0f, 1.0f, 0.0f)) * modelMat;
+	cascade.uboData.projections[1] = ortho * glm::lookAt(center - glm::vec3(0.0f, halfExtent, 0.0f), center, glm::vec3(0.0f, 0.0f, 1.0f)) * modelMat;
+	cascade.uboData.projections[2] = ortho * glm::lookAt(center - glm::vec3(0.0f, 0.0f, halfExtent), center, glm::vec3(0.0f, 1.0f, 0.0f)) * modelMat;
+	cascade.uboData.modelToVoxel = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f / cascade.voxelSize)) * modelMat;
+	cascade.uboData.origin = glm::ivec4(origin, static_cast<int>(cascadeIndex));
+	cascade.uboData.gridParams = glm::uvec4(m_gridSize, static_cast<uint32_t>(m_cascades.size()), dirtyBoxCount, 0);
+
+	cascade.injectionData.projectionX = cascade.uboData.projections[0];
+	cascade.injectionData.projectionY = cascade.uboData.projections[1];
+	cascade.injectionData.projectionZ = cascade.uboData.projections[2];
+	cascade.injectionData.modelToVoxel = cascade.uboData.modelToVoxel;
+	cascade.injectionData.origin = cascade.uboData.origin;
+	cascade.injectionData.gridParams = cascade.uboData.gridParams;
+
+	// Closest cascade propagates every frame, farther ones less often unless their geometry changed: cascade i > 0 every 2^i frames,
+	// the last one every 2^(i-1). Phases are offset so that exactly one far cascade is scheduled per frame
+	const bool moved = dirtyBoxCount > 0;
+	const bool lastCascade = cascadeIndex == m_cascades.size() - 1;
+	const uint32_t period = cascadeIndex == 0 ? 1 : (lastCascade ? 1u << (cascadeIndex - 1) : 1u << cascadeIndex);
+	const uint32_t phase = cascadeIndex == 0 || lastCascade ? 1 : 1 + (1u << (cascadeIndex - 1));
+	cascade.propagationScheduled = moved || (m_frameIndex + phase) % period == 0;
+	if (moved)
+		m_voxelizationNeeded = true;
+}
+
+void Wolf::LightPropagationVolumes::updateVoxelizationDrawCommands(Cascade& cascade, const glm::mat4& modelMat)
+{
+	VkDrawIndexedIndirectCommand* drawCommands;
+	cascade.voxelizationDrawCommands->map(reinterpret_cast<void**>(&drawCommands));
+
+	const uint32_t dirtyBoxCount = cascade.uboData.gridParams.z;
+	const float radiusScale = glm::max(glm::length(glm::vec3(modelMat[0])), glm::max(glm::length(glm::vec3(modelMat[1])), glm::length(glm::vec3(modelMat[2])))) /
+		cascade.voxelSize;
+
+	for (size_t i(0); i < cascade.voxelizationClusters.size(); ++i)
+	{
+		const MeshCluster& cluster = cascade.voxelizationClusters[i];
+
+		bool visible = !cascade.cullVoxelizationClusters && dirtyBoxCount > 0;
+		if (cascade.cullVoxelizationClusters)
+		{
+			// Bounding sphere in voxels against the dirty boxes
+			const glm::vec3 center = glm::vec3(cascade.uboData.modelToVoxel * glm::vec4(glm::vec3(cluster.boundingSphere), 1.0f));
+			const float radius = cluster.boundingSphere.w * radiusScale;
+			for (uint32_t box(0); box < dirtyBoxCount && !visible; ++box)
+			{
+				const glm::vec3 closestPoint = glm::clamp(center, glm::vec3(cascade.uboData.dirtyMin[box]), glm::vec3(cascade.uboData.dirtyMax[box]));
+				visible = glm::length(center - closestPoint) <= radius;
+			}
+		}
+
+		VkDrawIndexedIndirectCommand& drawCommand = drawCommands[i];
+		drawCommand.indexCount = cluster.indexCount;
+		drawCommand.firstIndex = cluster.firstIndex;
+		drawCommand.vertexOffset = 0;
+		drawCommand.firstInstance = 0;
+		drawCommand.instanceCount = visible ? 1 : 0;
+		m_voxelizedClusterCount += drawCommand.instanceCount;
+	}
+
+	cascade.voxelizationDrawCommands->unmap();
+}
+
+void Wolf::LightPropagationVolumes::buildVoxelization(Model* model)
+{
+	Scene::CommandBufferCreateInfo commandBufferCreateInfo;
+	commandBufferCreateInfo.finalPipelineStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	commandBufferCreateInfo.commandType = Scene::CommandType::GRAPHICS;
+	m_commandBufferID = m_scene->addCommandBuffer(commandBufferCreateInfo);
+
+	Scene::RenderPassCreateInfo renderPassCreateInfo{};
+	renderPassCreateInfo.name = "Light Propagation Volumes";
+	renderPassCreateInfo.commandBufferID = m_commandBufferID;
+	renderPassCreateInfo.outputIsSwapChain = false;
+	renderPassCreateInfo.extent = { m_gridSize, m_gridSize };
+
+	m_attachments.resize(1);
+	m_attachments[0] = Attachment({ m_gridSize, m_gridSize }, VK_FORMAT_R8G8B8A8_UNORM, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_ATTACHMENT_STORE_OP_STORE, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
+	m_clearValues.resize(1);
+	m_clearValues[0] = { 0.5f, 0.0f, 0.5f, 1.0f };
+
+	int i(0);
+	for (auto& attachment : m_attachments)
+	{
+		Scene::RenderPassOutput renderPassOutput;
+		renderPassOutput.attachment = attachment;
+		renderPassOutput.clearValue = m_clearValues[i++];
+
+		renderPassCreateInfo.outputs.push_back(renderPassOutput);
+	}
+
+	m_renderPassID = m_scene->addRenderPass(renderPassCreateInfo);
+
+	RendererCreateInfo rendererCreateInfo;
+
+	ShaderCreateInfo vertexShaderCreateInfo{};
+	vertexShaderCreateInfo.filename = "Shaders/LightPropagationVolumes/vert.spv";
+	vertexShaderCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+	rendererCreateInfo.pipelineCreateInfo.shaderCreateInfos.push_back(vertexShaderCreateInfo);
+
+	ShaderCreateInfo fragmentShaderCreateInfo{};
+	fragmentShaderCreateInfo.filename = "Shaders/LightPropagationVolumes/frag.spv";
+	fragmentShaderCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	rendererCreateInfo.pipelineCreateInfo.shaderCreateInfos.push_back(fragmentShaderCreateInfo);
+
+	rendererCreateInfo.inputVerticesTemplate = InputVertexTemplate::FULL_3D_MATERIAL;
+	rendererCreateInfo.instanceTemplate = InstanceTemplate::NO;
+	rendererCreateInfo.renderPassID = m_renderPassID;
+	rendererCreateInfo.pipelineCreateInfo.extent = { m_gridSize, m_gridSize };
+	rendererCreateInfo.pipelineCreateInfo.enableDepthTesting = false;
+	rendererCreateInfo.pipelineCreateInfo.enableConservativeRasterization = false;
+	rendererCreateInfo.pipelineCreateInfo.alphaBlending = { false };
+
+	// One draw per cascade, the fragment shader only writes voxels in the dirty regions
+	for (Cascade& cascade : m_cascades)
+	{
+		cascade.ubo = m_engineInstance->createUniformBufferObject(&cascade.uboData, sizeof(CascadeUBO));
+
+		DescriptorSetGenerator descriptorSetGenerator;
+		descriptorSetGenerator.addImages({ m_voxelImage }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT, 1);
+		descriptorSetGenerator.addUniformBuffer(cascade.ubo, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0);
+
+		if (m_voxelisationRendererID < 0)
+		{
+			rendererCreateInfo.descriptorSetLayout = descriptorSetGenerator.getDescriptorLayouts();
+			m_voxelisationRendererID = m_scene->addRenderer(rendererCreateInfo);
+		}
+
+		// Voxels are coarse, simplified geometry gives the same result
+		const float halfExtent = cascade.extent / 2.0f;
+		const float voxelsPerUnit = Model::computePixelsPerUnit(glm::ortho(-halfExtent, halfExtent, -halfExtent, halfExtent, 0.0f, cascade.extent),
+			static_cast<float>(m_gridSize), 0.0f);
+
+		const uint32_t lod = model->selectLOD(voxelsPerUnit, 0.5f);
+		const VertexBuffer vertexBuffer = model->getLODVertexBuffers(lod)[0];
+
+		const std::vector<std::vector<MeshCluster>> clusters = model->getLODClusters(lod);
+		if (!clusters.empty() && !clusters[0].empty())
+			cascade.voxelizationClusters = clusters[0];
+		else
+		{
+			cascade.voxelizationClusters = { { 0, vertexBuffer.nbIndices, glm::vec4(0.0f) } };
+			cascade.cullVoxelizationClusters = false;
+		}
+
+		cascade.voxelizationDrawCommands = m_engineInstance->createBuffer(sizeof(VkDrawIndexedIndirectCommand) * cascade.voxelizationClusters.size(),
+			VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+		Renderer::AddMeshInfo addMeshInfo{};
+		addMeshInfo.vertexBuffer = vertexBuffer;
+		addMeshInfo.renderPassID = m_renderPassID;
+		addMeshInfo.rendererID = m_voxelisationRendererID;
+		addMeshInfo.indirectBuffer.drawCommandBuffer = cascade.voxelizationDrawCommands->getBuffer();
+		addMeshInfo.indirectBuffer.maxDrawCount = static_cast<uint32_t>(cascade.voxelizationClusters.size());
+
+		addMeshInfo.descriptorSetCreateInfo = descriptorSetGenerator.getDescritorSetCreateInfo();
+
+		m_scene->addMesh(addMeshInfo);
+	}
 }
 
 void Wolf::LightPropagationVolumes::buildInjection(Model* model, glm::vec4 cascadeSplits, std::array<Image*, 4> depthTextures)
@@ -206,23 +400,22 @@ void Wolf::LightPropagationVolumes::buildInjection(Model* model, glm::vec4 casca
 	for(int i(0); i < m_injectionImages.size(); ++i)
 	{
 		Image::CreateImageInfo createImageInfo;
-		createImageInfo.extent = { VOXEL_SIZE, VOXEL_SIZE, VOXEL_SIZE };
+		createImageInfo.extent = { m_gridSize, m_gridSize, m_gridSize * static_cast<uint32_t>(m_cascades.size()) };
 		createImageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT;
 		createImageInfo.format = VK_FORMAT_R32_UINT;
 		createImageInfo.sampleCount = VK_SAMPLE_COUNT_1_BIT;
 		createImageInfo.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
 		createImageInfo.mipLevels = 1;
 		m_injectionImages[i] = m_engineInstance->createImage(createImageInfo);
-		m_injectionImages[i]->setImageLayout(VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 
+		m_injectionImages[i]->setImageLayout(VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
 			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
 	}
-	
-	m_uboInjectionData.projectionX = m_projections[0];
-	m_uboInjectionData.projectionY = m_projections[1];
-	m_uboInjectionData.projectionZ = m_projections[2];
-	m_uboInjectionData.cascadeSplits = cascadeSplits;
 
-	m_uboInjection = m_engineInstance->createUniformBufferObject(&m_uboInjectionData, sizeof(m_uboInjectionData));
+	for (Cascade& cascade : m_cascades)
+	{
+		cascade.injectionData.cascadeSplits = cascadeSplits;
+		cascade.uboInjection = m_engineInstance->createUniformBufferObject(&cascade.injectionData, sizeof(InjectionUBO));
+	}
 
 	// Command Buffer
 	Scene::CommandBufferCreateInfo commandBufferCreateInfo;
@@ -235,10 +428,10 @@ void Wolf::LightPropagationVolumes::buildInjection(Model* model, glm::vec4 casca
 	renderPassCreateInfo.name = "Light Propagation Volumes injection";
 	renderPassCreateInfo.commandBufferID = m_injectionCommandBufferID;
 	renderPassCreateInfo.outputIsSwapChain = false;
-	renderPassCreateInfo.extent = { VOXEL_SIZE, VOXEL_SIZE };
+	renderPassCreateInfo.extent = { m_gridSize, m_gridSize };
 
 	m_injectionAttachments.resize(1);
-	m_injectionAttachments[0] = Attachment({ VOXEL_SIZE, VOXEL_SIZE }, VK_FORMAT_R8G8B8A8_UNORM, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_ATTACHMENT_STORE_OP_STORE, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
+	m_injectionAttachments[0] = Attachment({ m_gridSize, m_gridSize }, VK_FORMAT_R8G8B8A8_UNORM, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_ATTACHMENT_STORE_OP_STORE, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT);
 	m_injectionClearValues.resize(1);
 	m_injectionClearValues[0] = { 0.5f, 0.0f, 0.5f, 1.0f };
 
@@ -266,24 +459,19 @@ void Wolf::LightPropagationVolumes::buildInjection(Model* model, glm::vec4 casca
 	fragmentShaderCreateInfo.filename = "Shaders/LightPropagationVolumes/injectionFrag.spv";
 	fragmentShaderCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
 	rendererCreateInfo.pipelineCreateInfo.shaderCreateInfos.push_back(fragmentShaderCreateInfo);
-	
+
 	rendererCreateInfo.inputVerticesTemplate = InputVertexTemplate::FULL_3D_MATERIAL;
 	rendererCreateInfo.instanceTemplate = InstanceTemplate::NO;
 	rendererCreateInfo.renderPassID = m_injectionRenderPassID;
-	rendererCreateInfo.pipelineCreateInfo.extent = { VOXEL_SIZE, VOXEL_SIZE };
+	rendererCreateInfo.pipelineCreateInfo.extent = { m_gridSize, m_gridSize };
 	rendererCreateInfo.pipelineCreateInfo.enableDepthTesting = false;
 	rendererCreateInfo.pipelineCreateInfo.enableConservativeRasterization = false;
 	rendererCreateInfo.pipelineCreateInfo.alphaBlending = { false };
 
-	DescriptorSetGenerator descriptorSetGenerator;
-	
 	std::vector<Image*> voxelImages(m_injectionImages.size());
 	for (int i(0); i < m_injectionImages.size(); ++i)
 		voxelImages[i] = m_injectionImages[i];
-	descriptorSetGenerator.addImages(voxelImages, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT, 2);
-	
-	descriptorSetGenerator.addSampler(model->getSampler(), VK_SHADER_STAGE_FRAGMENT_BIT, 1);
-	
+
 	std::vector<Image*> depthAndMaterialImages(model->getNumberOfImages() + 4);
 	std::vector<Image*> materialImages = model->getImages();
 	for(int i(0); i < depthAndMaterialImages.size(); ++i)
@@ -293,61 +481,104 @@ void Wolf::LightPropagationVolumes::buildInjection(Model* model, glm::vec4 casca
 		else
 			depthAndMaterialImages[i] = materialImages[i - 4];
 	}
-	descriptorSetGenerator.addImages(depthAndMaterialImages, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT, 9);
-	
-	descriptorSetGenerator.addUniformBuffer(m_uboInjection, VK_SHADER_STAGE_VERTEX_BIT, 0);
 
-	rendererCreateInfo.descriptorSetLayout = descriptorSetGenerator.getDescriptorLayouts();
-
-	m_voxelisationRendererID = m_scene->addRenderer(rendererCreateInfo);
-
-	// Add Model
-	Renderer::AddMeshInfo addMeshInfo{};
-	addMeshInfo.vertexBuffer = model->getVertexBuffers()[0];
-	addMeshInfo.renderPassID = m_injectionRenderPassID;
-	addMeshInfo.rendererID = m_voxelisationRendererID;
+	// One draw per cascade, the fragment shader writes at the toroidal address of the cascade
+	for (Cascade& cascade : m_cascades)
+	{
+		DescriptorSetGenerator descriptorSetGenerator;
+		descriptorSetGenerator.addImages(voxelImages, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT, 2);
+		descriptorSetGenerator.addSampler(model->getSampler(), VK_SHADER_STAGE_FRAGMENT_BIT, 1);
+		descriptorSetGenerator.addImages(depthAndMaterialImages, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT, 9);
+		descriptorSetGenerator.addUniformBuffer(cascade.uboInjection, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0);
+
+		if (m_injectionRendererID < 0)
+		{
+			rendererCreateInfo.descriptorSetLayout = descriptorSetGenerator.getDescriptorLayouts();
+			m_injectionRendererID = m_scene->addRenderer(rendererCreateInfo);
+		}
+
+		// Add Model
+		Renderer::AddMeshInfo addMeshInfo{};
+		addMeshInfo.vertexBuffer = model->getVertexBuffers()[0];
+		addMeshInfo.renderPassID = m_injectionRenderPassID;
+		addMeshInfo.rendererID = m_injectionRendererID;
 
-	addMeshInfo.descriptorSetCreateInfo = descriptorSetGenerator.getDescritorSetCreateInfo();
+		addMeshInfo.descriptorSetCreateInfo = descriptorSetGenerator.getDescritorSetCreateInfo();
 
-	m_scene->addMesh(addMeshInfo);
+		m_scene->addMesh(addMeshInfo);
+	}
 }
 
-void Wolf::LightPropagationVolumes::buildPropagation()
+void Wolf::LightPropagationVolumes::buildPropagation(const std::vector<uint32_t>& propagationIterations)
 {
 	// Data
-	Image::CreateImageInfo createImageInfo;
-	createImageInfo.extent = { VOXEL_SIZE, VOXEL_SIZE, VOXEL_SIZE };
-	createImageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT;
-	createImageInfo.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-	createImageInfo.sampleCount = VK_SAMPLE_COUNT_1_BIT;
-	createImageInfo.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
-	createImageInfo.mipLevels = 1;
-	m_lightVolumesPropagationImage = m_engineInstance->createImage(createImageInfo);
-	m_lightVolumesPropagationImage->setImageLayout(VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
-
-	// Command Buffer
-	Scene::CommandBufferCreateInfo commandBufferCreateInfo;
-	commandBufferCreateInfo.finalPipelineStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
-	commandBufferCreateInfo.commandType = Scene::CommandType::COMPUTE;
-	m_propagationCommandBufferID = m_scene->addCommandBuffer(commandBufferCreateInfo);
-
-	// Compute pass  
-	Scene::ComputePassCreateInfo propagationComputePassCreateInfo;
-	propagationComputePassCreateInfo.extent = { VOXEL_SIZE, VOXEL_SIZE };
-	propagationComputePassCreateInfo.computeShaderPath = "Shaders/LightPropagationVolumes/propagation.spv";
-	propagationComputePassCreateInfo.outputIsSwapChain = false;
-	propagationComputePassCreateInfo.commandBufferID = m_propagationCommandBufferID;
-	propagationComputePassCreateInfo.dispatchGroups = { 8, 8, VOXEL_SIZE / 8 };
-
-	DescriptorSetGenerator descriptorSetGenerator;
+	for (Image*& propagationImage : m_lightVolumesPropagationImages)
+	{
+		Image::CreateImageInfo createImageInfo;
+		createImageInfo.extent = { m_gridSize, m_gridSize, m_gridSize * static_cast<uint32_t>(m_cascades.size()) };
+		createImageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT;
+		createImageInfo.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		createImageInfo.sampleCount = VK_SAMPLE_COUNT_1_BIT;
+		createImageInfo.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+		createImageInfo.mipLevels = 1;
+		propagationImage = m_engineInstance->createImage(createImageInfo);
+		propagationImage->setImageLayout(VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	}
 
-	for(int i(0);  i < m_injectionImages.size(); ++i)
-		descriptorSetGenerator.addImages({ m_injectionImages[i] }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, i);
+	// One command buffer per cascade so each cascade can be scheduled separately
+	for (uint32_t cascadeIndex(0); cascadeIndex < m_cascades.size(); ++cascadeIndex)
+	{
+		Cascade& cascade = m_cascades[cascadeIndex];
+		const uint32_t iterationCount = cascadeIndex < propagationIterations.size() ? glm::max(propagationIterations[cascadeIndex], 1u) : 1;
 
-	descriptorSetGenerator.addImages({ m_lightVolumesPropagationImage }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 
-		static_cast<uint32_t>(m_injectionImages.size()));
+		// Command Buffer
+		Scene::CommandBufferCreateInfo commandBufferCreateInfo;
+		commandBufferCreateInfo.finalPipelineStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		commandBufferCreateInfo.commandType = Scene::CommandType::COMPUTE;
+		cascade.propagationCommandBufferID = m_scene->addCommandBuffer(commandBufferCreateInfo);
+
+		for (uint32_t iteration(0); iteration < iterationCount; ++iteration)
+		{
+			// First iteration propagates the injected light, next ones propagate the previous result
+			Image* output = m_lightVolumesPropagationImages[(iterationCount - 1 - iteration) % 2];
+			Image* previous = m_lightVolumesPropagationImages[(iterationCount - iteration) % 2];
+
+			// Compute pass
+			Scene::ComputePassCreateInfo propagationComputePassCreateInfo;
+			propagationComputePassCreateInfo.name = "LPV propagation";
+			propagationComputePassCreateInfo.extent = { m_gridSize, m_gridSize };
+			propagationComputePassCreateInfo.computeShaderPath = iteration == 0 ? "Shaders/LightPropagationVolumes/propagation.spv" :
+				"Shaders/LightPropagationVolumes/propagationIteration.spv";
+			propagationComputePassCreateInfo.outputIsSwapChain = false;
+			propagationComputePassCreateInfo.commandBufferID = cascade.propagationCommandBufferID;
+			propagationComputePassCreateInfo.dispatchGroups = { 8, 8, m_gridSize / 8 };
+			if (iteration + 1 < iterationCount)
+				propagationComputePassCreateInfo.afterRecord = propagationBarrier;
+
+			DescriptorSetGenerator descriptorSetGenerator;
+
+			for(int i(0);  i < m_injectionImages.size(); ++i)
+				descriptorSetGenerator.addImages({ m_injectionImages[i] }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, i);
+
+			const uint32_t firstBinding = static_cast<uint32_t>(m_injectionImages.size());
+			descriptorSetGenerator.addImages({ output }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, firstBinding);
+			descriptorSetGenerator.addImages({ previous }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, firstBinding + 1);
+			descriptorSetGenerator.addImages({ m_voxelImage }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, firstBinding + 2);
+			descriptorSetGenerator.addUniformBuffer(cascade.ubo, VK_SHADER_STAGE_COMPUTE_BIT, firstBinding + 3);
+
+			propagationComputePassCreateInfo.descriptorSetCreateInfo = descriptorSetGenerator.getDescritorSetCreateInfo();
+
+			cascade.propagationComputePassIDs.push_back(m_scene->addComputePass(propagationComputePassCreateInfo));
+		}
+	}
+}
 
-	propagationComputePassCreateInfo.descriptorSetCreateInfo = descriptorSetGenerator.getDescritorSetCreateInfo();
+void Wolf::LightPropagationVolumes::propagationBarrier(void* data, VkCommandBuffer commandBuffer)
+{
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
 
-	m_propagationComputePassID = m_scene->addComputePass(propagationComputePassCreateInfo);
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
 }
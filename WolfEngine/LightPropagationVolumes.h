@@ -5,46 +5,93 @@
 
 namespace Wolf
 {
+	constexpr uint32_t LPV_MAX_CASCADES = 4;
+
+	// Nested grids following the camera (clipmap), cascade c covers cascadeExtent * 2^c.
+	// Cascades are stacked along Z in the same 3D images and addressed toroidally: texel = voxel mod gridSize, moving the camera
+	// only revoxelizes the newly exposed slices.
 	class LightPropagationVolumes
 	{
 	public:
 		LightPropagationVolumes(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, Model* model, glm::mat4 projection, glm::mat4 modelMat, glm::vec3 lightDir,
-			glm::vec4 cascadeSplits, std::array<Image*, 4> depthTextures);
+			glm::vec4 cascadeSplits, std::array<Image*, 4> depthTextures, uint32_t gridSize = 32, uint32_t cascadeCount = 1, float cascadeExtent = 64.0f,
+			std::vector<uint32_t> propagationIterations = {});
+
+		void update(glm::mat4 view, std::array<glm::mat4, 4> lightSpaceMatrices, glm::mat4 modelMat, glm::vec4 cascadeSplits);
 
-		void update(glm::mat4 view, std::array<glm::mat4, 4> lightSpaceMatrices, glm::mat4 modelMat);
+		// Only the voxelization of moved cascades and the propagation of scheduled cascades are submitted
+		std::vector<int> getCommandBufferIDs()
+		{
+			std::vector<int> r = { m_clearCommandBufferID };
+			if (m_voxelizationNeeded)
+				r.push_back(m_commandBufferID);
+			r.push_back(m_injectionCommandBufferID);
+			for (const Cascade& cascade : m_cascades)
+				if (cascade.propagationScheduled)
+					r.push_back(cascade.propagationCommandBufferID);
+			r.push_back(m_viewerBufferID);
 
-		std::vector<int> getCommandBufferIDs() { return { m_clearCommandBufferID, m_commandBufferID, m_injectionCommandBufferID,
-			m_propagationCommandBufferID, m_viewerBufferID }; }
+			return r;
+		}
 		std::vector<std::pair<int, int>> getCommandBufferSynchronisations()
 		{
 			std::vector<std::pair<int, int>> r;
 
+			r.emplace_back(m_clearCommandBufferID, m_commandBufferID);
 			r.emplace_back(m_clearCommandBufferID, m_injectionCommandBufferID);
-			r.emplace_back(m_injectionCommandBufferID, m_propagationCommandBufferID);
-			r.emplace_back(m_propagationCommandBufferID, m_viewerBufferID);
+			for (const Cascade& cascade : m_cascades)
+			{
+				r.emplace_back(m_commandBufferID, cascade.propagationCommandBufferID);
+				r.emplace_back(m_injectionCommandBufferID, cascade.propagationCommandBufferID);
+				r.emplace_back(cascade.propagationCommandBufferID, m_viewerBufferID);
+			}
 
 			return r;
 		}
-		Image* getPropagationImage() { return m_lightVolumesPropagationImage; }
+		Image* getPropagationImage() { return m_lightVolumesPropagationImages[0]; }
 		Image* getVoxelViewerOutput() { return m_viewerOutput; }
 
+		// Geometry changed: revoxelize all cascades, or only a world space box. Model transform changes are detected in update()
+		void invalidateVoxelization() { for (Cascade& cascade : m_cascades) cascade.valid = false; }
+		void invalidateRegion(glm::vec3 worldMin, glm::vec3 worldMax);
+
+		// Costs, require SceneCreateInfo::enableGPUTimings (ms, last time the pass ran).
+		// Voxelization used to run every frame, it now costs voxelization time * voxelized frame ratio
+		float getVoxelizationGPUTime() const { return m_scene->getRenderPassGPUTime(m_renderPassID); }
+		float getInjectionGPUTime() const { return m_scene->getRenderPassGPUTime(m_injectionRenderPassID); }
+		float getVoxelizedFrameRatio() const { return m_frameIndex > 0 ? static_cast<float>(m_voxelizedFrameCount) / static_cast<float>(m_frameIndex) : 1.0f; }
+		uint32_t getVoxelizedClusterCount() const { return m_voxelizedClusterCount; }
+
+		// Cascade matrices, origins and grid size for shaders sampling the propagation image
+		UniformBuffer* getSamplingUniformBuffer() { return m_uboSampling; }
+		glm::mat4 getViewToVoxel(uint32_t cascade) const { return m_samplingData.viewToVoxel[cascade]; }
+		uint32_t getCascadeCount() const { return static_cast<uint32_t>(m_cascades.size()); }
+
 	private:
+		void buildVoxelization(Model* model);
 		void buildInjection(Model* model, glm::vec4 cascadeSplits, std::array<Image*, 4> depthTextures);
-		void buildPropagation();
+		void buildPropagation(const std::vector<uint32_t>& propagationIterations);
+
+		void updateCascade(uint32_t cascadeIndex, glm::vec3 cameraPosition, glm::mat4 modelMat);
+		void updateVoxelizationDrawCommands(Cascade& cascade, const glm::mat4& modelMat);
+
+		static void propagationBarrier(void* data, VkCommandBuffer commandBuffer);
 
 	private:
-		const uint32_t VOXEL_SIZE = 32;
-		
 		Wolf::WolfInstance* m_engineInstance;
 		Wolf::Scene* m_scene;
 
+		uint32_t m_gridSize;
+		uint32_t m_frameIndex = 0;
+
 		int m_commandBufferID = -2;
 		int m_renderPassID = -1;
 		int m_voxelisationRendererID = -1;
 		Image* m_voxelImage;
-
-		UniformBuffer* m_uboVoxelization;
-		std::array<glm::mat4, 3> m_projections;
+		bool m_voxelizationNeeded = true;
+		glm::mat4 m_modelMatrix;
+		uint32_t m_voxelizedFrameCount = 0;
+		uint32_t m_voxelizedClusterCount = 0;
 
 		std::vector<Attachment> m_attachments;
 		std::vector<VkClearValue> m_clearValues;
@@ -66,7 +113,6 @@ namespace Wolf
 		int m_injectionRendererID = -1;
 
 		std::array<Image*, 7> m_injectionImages;
-		UniformBuffer* m_uboInjection;
 
 		struct InjectionUBO
 		{
@@ -77,37 +123,64 @@ namespace Wolf
 			std::array<glm::mat4, 4> lightSpaceMatrices;
 			glm::vec4 cascadeSplits;
 			glm::mat4 modelView;
+
+			glm::mat4 modelToVoxel;
+			glm::ivec4 origin; // w = cascade index
+			glm::uvec4 gridParams; // grid size, cascade count
 		};
-		InjectionUBO m_uboInjectionData;
 
 		std::vector<Attachment> m_injectionAttachments;
 		std::vector<VkClearValue> m_injectionClearValues;
 
-		/* Injection */
-		/*int m_rsmCommandBufferID = -2;
-		int m_rsmRenderPassID = -1;
-		int m_rsmRendererID = -1;
-
-		UniformBuffer* m_uboRSM;
-		glm::mat4 m_rsmMatrix;
+		/* Cascades */
+		struct CascadeUBO
+		{
+			std::array<glm::mat4, 3> projections; // model -> clip along X, Y and Z, covering the cascade
+			glm::mat4 modelToVoxel; // model -> absolute voxel coordinates
+			glm::ivec4 origin; // lower corner in voxels, w = cascade index
+			glm::uvec4 gridParams; // grid size, cascade count, dirty box count
+			std::array<glm::ivec4, 4> dirtyMin; // regions to clear and revoxelize (entering slabs, invalidated region), in voxels, max exclusive
+			std::array<glm::ivec4, 4> dirtyMax;
+		};
 
-		std::vector<Attachment> m_rsmAttachments;
-		std::vector<VkClearValue> m_rsmClearValues;
+		struct Cascade
+		{
+			float extent;
+			float voxelSize;
+			glm::ivec3 origin = glm::ivec3(0);
+			bool valid = false; // fully voxelized on first update
+			bool hasInvalidatedRegion = false;
+			glm::ivec3 invalidatedMin; // in voxels, max exclusive
+			glm::ivec3 invalidatedMax;
+
+			CascadeUBO uboData{};
+			UniformBuffer* ubo;
+			InjectionUBO injectionData{};
+			UniformBuffer* uboInjection;
+
+			int voxelClearComputePassID = -1;
+
+			// One indirect draw per cluster, only clusters touching a dirty region are drawn
+			std::vector<MeshCluster> voxelizationClusters;
+			bool cullVoxelizationClusters = true;
+			Buffer* voxelizationDrawCommands = nullptr;
+			int propagationCommandBufferID = -2;
+			std::vector<int> propagationComputePassIDs;
+			bool propagationScheduled = true;
+		};
+		std::vector<Cascade> m_cascades;
 
-		Texture* m_lightVolumesInjectionTexture;
-		Texture* m_lightVolumesInjectionDirTexture;
-		int m_injectionCommandBufferID = -2;
-		int m_injectionComputePassID = -1;
-		UniformBuffer* m_uboInjection;
-		struct UniformBufferObjectInjection
+		/* Sampling */
+		struct SamplingUBO
 		{
-			glm::mat4 voxelProjection;
+			std::array<glm::mat4, LPV_MAX_CASCADES> viewToVoxel; // view space -> absolute voxel coordinates
+			std::array<glm::ivec4, LPV_MAX_CASCADES> origins;
+			glm::uvec4 gridParams; // grid size, cascade count
 		};
-		UniformBufferObjectInjection m_uboInjectionData;*/
+		SamplingUBO m_samplingData;
+		UniformBuffer* m_uboSampling;
 
 		/* Propagation */
-		Image* m_lightVolumesPropagationImage;
-		int m_propagationCommandBufferID = -2;
-		int m_propagationComputePassID = -1;
+		std::array<Image*, 2> m_lightVolumesPropagationImages; // ping-pong between iterations, the last iteration always writes the first one
 	};
 }
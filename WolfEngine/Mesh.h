@@ -1,6 +1,8 @@
 #pragma once
 
 #include "VulkanHelper.h"
+#include "MeshletBuilder.h"
+#include "MeshClusters.h"
 
 namespace Wolf
 {
@@ -11,6 +13,15 @@ namespace Wolf
 		VkBuffer indexBuffer;
 		unsigned int nbIndices;
 	};
+
+	// Storage buffers read by the mesh shader path, see MeshletBuilder.h for the layouts
+	struct MeshletBuffers
+	{
+		VkBuffer meshletBuffer = VK_NULL_HANDLE;
+		VkBuffer vertexIndexBuffer = VK_NULL_HANDLE;
+		VkBuffer triangleIndexBuffer = VK_NULL_HANDLE;
+		uint32_t meshletCount = 0;
+	};
 	
 	template <typename T>
 	class Mesh
@@ -25,22 +36,108 @@ namespace Wolf
 			m_indices = indices;
 
 			createVertexBuffer(device, physicalDevice, commandPool, graphicsQueue, sizeof(m_vertices[0]) * m_vertices.size(), m_vertices.data());
-			createIndexBuffer(device, physicalDevice, commandPool, graphicsQueue);
+			createIndexBuffer(device, physicalDevice, commandPool, graphicsQueue, m_indices, m_indexBuffer, m_indexBufferMemory);
+		}
+
+		// Coarser index list sharing this mesh vertex buffer, error is in model units
+		void addLOD(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, Queue graphicsQueue, const std::vector<uint32_t>& indices, float error,
+			std::vector<MeshCluster> clusters = {})
+		{
+			LOD lod;
+			lod.nbIndices = static_cast<unsigned int>(indices.size());
+			lod.error = error;
+			lod.clusters = std::move(clusters);
+			createIndexBuffer(device, physicalDevice, commandPool, graphicsQueue, indices, lod.indexBuffer, lod.indexBufferMemory);
+
+			m_lods.push_back(lod);
+		}
+
+		// Every LOD after each other in one index buffer (LOD 0 first), indirect draws switch LOD by changing their first index without binding another buffer
+		void createAllLODIndexBuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, Queue graphicsQueue, const std::vector<uint32_t>& allLODIndices,
+			std::vector<uint32_t> lodFirstIndices)
+		{
+			m_allLODIndexCount = static_cast<unsigned int>(allLODIndices.size());
+			m_lodFirstIndices = std::move(lodFirstIndices);
+			createIndexBuffer(device, physicalDevice, commandPool, graphicsQueue, allLODIndices, m_allLODIndexBuffer, m_allLODIndexBufferMemory);
+		}
+
+		// Clusters of the LOD 0 index buffer, indices must already be sorted by cluster
+		void setClusters(std::vector<MeshCluster> clusters) { m_clusters = std::move(clusters); }
+
+		MeshletStats buildMeshlets(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, Queue graphicsQueue, const std::vector<glm::vec3>& positions)
+		{
+			const MeshletData meshletData = Wolf::buildMeshlets(positions, m_indices);
+			if (meshletData.meshlets.empty())
+				return {};
+
+			createDeviceLocalBuffer(device, physicalDevice, commandPool, graphicsQueue, sizeof(Meshlet) * meshletData.meshlets.size(), meshletData.meshlets.data(),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, m_meshletBuffer, m_meshletBufferMemory);
+			createDeviceLocalBuffer(device, physicalDevice, commandPool, graphicsQueue, sizeof(uint32_t) * meshletData.vertexIndices.size(), meshletData.vertexIndices.data(),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, m_meshletVertexIndexBuffer, m_meshletVertexIndexBufferMemory);
+			createDeviceLocalBuffer(device, physicalDevice, commandPool, graphicsQueue, meshletData.triangleIndices.size(), meshletData.triangleIndices.data(),
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, m_meshletTriangleIndexBuffer, m_meshletTriangleIndexBufferMemory);
+			m_meshletCount = static_cast<uint32_t>(meshletData.meshlets.size());
+
+			return computeMeshletStats(meshletData, positions.size());
 		}
 
 		void cleanup(VkDevice device)
 		{
 			m_vertices.clear();
 			m_indices.clear();
+			m_clusters.clear();
 
 			vkDestroyBuffer(device, m_vertexBuffer, nullptr);
 			vkFreeMemory(device, m_vertexBufferMemory, nullptr);
 
 			vkDestroyBuffer(device, m_indexBuffer, nullptr);
 			vkFreeMemory(device, m_indexBufferMemory, nullptr);
+
+			for (LOD& lod : m_lods)
+			{
+				vkDestroyBuffer(device, lod.indexBuffer, nullptr);
+				vkFreeMemory(device, lod.indexBufferMemory, nullptr);
+			}
+			m_lods.clear();
+
+			if (m_allLODIndexBuffer != VK_NULL_HANDLE)
+			{
+				vkDestroyBuffer(device, m_allLODIndexBuffer, nullptr);
+				vkFreeMemory(device, m_allLODIndexBufferMemory, nullptr);
+				m_allLODIndexBuffer = VK_NULL_HANDLE;
+				m_lodFirstIndices.clear();
+			}
+
+			if (m_meshletCount > 0)
+			{
+				vkDestroyBuffer(device, m_meshletBuffer, nullptr);
+				vkFreeMemory(device, m_meshletBufferMemory, nullptr);
+				vkDestroyBuffer(device, m_meshletVertexIndexBuffer, nullptr);
+				vkFreeMemory(device, m_meshletVertexIndexBufferMemory, nullptr);
+				vkDestroyBuffer(device, m_meshletTriangleIndexBuffer, nullptr);
+				vkFreeMemory(device, m_meshletTriangleIndexBufferMemory, nullptr);
+				m_meshletCount = 0;
+			}
 		}
 
 		VertexBuffer getVertexBuffer() const { return { m_vertexBuffer, static_cast<unsigned int>(m_vertices.size()), m_indexBuffer, static_cast<unsigned int>(m_indices.size()) }; }
+		VertexBuffer getVertexBuffer(uint32_t lod) const
+		{
+			if (lod == 0 || lod > m_lods.size())
+				return getVertexBuffer();
+			return { m_vertexBuffer, static_cast<unsigned int>(m_vertices.size()), m_lods[lod - 1].indexBuffer, m_lods[lod - 1].nbIndices };
+		}
+		VertexBuffer getAllLODVertexBuffer() const
+		{
+			if (m_allLODIndexBuffer == VK_NULL_HANDLE)
+				return getVertexBuffer();
+			return { m_vertexBuffer, static_cast<unsigned int>(m_vertices.size()), m_allLODIndexBuffer, m_allLODIndexCount };
+		}
+		uint32_t getAllLODFirstIndex(uint32_t lod) const { return lod < m_lodFirstIndices.size() ? m_lodFirstIndices[lod] : 0; }
+		uint32_t getLODCount() const { return static_cast<uint32_t>(m_lods.size()) + 1; }
+		float getLODError(uint32_t lod) const { return lod == 0 || lod > m_lods.size() ? 0.0f : m_lods[lod - 1].error; }
+		const std::vector<MeshCluster>& getClusters(uint32_t lod) const { return lod == 0 || lod > m_lods.size() ? m_clusters : m_lods[lod - 1].clusters; }
+		MeshletBuffers getMeshletBuffers() const { return { m_meshletBuffer, m_meshletVertexIndexBuffer, m_meshletTriangleIndexBuffer, m_meshletCount }; }
 
 		const std::vector<T> getVertices() { return m_vertices; }
 		const std::vector<uint32_t> getIndices() { return m_indices; }
@@ -55,6 +152,31 @@ namespace Wolf
 		std::vector<uint32_t> m_indices;
 		VkBuffer m_indexBuffer;
 		VkDeviceMemory m_indexBufferMemory;
+		std::vector<MeshCluster> m_clusters;
+
+		// LODs (LOD 0 is the mesh itself)
+		struct LOD
+		{
+			VkBuffer indexBuffer;
+			VkDeviceMemory indexBufferMemory;
+			unsigned int nbIndices;
+			float error;
+			std::vector<MeshCluster> clusters;
+		};
+		std::vector<LOD> m_lods;
+		VkBuffer m_allLODIndexBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory m_allLODIndexBufferMemory = VK_NULL_HANDLE;
+		unsigned int m_allLODIndexCount = 0;
+		std::vector<uint32_t> m_lodFirstIndices; // in m_allLODIndexBuffer
+
+		// Meshlets
+		uint32_t m_meshletCount = 0;
+		VkBuffer m_meshletBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory m_meshletBufferMemory = VK_NULL_HANDLE;
+		VkBuffer m_meshletVertexIndexBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory m_meshletVertexIndexBufferMemory = VK_NULL_HANDLE;
+		VkBuffer m_meshletTriangleIndexBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory m_meshletTriangleIndexBufferMemory = VK_NULL_HANDLE;
 
 	private:
 		void createVertexBuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, Queue graphicsQueue, VkDeviceSize size, void* data)
@@ -76,9 +198,10 @@ namespace Wolf
 			vkFreeMemory(device, stagingBufferMemory, nullptr);
 		}
 
-		void createIndexBuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, Queue graphicsQueue)
+		void createIndexBuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, Queue graphicsQueue, const std::vector<uint32_t>& indices, VkBuffer& indexBuffer,
+			VkDeviceMemory& indexBufferMemory)
 		{
-			const VkDeviceSize bufferSize = sizeof(m_indices[0]) * m_indices.size();
+			const VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
 
 			VkBuffer stagingBuffer;
 			VkDeviceMemory stagingBufferMemory;
@@ -86,12 +209,32 @@ namespace Wolf
 
 			void* data;
 			vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-			memcpy(data, m_indices.data(), static_cast<size_t>(bufferSize));
+			memcpy(data, indices.data(), static_cast<size_t>(bufferSize));
+			vkUnmapMemory(device, stagingBufferMemory);
+
+			createBuffer(device, physicalDevice, bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
+
+			copyBuffer(device, commandPool, graphicsQueue, stagingBuffer, indexBuffer, bufferSize);
+
+			vkDestroyBuffer(device, stagingBuffer, nullptr);
+			vkFreeMemory(device, stagingBufferMemory, nullptr);
+		}
+
+		void createDeviceLocalBuffer(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, Queue graphicsQueue, VkDeviceSize size, const void* data,
+			VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+		{
+			VkBuffer stagingBuffer;
+			VkDeviceMemory stagingBufferMemory;
+			createBuffer(device, physicalDevice, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+
+			void* tData;
+			vkMapMemory(device, stagingBufferMemory, 0, size, 0, &tData);
+			std::memcpy(tData, data, static_cast<size_t>(size));
 			vkUnmapMemory(device, stagingBufferMemory);
 
-			createBuffer(device, physicalDevice, bufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_indexBuffer, m_indexBufferMemory);
+			createBuffer(device, physicalDevice, size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, bufferMemory);
 
-			copyBuffer(device, commandPool, graphicsQueue, stagingBuffer, m_indexBuffer, bufferSize);
+			copyBuffer(device, commandPool, graphicsQueue, stagingBuffer, buffer, size);
 
 			vkDestroyBuffer(device, stagingBuffer, nullptr);
 			vkFreeMemory(device, stagingBufferMemory, nullptr);
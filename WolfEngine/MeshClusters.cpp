@@ -0,0 +1,98 @@
+#include "MeshClusters.h"
+
+#include <algorithm>
+
+std::vector<Wolf::MeshCluster> Wolf::clusterTriangles(const std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices, uint32_t firstIndex, uint32_t indexCount,
+	uint32_t gridResolution)
+{
+	std::vector<MeshCluster> clusters;
+
+	const uint32_t triangleCount = indexCount / 3;
+	if (triangleCount == 0 || gridResolution == 0)
+		return clusters;
+
+	auto triangleCenter = [&](uint32_t triangle)
+	{
+		const uint32_t i = firstIndex + triangle * 3;
+		return (positions[indices[i]] + positions[indices[i + 1]] + positions[indices[i + 2]]) * (1.0f / 3.0f);
+	};
+
+	glm::vec3 minCenter = triangleCenter(0), maxCenter = minCenter;
+	for (uint32_t triangle(1); triangle < triangleCount; ++triangle)
+	{
+		minCenter = glm::min(minCenter, triangleCenter(triangle));
+		maxCenter = glm::max(maxCenter, triangleCenter(triangle));
+	}
+	const glm::vec3 cellScale = static_cast<float>(gridResolution) / glm::max(maxCenter - minCenter, glm::vec3(1e-6f));
+
+	// Counting sort by cell, stable inside a cell
+	const uint32_t cellCount = gridResolution * gridResolution * gridResolution;
+	std::vector<uint32_t> triangleCells(triangleCount);
+	std::vector<uint32_t> cellOffsets(cellCount + 1, 0);
+	for (uint32_t triangle(0); triangle < triangleCount; ++triangle)
+	{
+		const glm::uvec3 cell = glm::min(glm::uvec3((triangleCenter(triangle) - minCenter) * cellScale), glm::uvec3(gridResolution - 1));
+		triangleCells[triangle] = (cell.z * gridResolution + cell.y) * gridResolution + cell.x;
+		cellOffsets[triangleCells[triangle] + 1]++;
+	}
+	for (uint32_t cell(0); cell < cellCount; ++cell)
+		cellOffsets[cell + 1] += cellOffsets[cell];
+
+	std::vector<uint32_t> sortedIndices(triangleCount * 3);
+	{
+		std::vector<uint32_t> fillOffsets(cellOffsets.begin(), cellOffsets.end() - 1);
+		for (uint32_t triangle(0); triangle < triangleCount; ++triangle)
+		{
+			const uint32_t destination = fillOffsets[triangleCells[triangle]]++;
+			for (int k(0); k < 3; ++k)
+				sortedIndices[destination * 3 + k] = indices[firstIndex + triangle * 3 + k];
+		}
+	}
+	std::copy(sortedIndices.begin(), sortedIndices.end(), indices.begin() + firstIndex);
+
+	for (uint32_t cell(0); cell < cellCount; ++cell)
+	{
+		if (cellOffsets[cell] == cellOffsets[cell + 1])
+			continue;
+
+		MeshCluster cluster;
+		cluster.firstIndex = firstIndex + cellOffsets[cell] * 3;
+		cluster.indexCount = (cellOffsets[cell + 1] - cellOffsets[cell]) * 3;
+
+		// Triangles can overlap neighbour cells, bounds are computed on the vertices
+		glm::vec3 minPosition = positions[indices[cluster.firstIndex]], maxPosition = minPosition;
+		for (uint32_t i(cluster.firstIndex); i < cluster.firstIndex + cluster.indexCount; ++i)
+		{
+			minPosition = glm::min(minPosition, positions[indices[i]]);
+			maxPosition = glm::max(maxPosition, positions[indices[i]]);
+		}
+		const glm::vec3 center = (minPosition + maxPosition) * 0.5f;
+		float radius = 0.0f;
+		for (uint32_t i(cluster.firstIndex); i < cluster.firstIndex + cluster.indexCount; ++i)
+			radius = glm::max(radius, glm::length(positions[indices[i]] - center));
+		cluster.boundingSphere = glm::vec4(center, radius);
+
+		clusters.push_back(cluster);
+	}
+
+	return clusters;
+}
+
+std::array<glm::vec4, 5> Wolf::computeShadowCasterPlanes(const glm::mat4& lightSpaceMatrix)
+{
+	// Gribb-Hartmann
+	const glm::vec4 row0(lightSpaceMatrix[0][0], lightSpaceMatrix[1][0], lightSpaceMatrix[2][0], lightSpaceMatrix[3][0]);
+	const glm::vec4 row1(lightSpaceMatrix[0][1], lightSpaceMatrix[1][1], lightSpaceMatrix[2][1], lightSpaceMatrix[3][1]);
+	const glm::vec4 row2(lightSpaceMatrix[0][2], lightSpaceMatrix[1][2], lightSpaceMatrix[2][2], lightSpaceMatrix[3][2]);
+	const glm::vec4 row3(lightSpaceMatrix[0][3], lightSpaceMatrix[1][3], lightSpaceMatrix[2][3], lightSpaceMatrix[3][3]);
+
+	std::array<glm::vec4, 5> planes = { row3 + row0, row3 - row0, row3 + row1, row3 - row1, row3 - row2 };
+	for (glm::vec4& plane : planes)
+	{
+		const float length = glm::length(glm::vec3(plane));
+		if (length > 0.0f)
+			plane /= length;
+	}
+
+	return planes;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+#include <array>
+
+#include <glm/glm.hpp>
+
+namespace Wolf
+{
+	// Contiguous range of an index buffer, drawn with one indirect command
+	struct MeshCluster
+	{
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		glm::vec4 boundingSphere; // center, radius in model space
+	};
+
+	// Reorders the triangles of [firstIndex, firstIndex + indexCount) by cell of a regular grid over their centers, one cluster per non-empty cell.
+	// Triangles outside the range keep their place so draw order constraints (ex: alpha blended triangles last) can be kept.
+	std::vector<MeshCluster> clusterTriangles(const std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices, uint32_t firstIndex, uint32_t indexCount,
+		uint32_t gridResolution = 4);
+
+	// Light-space box planes for shadow casters (depth in [0, 1]), without the near plane: casters between the light and the box still shadow it
+	std::array<glm::vec4, 5> computeShadowCasterPlanes(const glm::mat4& lightSpaceMatrix);
+
+	// Sphere against planes (normal pointing inside, distance in w)
+	inline bool isSphereOutside(const glm::vec4& sphere, const glm::vec4* planes, uint32_t planeCount)
+	{
+		for (uint32_t i(0); i < planeCount; ++i)
+			if (glm::dot(glm::vec3(planes[i]), glm::vec3(sphere)) + planes[i].w < -sphere.w)
+				return true;
+		return false;
+	}
+}
@@ -0,0 +1,226 @@
+#include "MeshSimplification.h"
+
+#include <algorithm>
+#include <array>
+#include <map>
+#include <tuple>
+#include <unordered_map>
+
+namespace
+{
+	struct Quadric
+	{
+		// Upper triangle of the symmetric 4x4 matrix
+		std::array<double, 10> m = {};
+
+		void addPlane(const glm::dvec4& p)
+		{
+			m[0] += p.x * p.x; m[1] += p.x * p.y; m[2] += p.x * p.z; m[3] += p.x * p.w;
+			m[4] += p.y * p.y; m[5] += p.y * p.z; m[6] += p.y * p.w;
+			m[7] += p.z * p.z; m[8] += p.z * p.w;
+			m[9] += p.w * p.w;
+		}
+
+		void add(const Quadric& other)
+		{
+			for (int i(0); i < 10; ++i)
+				m[i] += other.m[i];
+		}
+
+		double evaluate(const glm::vec3& v) const
+		{
+			const double x = v.x, y = v.y, z = v.z;
+			const double error = m[0] * x * x + 2.0 * m[1] * x * y + 2.0 * m[2] * x * z + 2.0 * m[3] * x
+				+ m[4] * y * y + 2.0 * m[5] * y * z + 2.0 * m[6] * y
+				+ m[7] * z * z + 2.0 * m[8] * z
+				+ m[9];
+			return error > 0.0 ? error : 0.0;
+		}
+	};
+
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		double cost;
+	};
+
+	uint64_t edgeKey(uint32_t a, uint32_t b)
+	{
+		return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+	}
+}
+
+std::vector<uint32_t> Wolf::simplifyMesh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, size_t targetIndexCount, float& outError)
+{
+	outError = 0.0f;
+
+	std::vector<uint32_t> result = indices;
+	if (result.size() <= targetIndexCount || result.size() % 3 != 0)
+		return result;
+
+	const uint32_t vertexCount = static_cast<uint32_t>(positions.size());
+
+	// Group vertices sharing a position (attribute seams)
+	std::vector<uint32_t> positionIDs(vertexCount);
+	std::vector<uint32_t> wedgeCounts(vertexCount, 0);
+	{
+		std::map<std::tuple<float, float, float>, uint32_t> firstVertexByPosition;
+		for (uint32_t i(0); i < vertexCount; ++i)
+		{
+			const uint32_t positionID = firstVertexByPosition.emplace(std::make_tuple(positions[i].x, positions[i].y, positions[i].z), i).first->second;
+			positionIDs[i] = positionID;
+			wedgeCounts[positionID]++;
+		}
+	}
+
+	// Lock seams and borders (edges used by a single triangle)
+	std::vector<bool> lockedPositions(vertexCount, false);
+	for (uint32_t i(0); i < vertexCount; ++i)
+		if (wedgeCounts[positionIDs[i]] > 1)
+			lockedPositions[positionIDs[i]] = true;
+
+	std::unordered_map<uint64_t, uint32_t> edgeCounts;
+	for (size_t i(0); i < result.size(); i += 3)
+		for (int k(0); k < 3; ++k)
+			edgeCounts[edgeKey(positionIDs[result[i + k]], positionIDs[result[i + (k + 1) % 3]])]++;
+	for (const auto& edgeCount : edgeCounts)
+	{
+		if (edgeCount.second != 1)
+			continue;
+		lockedPositions[static_cast<uint32_t>(edgeCount.first >> 32)] = true;
+		lockedPositions[static_cast<uint32_t>(edgeCount.first & 0xFFFFFFFF)] = true;
+	}
+
+	std::vector<bool> locked(vertexCount);
+	for (uint32_t i(0); i < vertexCount; ++i)
+		locked[i] = lockedPositions[positionIDs[i]];
+
+	// Initial quadrics from triangle planes
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t i(0); i < result.size(); i += 3)
+	{
+		const glm::vec3 p0 = positions[result[i]];
+		glm::vec3 normal = glm::cross(positions[result[i + 1]] - p0, positions[result[i + 2]] - p0);
+		const float length = glm::length(normal);
+		if (length == 0.0f)
+			continue;
+		normal /= length;
+
+		const glm::dvec4 plane(normal, -glm::dot(normal, p0));
+		for (int k(0); k < 3; ++k)
+			quadrics[result[i + k]].addPlane(plane);
+	}
+
+	const size_t targetTriangleCount = targetIndexCount / 3;
+	size_t triangleCount = result.size() / 3;
+	double maxCost = 0.0;
+
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<Collapse> collapses;
+
+	// Each pass collapses independent edges in increasing cost order
+	while (triangleCount > targetTriangleCount)
+	{
+		// Vertex -> triangles
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (uint32_t index : result)
+			adjacencyOffsets[index + 1]++;
+		for (uint32_t i(0); i < vertexCount; ++i)
+			adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+		adjacency.resize(result.size());
+		std::vector<uint32_t> fillOffsets(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i(0); i < result.size(); ++i)
+			adjacency[fillOffsets[result[i]]++] = static_cast<uint32_t>(i / 3);
+
+		collapses.clear();
+		for (size_t i(0); i < result.size(); i += 3)
+		{
+			for (int k(0); k < 3; ++k)
+			{
+				const uint32_t a = result[i + k];
+				const uint32_t b = result[i + (k + 1) % 3];
+				if (!locked[a])
+					collapses.push_back({ a, b, quadrics[a].evaluate(positions[b]) + quadrics[b].evaluate(positions[b]) });
+				if (!locked[b])
+					collapses.push_back({ b, a, quadrics[b].evaluate(positions[a]) + quadrics[a].evaluate(positions[a]) });
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& l, const Collapse& r) { return l.cost < r.cost; });
+
+		for (uint32_t i(0); i < vertexCount; ++i)
+			remap[i] = i;
+		std::fill(touched.begin(), touched.end(), false);
+
+		const size_t triangleBudget = triangleCount - targetTriangleCount;
+		size_t removedTriangleCount = 0;
+		size_t collapseCount = 0;
+		for (const Collapse& collapse : collapses)
+		{
+			if (removedTriangleCount >= triangleBudget)
+				break;
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+
+			// Reject collapses that flip or badly distort a remaining triangle
+			bool valid = true;
+			size_t removedByCollapse = 0;
+			for (uint32_t j(adjacencyOffsets[collapse.from]); j < adjacencyOffsets[collapse.from + 1] && valid; ++j)
+			{
+				const uint32_t* triangle = &result[adjacency[j] * 3];
+				if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+				{
+					removedByCollapse++;
+					continue;
+				}
+
+				std::array<glm::vec3, 3> before, after;
+				for (int k(0); k < 3; ++k)
+				{
+					before[k] = positions[triangle[k]];
+					after[k] = triangle[k] == collapse.from ? positions[collapse.to] : before[k];
+				}
+				const glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+				const glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+				const float lengths = glm::length(normalBefore) * glm::length(normalAfter);
+				if (lengths == 0.0f || glm::dot(normalBefore, normalAfter) < 0.25f * lengths)
+					valid = false;
+			}
+			if (!valid)
+				continue;
+
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to].add(quadrics[collapse.from]);
+			maxCost = std::max(maxCost, collapse.cost);
+			removedTriangleCount += removedByCollapse;
+			collapseCount++;
+
+			for (uint32_t j(adjacencyOffsets[collapse.from]); j < adjacencyOffsets[collapse.from + 1]; ++j)
+				for (int k(0); k < 3; ++k)
+					touched[result[adjacency[j] * 3 + k]] = true;
+		}
+
+		if (collapseCount == 0)
+			break;
+
+		size_t writeIndex = 0;
+		for (size_t i(0); i < result.size(); i += 3)
+		{
+			const uint32_t a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+			result[writeIndex++] = a;
+			result[writeIndex++] = b;
+			result[writeIndex++] = c;
+		}
+		result.resize(writeIndex);
+		triangleCount = result.size() / 3;
+	}
+
+	outError = static_cast<float>(glm::sqrt(maxCost));
+
+	return result;
+}
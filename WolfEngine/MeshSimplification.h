@@ -0,0 +1,14 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace Wolf
+{
+	// Quadric error metric simplification (Garland-Heckbert) by half-edge collapse.
+	// Vertices are only collapsed onto existing vertices so the result indexes the same vertex buffer.
+	// Vertices on borders or attribute seams (same position, different attributes) are locked.
+	// Returns the simplified index list and writes the geometric error (in model units) to outError.
+	std::vector<uint32_t> simplifyMesh(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, size_t targetIndexCount, float& outError);
+}
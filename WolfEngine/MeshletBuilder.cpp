@@ -0,0 +1,223 @@
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+
+namespace
+{
+	void appendMeshlet(Wolf::MeshletData& meshletData, const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& meshletVertices,
+		const std::vector<uint8_t>& meshletTriangles)
+	{
+		Wolf::Meshlet meshlet;
+		meshlet.vertexOffset = static_cast<uint32_t>(meshletData.vertexIndices.size());
+		meshlet.triangleOffset = static_cast<uint32_t>(meshletData.triangleIndices.size());
+		meshlet.vertexCount = static_cast<uint32_t>(meshletVertices.size());
+		meshlet.triangleCount = static_cast<uint32_t>(meshletTriangles.size() / 3);
+
+		meshletData.vertexIndices.insert(meshletData.vertexIndices.end(), meshletVertices.begin(), meshletVertices.end());
+		meshletData.triangleIndices.insert(meshletData.triangleIndices.end(), meshletTriangles.begin(), meshletTriangles.end());
+		while (meshletData.triangleIndices.size() % 4 != 0)
+			meshletData.triangleIndices.push_back(0);
+
+		// Bounding sphere around the AABB center
+		glm::vec3 minPosition = positions[meshletVertices[0]], maxPosition = positions[meshletVertices[0]];
+		for (uint32_t vertex : meshletVertices)
+		{
+			minPosition = glm::min(minPosition, positions[vertex]);
+			maxPosition = glm::max(maxPosition, positions[vertex]);
+		}
+		const glm::vec3 center = (minPosition + maxPosition) * 0.5f;
+		float radius = 0.0f;
+		for (uint32_t vertex : meshletVertices)
+			radius = glm::max(radius, glm::length(positions[vertex] - center));
+		meshlet.boundingSphere = glm::vec4(center, radius);
+
+		// Normal cone
+		std::vector<glm::vec3> normals;
+		normals.reserve(meshlet.triangleCount);
+		glm::vec3 axis(0.0f);
+		for (size_t i(0); i < meshletTriangles.size(); i += 3)
+		{
+			const glm::vec3 p0 = positions[meshletVertices[meshletTriangles[i]]];
+			const glm::vec3 normal = glm::cross(positions[meshletVertices[meshletTriangles[i + 1]]] - p0, positions[meshletVertices[meshletTriangles[i + 2]]] - p0);
+			const float length = glm::length(normal);
+			if (length == 0.0f)
+				continue;
+			normals.push_back(normal / length);
+			axis += normals.back();
+		}
+
+		meshlet.cone = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f); // never culled
+		const float axisLength = glm::length(axis);
+		if (axisLength > 0.0f)
+		{
+			axis /= axisLength;
+			float minDot = 1.0f;
+			for (const glm::vec3& normal : normals)
+				minDot = glm::min(minDot, glm::dot(axis, normal));
+
+			// Normals spread over more than a hemisphere can't be culled as a whole
+			if (minDot > 0.0f)
+				meshlet.cone = glm::vec4(axis, glm::sqrt(1.0f - minDot * minDot));
+			else
+				meshlet.cone = glm::vec4(axis, 1.0f);
+		}
+
+		meshletData.meshlets.push_back(meshlet);
+	}
+}
+
+Wolf::MeshletData Wolf::buildMeshlets(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, uint32_t maxVertices, uint32_t maxTriangles)
+{
+	MeshletData meshletData;
+
+	const size_t triangleCount = indices.size() / 3;
+	const uint32_t vertexCount = static_cast<uint32_t>(positions.size());
+	if (triangleCount == 0 || maxVertices < 3 || maxTriangles == 0 || maxVertices > 256)
+		return meshletData;
+
+	// Vertex -> triangles
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t i(0); i < triangleCount * 3; ++i)
+		adjacencyOffsets[indices[i] + 1]++;
+	for (uint32_t i(0); i < vertexCount; ++i)
+		adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	{
+		std::vector<uint32_t> fillOffsets(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i(0); i < triangleCount * 3; ++i)
+			adjacency[fillOffsets[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<int> localVertices(vertexCount, -1);
+	std::vector<uint32_t> meshletVertices;
+	std::vector<uint8_t> meshletTriangles;
+	meshletVertices.reserve(maxVertices);
+	meshletTriangles.reserve(maxTriangles * 3);
+	glm::vec3 meshletCenterSum(0.0f);
+
+	// Next meshlet starts next to the previous one to avoid leaving small islands behind
+	int64_t nextNeighbourSeed = -1;
+	auto finishMeshlet = [&]()
+	{
+		appendMeshlet(meshletData, positions, meshletVertices, meshletTriangles);
+		nextNeighbourSeed = -1;
+		for (uint32_t vertex : meshletVertices)
+		{
+			localVertices[vertex] = -1;
+			for (uint32_t j(adjacencyOffsets[vertex]); j < adjacencyOffsets[vertex + 1] && nextNeighbourSeed < 0; ++j)
+				if (!emitted[adjacency[j]])
+					nextNeighbourSeed = adjacency[j];
+		}
+		meshletVertices.clear();
+		meshletTriangles.clear();
+		meshletCenterSum = glm::vec3(0.0f);
+	};
+
+	auto triangleCenter = [&](uint32_t triangle)
+	{
+		return (positions[indices[triangle * 3]] + positions[indices[triangle * 3 + 1]] + positions[indices[triangle * 3 + 2]]) * (1.0f / 3.0f);
+	};
+
+	size_t nextSeed = 0;
+	while (true)
+	{
+		// Adjacent triangle adding the fewest new vertices, closest to the meshlet center to keep it compact
+		int64_t bestTriangle = -1;
+		uint32_t bestNewVertexCount = 4;
+		float bestDistance = 0.0f;
+		const glm::vec3 meshletCenter = meshletTriangles.empty() ? glm::vec3(0.0f) : meshletCenterSum / static_cast<float>(meshletTriangles.size() / 3);
+		if (meshletTriangles.size() / 3 < maxTriangles)
+		{
+			for (size_t i(0); i < meshletVertices.size(); ++i)
+			{
+				const uint32_t vertex = meshletVertices[i];
+				for (uint32_t j(adjacencyOffsets[vertex]); j < adjacencyOffsets[vertex + 1]; ++j)
+				{
+					const uint32_t triangle = adjacency[j];
+					if (emitted[triangle])
+						continue;
+
+					uint32_t newVertexCount = 0;
+					for (int k(0); k < 3; ++k)
+						if (localVertices[indices[triangle * 3 + k]] < 0)
+							newVertexCount++;
+					if (newVertexCount > bestNewVertexCount)
+						continue;
+
+					const glm::vec3 offset = triangleCenter(triangle) - meshletCenter;
+					const float distance = glm::dot(offset, offset);
+					if (newVertexCount < bestNewVertexCount || distance < bestDistance)
+					{
+						bestTriangle = triangle;
+						bestNewVertexCount = newVertexCount;
+						bestDistance = distance;
+					}
+				}
+			}
+			if (bestTriangle >= 0 && meshletVertices.size() + bestNewVertexCount > maxVertices)
+				bestTriangle = -1;
+		}
+
+		if (bestTriangle < 0)
+		{
+			if (!meshletTriangles.empty())
+			{
+				finishMeshlet();
+				continue;
+			}
+
+			if (nextNeighbourSeed >= 0)
+				bestTriangle = nextNeighbourSeed;
+			else
+			{
+				while (nextSeed < triangleCount && emitted[nextSeed])
+					nextSeed++;
+				if (nextSeed == triangleCount)
+					break;
+				bestTriangle = static_cast<int64_t>(nextSeed);
+			}
+			nextNeighbourSeed = -1;
+		}
+
+		for (int k(0); k < 3; ++k)
+		{
+			const uint32_t vertex = indices[bestTriangle * 3 + k];
+			if (localVertices[vertex] < 0)
+			{
+				localVertices[vertex] = static_cast<int>(meshletVertices.size());
+				meshletVertices.push_back(vertex);
+			}
+			meshletTriangles.push_back(static_cast<uint8_t>(localVertices[vertex]));
+		}
+		emitted[bestTriangle] = true;
+		meshletCenterSum += triangleCenter(static_cast<uint32_t>(bestTriangle));
+	}
+
+	return meshletData;
+}
+
+Wolf::MeshletStats Wolf::computeMeshletStats(const MeshletData& meshletData, size_t vertexCount)
+{
+	MeshletStats stats;
+	stats.meshletCount = meshletData.meshlets.size();
+	if (stats.meshletCount == 0)
+		return stats;
+
+	size_t totalVertexCount = 0, totalTriangleCount = 0;
+	for (const Meshlet& meshlet : meshletData.meshlets)
+	{
+		totalVertexCount += meshlet.vertexCount;
+		totalTriangleCount += meshlet.triangleCount;
+		if (meshlet.cone.w < 1.0f)
+			stats.cullableConeCount++;
+	}
+
+	stats.averageVertexCount = static_cast<float>(totalVertexCount) / static_cast<float>(stats.meshletCount);
+	stats.averageTriangleCount = static_cast<float>(totalTriangleCount) / static_cast<float>(stats.meshletCount);
+	stats.vertexFill = stats.averageVertexCount / static_cast<float>(MESHLET_MAX_VERTICES);
+	stats.triangleFill = stats.averageTriangleCount / static_cast<float>(MESHLET_MAX_TRIANGLES);
+	stats.vertexReuse = vertexCount > 0 ? static_cast<float>(totalVertexCount) / static_cast<float>(vertexCount) : 0.0f;
+
+	return stats;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace Wolf
+{
+	constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+	constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+	constexpr uint32_t MESHLETS_PER_TASK = 32; // task shader workgroup size
+
+	// GPU layout (std430)
+	struct Meshlet
+	{
+		uint32_t vertexOffset; // in MeshletData::vertexIndices
+		uint32_t triangleOffset; // in MeshletData::triangleIndices, multiple of 4
+		uint32_t vertexCount;
+		uint32_t triangleCount;
+
+		glm::vec4 boundingSphere; // center, radius
+		glm::vec4 cone; // axis, cutoff -> culled if dot(center - camera, axis) >= cutoff * length(center - camera) + radius
+	};
+
+	struct MeshletData
+	{
+		std::vector<Meshlet> meshlets;
+		std::vector<uint32_t> vertexIndices; // meshlet local vertex -> mesh vertex
+		std::vector<uint8_t> triangleIndices; // 3 local vertices per triangle, each meshlet padded to 4 bytes
+	};
+
+	struct MeshletStats
+	{
+		size_t meshletCount = 0;
+		float averageVertexCount = 0.0f;
+		float averageTriangleCount = 0.0f;
+		float vertexFill = 0.0f; // average vertex count / MESHLET_MAX_VERTICES
+		float triangleFill = 0.0f; // average triangle count / MESHLET_MAX_TRIANGLES
+		float vertexReuse = 0.0f; // meshlet vertices / mesh vertices, 1 is ideal
+		size_t cullableConeCount = 0; // meshlets whose normals are coherent enough for backface cone culling
+	};
+
+	// Greedy clustering of adjacent triangles, a meshlet is closed when no adjacent triangle fits anymore
+	MeshletData buildMeshlets(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, uint32_t maxVertices = MESHLET_MAX_VERTICES,
+		uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
+	MeshletStats computeMeshletStats(const MeshletData& meshletData, size_t vertexCount);
+
+	// Same test as the task shader
+	inline bool isMeshletBackfacing(const Meshlet& meshlet, glm::vec3 cameraPosition)
+	{
+		const glm::vec3 toCenter = glm::vec3(meshlet.boundingSphere) - cameraPosition;
+		return glm::dot(toCenter, glm::vec3(meshlet.cone)) >= meshlet.cone.w * glm::length(toCenter) + meshlet.boundingSphere.w;
+	}
+
+	inline uint32_t getMeshletTaskCount(uint32_t meshletCount) { return (meshletCount + MESHLETS_PER_TASK - 1) / MESHLETS_PER_TASK; }
+}
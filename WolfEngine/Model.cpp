@@ -18,3 +18,26 @@ std::vector<Wolf::Image*> Wolf::Model::getImages() const
 
 	return r;
 }
+
+uint32_t Wolf::Model::selectLOD(float pixelsPerUnit, float maxPixelError) const
+{
+	uint32_t selectedLOD = 0;
+	for (uint32_t lod(1); lod < getLODCount(); ++lod)
+	{
+		if (getLODError(lod) * pixelsPerUnit > maxPixelError)
+			break;
+		selectedLOD = lod;
+	}
+
+	return selectedLOD;
+}
+
+float Wolf::Model::computePixelsPerUnit(const glm::mat4& projection, float viewportHeight, float distance)
+{
+	const float pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f;
+
+	// Orthographic projections don't depend on distance
+	if (projection[3][3] == 1.0f)
+		return glm::abs(pixelsPerUnit);
+	return glm::abs(pixelsPerUnit) / glm::max(distance, 1e-4f);
+}
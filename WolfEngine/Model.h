@@ -4,6 +4,7 @@
 #include "InputVertexTemplate.h"
 #include "Image.h"
 #include "Sampler.h"
+#include "BindlessTextures.h"
 
 namespace Wolf
 {
@@ -32,13 +33,39 @@ namespace Wolf
 
 			// Material Options
 			bool loadMaterials = true;
+
+			// Level of details, each LOD halves the triangle count (1 = no simplification)
+			uint32_t lodCount = 1;
+
+			// Meshlets for the mesh shader path, vertex and index buffers are kept for devices without mesh shaders
+			bool generateMeshlets = false;
+
+			// Material textures are added to the table, vertex material IDs stay local to the model (getImages() still matches them):
+			// texture = table[MATERIAL_TEXTURE_COUNT * (getFirstBindlessMaterial() + materialID) + i]
+			BindlessTextures* bindlessTextures = nullptr;
 		};
 		virtual void loadObj(ModelLoadingInfo modelLoadingInfo) {}
 
 		virtual std::vector<VertexBuffer> getVertexBuffers() const { return {}; }
+		virtual std::vector<VertexBuffer> getLODVertexBuffers(uint32_t lod) const { return getVertexBuffers(); }
+		virtual uint32_t getLODCount() const { return 1; }
+		virtual float getLODError(uint32_t lod) const { return 0.0f; }
+		virtual std::vector<MeshletBuffers> getMeshletBuffers() const { return {}; }
+		// allLODIndexBuffer: clusters index the buffers of getAllLODVertexBuffers() instead of getLODVertexBuffers(lod)
+		virtual std::vector<std::vector<MeshCluster>> getLODClusters(uint32_t lod, bool allLODIndexBuffer = false) const { return {}; }
+		virtual std::vector<VertexBuffer> getAllLODVertexBuffers() const { return getVertexBuffers(); }
+
+		// Coarsest LOD whose projected error stays under maxPixelError
+		uint32_t selectLOD(float pixelsPerUnit, float maxPixelError = 1.0f) const;
+		static float computePixelsPerUnit(const glm::mat4& projection, float viewportHeight, float distance);
 		virtual size_t getNumberOfImages() const { return m_images.size(); }
 		virtual Sampler* getSampler() const { return m_sampler.get(); }
 		virtual std::vector<Image*> getImages() const;
+		BindlessTextures* getBindlessTextures() const { return m_bindlessTextures; }
+		int getFirstBindlessTexture() const { return m_firstBindlessTexture; }
+		uint32_t getFirstBindlessMaterial() const { return m_firstBindlessTexture >= 0 ? static_cast<uint32_t>(m_firstBindlessTexture) / MATERIAL_TEXTURE_COUNT : 0; }
+
+		static constexpr uint32_t MATERIAL_TEXTURE_COUNT = 5; // textures per material, see Model3D::loadObj
 		
 	protected:
 		VkDevice m_device;
@@ -50,5 +77,8 @@ namespace Wolf
 
 		std::vector<std::unique_ptr<Image>> m_images;
 		std::unique_ptr<Sampler> m_sampler;
+
+		BindlessTextures* m_bindlessTextures = nullptr;
+		int m_firstBindlessTexture = -1;
 	};
 }
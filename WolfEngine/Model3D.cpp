@@ -4,9 +4,11 @@
 #include <tiny_obj_loader.h>
 #include <unordered_map>
 #include <array>
+#include <chrono>
 #include <glm/gtx/intersect.hpp>
 
 #include "Debug.h"
+#include "MeshSimplification.h"
 
 Wolf::Model3D::~Model3D()
 {
@@ -157,13 +159,73 @@ void Wolf::Model3D::loadObj(ModelLoadingInfo modelLoadingInfo)
 	if(!m_images.empty())
 		m_sampler = std::make_unique<Sampler>(m_device, VK_SAMPLER_ADDRESS_MODE_REPEAT, static_cast<float>(m_images[0]->getMipLevels()), VK_FILTER_LINEAR);
 
+	// Textures are also added to the global table. Vertex material IDs are kept local so passes binding getImages() still work,
+	// bindless passes add getFirstBindlessMaterial() in the shader
+	if (modelLoadingInfo.bindlessTextures && !m_images.empty())
+	{
+		const int firstTexture = modelLoadingInfo.bindlessTextures->addTextures(getImages(), MATERIAL_TEXTURE_COUNT);
+		if (firstTexture >= 0)
+		{
+			m_bindlessTextures = modelLoadingInfo.bindlessTextures;
+			m_firstBindlessTexture = firstTexture;
+		}
+	}
+
+	// Spatial clusters for shadow caster culling, alpha blended triangles stay last
+	std::vector<glm::vec3> positions(vertices.size());
+	for (size_t i(0); i < vertices.size(); ++i)
+		positions[i] = vertices[i].pos;
+	const uint32_t opaqueIndexCount = static_cast<uint32_t>(indices.size() - lastIndices.size());
+	std::vector<MeshCluster> clusters = clusterTriangles(positions, indices, 0, opaqueIndexCount);
+	std::vector<MeshCluster> lastClusters = clusterTriangles(positions, indices, opaqueIndexCount, static_cast<uint32_t>(lastIndices.size()));
+	clusters.insert(clusters.end(), lastClusters.begin(), lastClusters.end());
+
 	Mesh<Vertex3D> mesh;
 	mesh.loadFromVertices(m_device, m_physicalDevice, m_commandPool, m_graphicsQueue, vertices, indices);
+	mesh.setClusters(std::move(clusters));
+	generateLODs(mesh, modelLoadingInfo.lodCount);
+	if (modelLoadingInfo.generateMeshlets)
+		generateMeshlets(mesh);
 	m_meshes.push_back(mesh);
 	
 	Debug::sendInfo("Model loaded with " + std::to_string(indices.size() / 3) + " triangles");
 }
 
+void Wolf::Model3D::generateLODs(Mesh<Vertex3D>& mesh, uint32_t lodCount)
+{
+	const std::vector<Vertex3D> vertices = mesh.getVertices();
+	std::vector<glm::vec3> positions(vertices.size());
+	for (size_t i(0); i < vertices.size(); ++i)
+		positions[i] = vertices[i].pos;
+
+	std::vector<uint32_t> lodIndices = mesh.getIndices();
+	std::vector<uint32_t> allLODIndices = lodIndices;
+	std::vector<uint32_t> lodFirstIndices = { 0 };
+	for (uint32_t lod(1); lod < lodCount; ++lod)
+	{
+		float error;
+		const size_t targetIndexCount = (lodIndices.size() / 6) * 3;
+		std::vector<uint32_t> simplifiedIndices = simplifyMesh(positions, lodIndices, targetIndexCount, error);
+
+		// Locked borders and seams prevent further simplification
+		if (simplifiedIndices.empty() || simplifiedIndices.size() >= lodIndices.size() * 9 / 10)
+			break;
+
+		// Errors must be increasing for the selection
+		error = glm::max(error, mesh.getLODError(lod - 1));
+		std::vector<MeshCluster> clusters = clusterTriangles(positions, simplifiedIndices, 0, static_cast<uint32_t>(simplifiedIndices.size()));
+		mesh.addLOD(m_device, m_physicalDevice, m_commandPool, m_graphicsQueue, simplifiedIndices, error, std::move(clusters));
+		lodFirstIndices.push_back(static_cast<uint32_t>(allLODIndices.size()));
+		allLODIndices.insert(allLODIndices.end(), simplifiedIndices.begin(), simplifiedIndices.end());
+		lodIndices = std::move(simplifiedIndices);
+
+		Debug::sendInfo("LOD " + std::to_string(lod) + " generated with " + std::to_string(lodIndices.size() / 3) + " triangles (error " + std::to_string(error) + ")");
+	}
+
+	if (lodFirstIndices.size() > 1)
+		mesh.createAllLODIndexBuffer(m_device, m_physicalDevice, m_commandPool, m_graphicsQueue, allLODIndices, std::move(lodFirstIndices));
+}
+
 bool Wolf::Model3D::checkIntersection(glm::vec3 point1, glm::vec3 point2)
 {
 	for (int i(0); i < m_meshes.size(); ++i)
@@ -199,3 +261,90 @@ std::vector<Wolf::VertexBuffer> Wolf::Model3D::getVertexBuffers() const
 
 	return vertexBuffers;
 }
+
+void Wolf::Model3D::generateMeshlets(Mesh<Vertex3D>& mesh)
+{
+	const std::vector<Vertex3D> vertices = mesh.getVertices();
+	std::vector<glm::vec3> positions(vertices.size());
+	for (size_t i(0); i < vertices.size(); ++i)
+		positions[i] = vertices[i].pos;
+
+	const auto start = std::chrono::steady_clock::now();
+	const MeshletStats stats = mesh.buildMeshlets(m_device, m_physicalDevice, m_commandPool, m_graphicsQueue, positions);
+	const long long buildTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+
+	Debug::sendInfo(std::to_string(stats.meshletCount) + " meshlets built in " + std::to_string(buildTime) + " ms (" + std::to_string(stats.averageVertexCount) + " vertices, " +
+		std::to_string(stats.averageTriangleCount) + " triangles on average, vertex reuse " + std::to_string(stats.vertexReuse) + ", " + std::to_string(stats.cullableConeCount) + " cullable cones)");
+}
+
+std::vector<Wolf::VertexBuffer> Wolf::Model3D::getLODVertexBuffers(uint32_t lod) const
+{
+	std::vector<VertexBuffer> vertexBuffers;
+
+	for (auto& m_mesh : m_meshes)
+	{
+		vertexBuffers.push_back(m_mesh.getVertexBuffer(glm::min(lod, m_mesh.getLODCount() - 1)));
+	}
+
+	return vertexBuffers;
+}
+
+uint32_t Wolf::Model3D::getLODCount() const
+{
+	uint32_t lodCount = 1;
+	for (auto& m_mesh : m_meshes)
+		lodCount = glm::max(lodCount, m_mesh.getLODCount());
+
+	return lodCount;
+}
+
+float Wolf::Model3D::getLODError(uint32_t lod) const
+{
+	float error = 0.0f;
+	for (auto& m_mesh : m_meshes)
+		error = glm::max(error, m_mesh.getLODError(glm::min(lod, m_mesh.getLODCount() - 1)));
+
+	return error;
+}
+
+std::vector<Wolf::MeshletBuffers> Wolf::Model3D::getMeshletBuffers() const
+{
+	std::vector<MeshletBuffers> meshletBuffers;
+
+	for (auto& m_mesh : m_meshes)
+	{
+		meshletBuffers.push_back(m_mesh.getMeshletBuffers());
+	}
+
+	return meshletBuffers;
+}
+
+std::vector<std::vector<Wolf::MeshCluster>> Wolf::Model3D::getLODClusters(uint32_t lod, bool allLODIndexBuffer) const
+{
+	std::vector<std::vector<MeshCluster>> clusters;
+
+	for (auto& m_mesh : m_meshes)
+	{
+		const uint32_t meshLOD = glm::min(lod, m_mesh.getLODCount() - 1);
+		clusters.push_back(m_mesh.getClusters(meshLOD));
+		if (allLODIndexBuffer)
+		{
+			for (MeshCluster& cluster : clusters.back())
+				cluster.firstIndex += m_mesh.getAllLODFirstIndex(meshLOD);
+		}
+	}
+
+	return clusters;
+}
+
+std::vector<Wolf::VertexBuffer> Wolf::Model3D::getAllLODVertexBuffers() const
+{
+	std::vector<VertexBuffer> vertexBuffers;
+
+	for (auto& m_mesh : m_meshes)
+	{
+		vertexBuffers.push_back(m_mesh.getAllLODVertexBuffer());
+	}
+
+	return vertexBuffers;
+}
\ No newline at end of file
@@ -18,9 +18,17 @@ namespace Wolf
 		bool checkIntersection(glm::vec3 point1, glm::vec3 point2);
 
 		std::vector<Wolf::VertexBuffer> getVertexBuffers() const;
+		std::vector<Wolf::VertexBuffer> getLODVertexBuffers(uint32_t lod) const;
+		uint32_t getLODCount() const;
+		float getLODError(uint32_t lod) const;
+		std::vector<Wolf::MeshletBuffers> getMeshletBuffers() const;
+		std::vector<std::vector<Wolf::MeshCluster>> getLODClusters(uint32_t lod, bool allLODIndexBuffer = false) const;
+		std::vector<Wolf::VertexBuffer> getAllLODVertexBuffers() const;
 
 	private:
 		static std::string getTexName(std::string texName, std::string folder);
+		void generateLODs(Mesh<Vertex3D>& mesh, uint32_t lodCount);
+		void generateMeshlets(Mesh<Vertex3D>& mesh);
 
 	private:
 		std::vector<Wolf::Mesh<Vertex3D>> m_meshes;
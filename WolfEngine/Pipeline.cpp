@@ -14,7 +14,8 @@ Wolf::Pipeline::Pipeline(VkDevice device, RenderingPipelineCreateInfo renderingP
 	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(renderingPipelineCreateInfo.descriptorSetLayouts.size());
 	pipelineLayoutInfo.pSetLayouts = renderingPipelineCreateInfo.descriptorSetLayouts.data();
-	pipelineLayoutInfo.pushConstantRangeCount = 0;
+	pipelineLayoutInfo.pushConstantRangeCount = static_cast<uint32_t>(renderingPipelineCreateInfo.pushConstantRanges.size());
+	pipelineLayoutInfo.pPushConstantRanges = renderingPipelineCreateInfo.pushConstantRanges.data();
 
 	if (vkCreatePipelineLayout(m_device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS)
 		Debug::sendError("Error : create pipeline layout");
@@ -148,6 +149,9 @@ Wolf::Pipeline::Pipeline(VkDevice device, RenderingPipelineCreateInfo renderingP
 				VK_COLOR_COMPONENT_A_BIT;
 			colorBlendAttachments[i].blendEnable = VK_FALSE;
 		}
+
+		if (!renderingPipelineCreateInfo.enableColorWrites)
+			colorBlendAttachments[i].colorWriteMask = 0;
 	}
 
 	VkPipelineColorBlendStateCreateInfo colorBlending = {};
@@ -171,6 +175,14 @@ Wolf::Pipeline::Pipeline(VkDevice device, RenderingPipelineCreateInfo renderingP
 	pipelineInfo.pRasterizationState = &rasterizer;
 	pipelineInfo.pMultisampleState = &multisampling;
 	pipelineInfo.pColorBlendState = &colorBlending;
+
+	std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo dynamicState = {};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+	dynamicState.pDynamicStates = dynamicStates.data();
+	if (renderingPipelineCreateInfo.dynamicViewport)
+		pipelineInfo.pDynamicState = &dynamicState;
 	pipelineInfo.layout = m_pipelineLayout;
 	pipelineInfo.renderPass = renderingPipelineCreateInfo.renderPass;
 	pipelineInfo.subpass = 0;
@@ -179,8 +191,8 @@ Wolf::Pipeline::Pipeline(VkDevice device, RenderingPipelineCreateInfo renderingP
 	VkPipelineDepthStencilStateCreateInfo depthStencil = {};
 	depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 	depthStencil.depthTestEnable = renderingPipelineCreateInfo.enableDepthTesting;
-	depthStencil.depthWriteEnable = VK_TRUE;
-	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+	depthStencil.depthWriteEnable = renderingPipelineCreateInfo.enableDepthWrite;
+	depthStencil.depthCompareOp = renderingPipelineCreateInfo.depthCompareOp;
 	depthStencil.depthBoundsTestEnable = VK_FALSE;
 	depthStencil.stencilTestEnable = VK_FALSE;
 
@@ -214,7 +226,7 @@ Wolf::Pipeline::Pipeline(VkDevice device, RenderingPipelineCreateInfo renderingP
 		vkDestroyShaderModule(m_device, shaderModule, nullptr);
 }
 
-Wolf::Pipeline::Pipeline(VkDevice device, std::string computeShader, VkDescriptorSetLayout* descriptorSetLayout)
+Wolf::Pipeline::Pipeline(VkDevice device, std::string computeShader, VkDescriptorSetLayout* descriptorSetLayout, const std::vector<uint32_t>& specializationConstants)
 {
 	m_device = device;
 	
@@ -230,6 +242,22 @@ Wolf::Pipeline::Pipeline(VkDevice device, std::string computeShader, VkDescripto
 	compShaderStageInfo.module = computeShaderModule;
 	compShaderStageInfo.pName = "main";
 
+	// Constant i is specialization constant_id i
+	std::vector<VkSpecializationMapEntry> specializationMapEntries(specializationConstants.size());
+	for (uint32_t i(0); i < specializationMapEntries.size(); ++i)
+	{
+		specializationMapEntries[i].constantID = i;
+		specializationMapEntries[i].offset = i * sizeof(uint32_t);
+		specializationMapEntries[i].size = sizeof(uint32_t);
+	}
+	VkSpecializationInfo specializationInfo = {};
+	specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationMapEntries.size());
+	specializationInfo.pMapEntries = specializationMapEntries.data();
+	specializationInfo.dataSize = specializationConstants.size() * sizeof(uint32_t);
+	specializationInfo.pData = specializationConstants.data();
+	if (!specializationConstants.empty())
+		compShaderStageInfo.pSpecializationInfo = &specializationInfo;
+
 	/* Pipeline */
 	VkComputePipelineCreateInfo pipelineInfo;
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
@@ -22,6 +22,7 @@ namespace Wolf
 
 		// Descriptor Set Layout
 		std::vector<VkDescriptorSetLayout> descriptorSetLayouts;
+		std::vector<VkPushConstantRange> pushConstantRanges; // declared by the pipeline, per draw data comes from AddMeshInfo::pushConstants
 
 		// IA
 		std::vector<VkVertexInputBindingDescription> vertexInputBindingDescriptions;
@@ -33,6 +34,7 @@ namespace Wolf
 		VkExtent2D extent = {0, 0 };
 		std::array<float, 2> viewportScale = { 1.0f, 1.0f };
 		std::array<float, 2> viewportOffset = { 0.0f, 0.0f };
+		bool dynamicViewport = false; // viewport and scissor are set at record, ex: dynamic resolution
 
 		// Rasterization
 		VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
@@ -46,9 +48,12 @@ namespace Wolf
 		// Color Blend
 		std::vector<bool> alphaBlending;
 		bool addColors = false;
+		bool enableColorWrites = true; // false for depth only passes sharing a render pass with color outputs
 
 		// Depth testing
 		VkBool32 enableDepthTesting = VK_TRUE;
+		VkBool32 enableDepthWrite = VK_TRUE;
+		VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
 
 		// Tessellation
 		uint32_t patchControlPoint = 0;
@@ -58,7 +63,7 @@ namespace Wolf
 	{
 	public:
 		Pipeline(VkDevice device, RenderingPipelineCreateInfo renderingPipelineCreateInfo);
-		Pipeline(VkDevice device, std::string computeShader, VkDescriptorSetLayout* descriptorSetLayout);
+		Pipeline(VkDevice device, std::string computeShader, VkDescriptorSetLayout* descriptorSetLayout, const std::vector<uint32_t>& specializationConstants = {});
 		~Pipeline();
 
 		VkPipeline getPipeline() const { return m_pipeline; }
@@ -40,8 +40,19 @@ Wolf::RayTracingPass::RayTracingPass(VkDevice device, VkPhysicalDevice physicalD
 	m_shaderBindingTable = std::make_unique<ShaderBindingTable>(m_device, m_physicalDevice, shaderBindingTableCreateInfo);
 }
 
-void Wolf::RayTracingPass::create(VkDescriptorPool descriptorPool)
+Wolf::RayTracingPass::~RayTracingPass()
 {
+	if (m_descriptorSetPool)
+		m_descriptorSetPool->freeDescriptorSet(m_descriptorSet);
+	releaseDescriptorSetLayout(m_descriptorSetLayout);
+}
+
+void Wolf::RayTracingPass::create(DescriptorPool* descriptorPool)
+{
+	if (m_descriptorSetPool)
+		m_descriptorSetPool->freeDescriptorSet(m_descriptorSet);
+
+	m_descriptorSetPool = descriptorPool;
 	m_descriptorSet = createDescriptorSet(m_device, m_descriptorSetLayout, descriptorPool, m_descriptorSetCreateInfo);
 }
 
@@ -29,7 +29,9 @@ namespace Wolf
 		RayTracingPass(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool,
 			RayTracingPassCreateInfo rayTracingPassCreateInfo);
 
-		void create(VkDescriptorPool descriptorPool);
+		~RayTracingPass();
+
+		void create(DescriptorPool* descriptorPool); // can be called again, the previous set is released
 		void record(VkCommandBuffer commandBuffer, VkExtent3D extent);
 
 	private:
@@ -52,7 +54,8 @@ namespace Wolf
 
 		// Pipeline info
 		DescriptorSetCreateInfo m_descriptorSetCreateInfo;
-		VkDescriptorSet m_descriptorSet;
+		DescriptorPool* m_descriptorSetPool = nullptr;
+		VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
 		VkDescriptorSetLayout m_descriptorSetLayout;
 
 		VkPipelineLayout m_pipelineLayout;
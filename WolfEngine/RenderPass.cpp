@@ -1,6 +1,7 @@
 #include "RenderPass.h"
 
 #include <utility>
+#include <algorithm>
 
 Wolf::RenderPass::RenderPass(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, Queue graphicsQueue,
                              const std::vector<Attachment>& attachments, std::vector<VkExtent2D> extents)
@@ -36,14 +37,14 @@ void Wolf::RenderPass::initialize(VkDevice device, VkPhysicalDevice physicalDevi
 		m_framebuffers[i].initialize(device, physicalDevice, commandPool, graphicsQueue, m_renderPass, images[i], attachments);
 }
 
-void Wolf::RenderPass::beginRenderPass(size_t framebufferID, std::vector<VkClearValue>& clearValues, VkCommandBuffer commandBuffer)
+void Wolf::RenderPass::beginRenderPass(size_t framebufferID, std::vector<VkClearValue>& clearValues, VkCommandBuffer commandBuffer, VkExtent2D renderArea)
 {
 	VkRenderPassBeginInfo renderPassInfo = {};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 	renderPassInfo.renderPass = m_renderPass;
 	renderPassInfo.framebuffer = m_framebuffers[framebufferID].getFramebuffer();
 	renderPassInfo.renderArea.offset = { 0, 0 };
-	renderPassInfo.renderArea.extent = m_framebuffers[framebufferID].getExtent();
+	renderPassInfo.renderArea.extent = renderArea.width > 0 ? renderArea : m_framebuffers[framebufferID].getExtent();
 
 	renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 	renderPassInfo.pClearValues = clearValues.data();
@@ -161,6 +162,21 @@ VkRenderPass Wolf::RenderPass::createRenderPass(VkDevice device, std::vector<Att
 	renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
 	renderPassInfo.pDependencies = dependencies.data();
 
+	// Multiview: the subpass is broadcast to every layer of the attachments (gl_ViewIndex in shaders), requires VK_KHR_multiview (multiviewAvailable)
+	uint32_t viewCount = 1;
+	for (const Attachment& attachment : attachments)
+		viewCount = std::max(viewCount, attachment.arrayLayers);
+
+	const uint32_t viewMask = (1u << viewCount) - 1;
+	VkRenderPassMultiviewCreateInfoKHR multiviewCreateInfo = {};
+	multiviewCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO_KHR;
+	multiviewCreateInfo.subpassCount = 1;
+	multiviewCreateInfo.pViewMasks = &viewMask;
+	multiviewCreateInfo.correlationMaskCount = 1;
+	multiviewCreateInfo.pCorrelationMasks = &viewMask; // views are rendered from close positions, allow concurrent rendering
+	if (viewCount > 1)
+		renderPassInfo.pNext = &multiviewCreateInfo;
+
 	VkRenderPass renderPassToReturn;
 	if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPassToReturn) != VK_SUCCESS)
 		throw std::runtime_error("Error : create render pass");
@@ -23,7 +23,7 @@ namespace Wolf
 		void initialize(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, Queue graphicsQueue, const std::vector<Attachment>& attachments,
 			std::vector<Wolf::Image*> images);
 
-		void beginRenderPass(size_t framebufferID, std::vector<VkClearValue>& clearValues, VkCommandBuffer commandBuffer);
+		void beginRenderPass(size_t framebufferID, std::vector<VkClearValue>& clearValues, VkCommandBuffer commandBuffer, VkExtent2D renderArea = { 0, 0 }); // 0 = whole framebuffer
 		void endRenderPass(VkCommandBuffer commandBuffer);
 
 		void resize(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, Queue graphicsQueue, const std::vector<Attachment>& attachments, std::vector<Wolf::Image*> images);
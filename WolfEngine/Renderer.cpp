@@ -1,45 +1,183 @@
 #include "Renderer.h"
 
 #include <utility>
+#include <algorithm>
 
 #include "Debug.h"
 
-Wolf::Renderer::Renderer(VkDevice device, RendererCreateInfo rendererCreateInfo)
+uint16_t Wolf::Renderer::s_pipelineSortCount = 0;
+
+Wolf::Renderer::Renderer(VkDevice device, VkPhysicalDevice physicalDevice, RendererCreateInfo rendererCreateInfo)
 {
 	m_device = device;
+	m_physicalDevice = physicalDevice;
+	m_autoInstancing = rendererCreateInfo.instanceTemplate == InstanceTemplate::TRANSFORM;
 	m_descriptorLayouts = rendererCreateInfo.descriptorSetLayout;
-	createDescriptorSetLayout(rendererCreateInfo.descriptorSetLayout);
+	m_descriptorSetLayout = createDescriptorSetLayout(m_device, rendererCreateInfo.descriptorSetLayout);
 
 	rendererCreateInfo.pipelineCreateInfo.descriptorSetLayouts = { m_descriptorSetLayout };
+	m_bindlessTextures = rendererCreateInfo.bindlessTextures;
+	if (m_bindlessTextures)
+		rendererCreateInfo.pipelineCreateInfo.descriptorSetLayouts.push_back(m_bindlessTextures->getDescriptorSetLayout());
 	m_renderingPipelineCreate = rendererCreateInfo.pipelineCreateInfo;
 	m_pipeline = std::make_unique<Pipeline>(m_device, rendererCreateInfo.pipelineCreateInfo);
+	m_pipelineSortID = s_pipelineSortCount++;
+
+	// Blended draws depend on submission order
+	for (bool alphaBlending : rendererCreateInfo.pipelineCreateInfo.alphaBlending)
+		if (alphaBlending)
+			m_sortDrawLists = false;
 }
 
 Wolf::Renderer::~Renderer()
 {
 	for (size_t i(0); i < m_meshes.size(); ++i)
 	{
-		if(m_meshes[i].descriptorSet != VK_NULL_HANDLE) 
-			vkFreeDescriptorSets(m_device, m_descriptorPool, 1, &m_meshes[i].descriptorSet);
+		if(m_meshes[i].descriptorSet != VK_NULL_HANDLE && m_descriptorPool) 
+			m_descriptorPool->freeDescriptorSet(m_meshes[i].descriptorSet);
+	}
+	releaseDescriptorSetLayout(m_descriptorSetLayout);
+
+	if (m_instanceTransformBuffer != VK_NULL_HANDLE)
+	{
+		vkUnmapMemory(m_device, m_instanceTransformBufferMemory);
+		vkDestroyBuffer(m_device, m_instanceTransformBuffer, nullptr);
+		vkFreeMemory(m_device, m_instanceTransformBufferMemory, nullptr);
 	}
-	vkDestroyDescriptorSetLayout(m_device, m_descriptorSetLayout, nullptr);
 
 	m_meshes.clear();
 }
 
-int Wolf::Renderer::addMesh(AddMeshInfo addMeshInfo)
+static bool sameDescriptors(const Wolf::DescriptorSetCreateInfo& a, const Wolf::DescriptorSetCreateInfo& b)
 {
-	m_meshes.emplace_back(addMeshInfo);
+	if (a.descriptorBuffers.size() != b.descriptorBuffers.size() || a.descriptorImages.size() != b.descriptorImages.size() || !a.descriptorDefault.empty() || !b.descriptorDefault.empty())
+		return false;
+
+	for (size_t i(0); i < a.descriptorBuffers.size(); ++i)
+	{
+		if (a.descriptorBuffers[i].second.binding != b.descriptorBuffers[i].second.binding || a.descriptorBuffers[i].first.size() != b.descriptorBuffers[i].first.size())
+			return false;
+		for (size_t j(0); j < a.descriptorBuffers[i].first.size(); ++j)
+			if (a.descriptorBuffers[i].first[j].buffer != b.descriptorBuffers[i].first[j].buffer || a.descriptorBuffers[i].first[j].size != b.descriptorBuffers[i].first[j].size)
+				return false;
+	}
+
+	for (size_t i(0); i < a.descriptorImages.size(); ++i)
+	{
+		if (a.descriptorImages[i].second.binding != b.descriptorImages[i].second.binding || a.descriptorImages[i].first.size() != b.descriptorImages[i].first.size())
+			return false;
+		for (size_t j(0); j < a.descriptorImages[i].first.size(); ++j)
+			if (a.descriptorImages[i].first[j].image != b.descriptorImages[i].first[j].image || a.descriptorImages[i].first[j].sampler != b.descriptorImages[i].first[j].sampler)
+				return false;
+	}
 
-	return static_cast<int>(m_meshes.size() - 1);
+	return true;
+}
+
+int Wolf::Renderer::addMesh(AddMeshInfo addMeshInfo, bool* outMerged)
+{
+	if (outMerged)
+		*outMerged = false;
+
+	// Push constant sizes are multiples of 4 bytes, payloads are padded with zeros
+	addMeshInfo.pushConstants.resize((addMeshInfo.pushConstants.size() + 3) & ~static_cast<size_t>(3), 0);
+
+	uint32_t pushConstantSize = 0;
+	for (const VkPushConstantRange& pushConstantRange : m_renderingPipelineCreate.pushConstantRanges)
+		pushConstantSize = std::max(pushConstantSize, pushConstantRange.offset + pushConstantRange.size);
+	if (addMeshInfo.pushConstants.size() > pushConstantSize)
+	{
+		Debug::sendError("Mesh push constants (" + std::to_string(addMeshInfo.pushConstants.size()) + " bytes) exceed the pipeline push constant ranges (" +
+			std::to_string(pushConstantSize) + " bytes)");
+		addMeshInfo.pushConstants.resize(pushConstantSize);
+	}
+
+	if (m_pipeline->useMeshShader() && addMeshInfo.meshTaskCount == 0)
+		Debug::sendError("Mesh added to a mesh shader renderer without task count, use AddMeshInfo::setMeshlets");
+
+	if (!m_autoInstancing)
+	{
+		m_meshes.emplace_back(addMeshInfo);
+		m_drawListsDirty = true;
+
+		return static_cast<int>(m_meshes.size() - 1);
+	}
+
+	// Same geometry, descriptors and pipeline -> new instance of an existing mesh
+	std::vector<int>& candidates = m_meshesByGeometry[std::make_tuple(addMeshInfo.frameBufferID, addMeshInfo.vertexBuffer.vertexBuffer, addMeshInfo.vertexBuffer.indexBuffer,
+		addMeshInfo.descriptorSet)];
+	int meshID = -1;
+	for (int candidate : candidates)
+	{
+		if (m_meshes[candidate].pushConstants != addMeshInfo.pushConstants)
+			continue;
+		if (addMeshInfo.descriptorSet != VK_NULL_HANDLE || sameDescriptors(m_meshes[candidate].descriptorSetCreateInfo, addMeshInfo.descriptorSetCreateInfo))
+		{
+			meshID = candidate;
+			break;
+		}
+	}
+
+	if (meshID < 0)
+	{
+		m_meshes.emplace_back(addMeshInfo);
+		m_instanceTransforms.emplace_back();
+		m_firstInstances.push_back(0);
+
+		meshID = static_cast<int>(m_meshes.size() - 1);
+		candidates.push_back(meshID);
+	}
+	else if (outMerged)
+		*outMerged = true;
+
+	m_instanceIDs.emplace_back(meshID, static_cast<uint32_t>(m_instanceTransforms[meshID].size()));
+	m_instanceTransforms[meshID].push_back(addMeshInfo.instanceTransform);
+	m_instanceLayoutDirty = true;
+	m_drawListsDirty = true;
+
+	return static_cast<int>(m_instanceIDs.size() - 1);
 }
 
 void Wolf::Renderer::updateVertexBuffer(int id, VertexBuffer& vertexBuffer)
 {
-	m_meshes[id].vertexBuffer = vertexBuffer;
+	const int meshID = getMeshID(id);
+	if (meshID < 0)
+		return;
+
+	if (m_autoInstancing)
+	{
+		// Moved to the candidates of its new geometry
+		AddMeshInfo& mesh = m_meshes[meshID];
+		std::vector<int>& oldCandidates = m_meshesByGeometry[std::make_tuple(mesh.frameBufferID, mesh.vertexBuffer.vertexBuffer, mesh.vertexBuffer.indexBuffer, mesh.descriptorSet)];
+		oldCandidates.erase(std::remove(oldCandidates.begin(), oldCandidates.end(), meshID), oldCandidates.end());
+		m_meshesByGeometry[std::make_tuple(mesh.frameBufferID, vertexBuffer.vertexBuffer, vertexBuffer.indexBuffer, mesh.descriptorSet)].push_back(meshID);
+	}
+
+	m_meshes[meshID].vertexBuffer = vertexBuffer;
+	m_drawListsDirty = true;
+}
+
+void Wolf::Renderer::updateDescriptorSet(int id, const DescriptorSetCreateInfo& descriptorSetCreateInfo)
+{
+	const int meshID = getMeshID(id);
+	if (meshID < 0)
+		return;
+
+	m_meshes[meshID].descriptorSetCreateInfo = descriptorSetCreateInfo;
+	if (m_meshes[meshID].descriptorSet != VK_NULL_HANDLE)
+		Wolf::updateDescriptorSet(m_device, m_meshes[meshID].descriptorSet, m_descriptorSetLayout, descriptorSetCreateInfo);
+}
+
+void Wolf::Renderer::updateInstanceTransform(int instanceID, const glm::mat4& transform)
+{
+	const std::pair<int, uint32_t>& instance = m_instanceIDs[instanceID];
+	m_instanceTransforms[instance.first][instance.second] = transform;
+
+	if (m_mappedInstanceTransforms && !m_instanceLayoutDirty)
+		m_mappedInstanceTransforms[m_firstInstances[instance.first] + instance.second] = transform;
 }
 
-void Wolf::Renderer::create(VkDescriptorPool descriptorPool)
+void Wolf::Renderer::create(DescriptorPool* descriptorPool)
 {
 	m_descriptorPool = descriptorPool;		
 
@@ -50,6 +188,11 @@ void Wolf::Renderer::create(VkDescriptorPool descriptorPool)
 			m_meshes[i].descriptorSet = createDescriptorSet(m_device, m_descriptorSetLayout, descriptorPool, m_meshes[i].descriptorSetCreateInfo);
 		}
 	}
+
+	if (m_autoInstancing)
+		createInstanceTransformBuffer();
+
+	m_drawListsDirty = true;
 }
 
 void Wolf::Renderer::setViewport(std::array<float, 2> viewportScale, std::array<float, 2> viewportOffset)
@@ -58,15 +201,29 @@ void Wolf::Renderer::setViewport(std::array<float, 2> viewportScale, std::array<
 	m_renderingPipelineCreate.viewportOffset = viewportOffset;
 }
 
-std::vector<std::tuple<Wolf::VertexBuffer, Wolf::InstanceBuffer, VkDescriptorSet>> Wolf::Renderer::getMeshes(int frambufferID)
+const Wolf::Renderer::DrawList& Wolf::Renderer::getDrawList(int framebufferID)
 {
-	std::vector<std::tuple<Wolf::VertexBuffer, Wolf::InstanceBuffer, VkDescriptorSet>> r;
-	for(size_t i(0); i < m_meshes.size(); ++i)
+	static const DrawList emptyDrawList;
+
+	if (m_drawListsDirty)
+		buildDrawLists();
+
+	if (framebufferID < 0 || framebufferID >= static_cast<int>(m_drawLists.size()))
+		return emptyDrawList;
+	return m_drawLists[framebufferID];
+}
+
+std::vector<Wolf::Renderer::AddMeshInfo> Wolf::Renderer::getMeshInfos() const
+{
+	if (!m_autoInstancing)
+		return m_meshes;
+
+	// One entry per instance so that adding them back gives the same instance IDs
+	std::vector<AddMeshInfo> r(m_instanceIDs.size());
+	for (size_t i(0); i < m_instanceIDs.size(); ++i)
 	{
-		if (m_meshes[i].frameBufferID == frambufferID)
-		{
-			r.push_back(std::make_tuple(m_meshes[i].vertexBuffer, m_meshes[i].instanceBuffer, m_meshes[i].descriptorSet));
-		}
+		r[i] = m_meshes[m_instanceIDs[i].first];
+		r[i].instanceTransform = m_instanceTransforms[m_instanceIDs[i].first][m_instanceIDs[i].second];
 	}
 
 	return r;
@@ -75,34 +232,136 @@ std::vector<std::tuple<Wolf::VertexBuffer, Wolf::InstanceBuffer, VkDescriptorSet
 Wolf::RendererCreateInfo Wolf::Renderer::getRendererCreateInfoStructure()
 {
 	RendererCreateInfo r;
+	r.instanceTemplate = m_autoInstancing ? InstanceTemplate::TRANSFORM : InstanceTemplate::NO;
 	r.descriptorSetLayout = m_descriptorLayouts;
 	r.pipelineCreateInfo = m_renderingPipelineCreate;
+	r.bindlessTextures = m_bindlessTextures;
 
 	return r;
 }
 
-void Wolf::Renderer::createDescriptorSetLayout(const std::vector<DescriptorLayout>& descriptorLayouts)
+void Wolf::Renderer::buildDrawLists()
 {
-	// Global bindings
-	std::vector<VkDescriptorSetLayoutBinding> bindings;
-	
-	for (auto descriptorLayout : descriptorLayouts)
+	// Handles are replaced by 16 bits ordinals so the key fits in 64 bits: pipeline | descriptor set | vertex buffer | index buffer
+	std::map<VkDescriptorSet, uint64_t> descriptorSetOrdinals;
+	std::map<VkBuffer, uint64_t> vertexBufferOrdinals;
+	std::map<VkBuffer, uint64_t> indexBufferOrdinals;
+
+	int framebufferCount = 0;
+	m_sortedMeshes.clear();
+	for (size_t i(0); i < m_meshes.size(); ++i)
 	{
-		VkDescriptorSetLayoutBinding descriptorSetLayoutBinding = {};
-		descriptorSetLayoutBinding.binding = descriptorLayout.binding;
-		descriptorSetLayoutBinding.descriptorType = descriptorLayout.descriptorType;
-		descriptorSetLayoutBinding.descriptorCount = descriptorLayout.count;
-		descriptorSetLayoutBinding.stageFlags = descriptorLayout.accessibility;
-		descriptorSetLayoutBinding.pImmutableSamplers = nullptr;
+		const uint64_t descriptorSetOrdinal = descriptorSetOrdinals.emplace(m_meshes[i].descriptorSet, descriptorSetOrdinals.size()).first->second;
+		const uint64_t vertexBufferOrdinal = vertexBufferOrdinals.emplace(m_meshes[i].vertexBuffer.vertexBuffer, vertexBufferOrdinals.size()).first->second;
+		const uint64_t indexBufferOrdinal = indexBufferOrdinals.emplace(m_meshes[i].vertexBuffer.indexBuffer, indexBufferOrdinals.size()).first->second;
+
+		const uint64_t sortKey = static_cast<uint64_t>(m_pipelineSortID) << 48 | (descriptorSetOrdinal & 0xFFFF) << 32 | (vertexBufferOrdinal & 0xFFFF) << 16 |
+			(indexBufferOrdinal & 0xFFFF);
 
-		bindings.push_back(descriptorSetLayoutBinding);
+		m_sortedMeshes.emplace_back(sortKey, static_cast<uint32_t>(i));
+		framebufferCount = std::max(framebufferCount, m_meshes[i].frameBufferID + 1);
 	}
 
-	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
-	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
-	layoutInfo.pBindings = bindings.data();
+	if (m_sortDrawLists)
+		std::stable_sort(m_sortedMeshes.begin(), m_sortedMeshes.end(),
+			[](const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b) { return a.first < b.first; });
+
+	// Buckets are cleared, not released, so rebuilding keeps their capacity
+	m_drawLists.resize(framebufferCount);
+	for (DrawList& drawList : m_drawLists)
+		drawList.clear();
+	for (const std::pair<uint64_t, uint32_t>& sortedMesh : m_sortedMeshes)
+	{
+		const AddMeshInfo& mesh = m_meshes[sortedMesh.second];
+		if (m_autoInstancing)
+			m_drawLists[mesh.frameBufferID].addDraw(mesh, { m_instanceTransformBuffer, static_cast<uint32_t>(m_instanceTransforms[sortedMesh.second].size()),
+				m_firstInstances[sortedMesh.second] });
+		else
+			m_drawLists[mesh.frameBufferID].addDraw(mesh, mesh.instanceBuffer);
+	}
+
+	m_drawListsDirty = false;
+}
+
+void Wolf::Renderer::DrawList::clear()
+{
+	vertexBuffers.clear();
+	indexBuffers.clear();
+	indexCounts.clear();
+	instanceBuffers.clear();
+	instanceCounts.clear();
+	firstInstances.clear();
+	descriptorSets.clear();
+	indirectBuffers.clear();
+	meshTaskCounts.clear();
+	pushConstantOffsets.clear();
+	pushConstantSizes.clear();
+	pushConstantData.clear();
+}
 
-	if (vkCreateDescriptorSetLayout(m_device, &layoutInfo, nullptr, &m_descriptorSetLayout) != VK_SUCCESS)
-		Debug::sendError("Error : create descriptor set layout");
+void Wolf::Renderer::createInstanceTransformBuffer()
+{
+	uint32_t instanceCount = 0;
+	for (size_t i(0); i < m_instanceTransforms.size(); ++i)
+	{
+		m_firstInstances[i] = instanceCount;
+		instanceCount += static_cast<uint32_t>(m_instanceTransforms[i].size());
+	}
+
+	if (instanceCount > m_instanceTransformCapacity)
+	{
+		if (m_instanceTransformBuffer != VK_NULL_HANDLE)
+		{
+			vkUnmapMemory(m_device, m_instanceTransformBufferMemory);
+			vkDestroyBuffer(m_device, m_instanceTransformBuffer, nullptr);
+			vkFreeMemory(m_device, m_instanceTransformBufferMemory, nullptr);
+		}
+
+		m_instanceTransformCapacity = std::max(instanceCount, 2 * m_instanceTransformCapacity);
+		const VkDeviceSize bufferSize = sizeof(glm::mat4) * m_instanceTransformCapacity;
+
+		// Host visible so that transforms can be updated without re-recording
+		createBuffer(m_device, m_physicalDevice, bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			m_instanceTransformBuffer, m_instanceTransformBufferMemory);
+		vkMapMemory(m_device, m_instanceTransformBufferMemory, 0, bufferSize, 0, reinterpret_cast<void**>(&m_mappedInstanceTransforms));
+	}
+
+	for (size_t i(0); i < m_instanceTransforms.size(); ++i)
+		if (!m_instanceTransforms[i].empty())
+			memcpy(m_mappedInstanceTransforms + m_firstInstances[i], m_instanceTransforms[i].data(), sizeof(glm::mat4) * m_instanceTransforms[i].size());
+
+	m_instanceLayoutDirty = false;
+}
+
+void Wolf::Renderer::DrawList::addDraw(const AddMeshInfo& mesh, const InstanceBuffer& instanceBuffer)
+{
+	const bool isInstancied = instanceBuffer.nInstances > 0 && instanceBuffer.instanceBuffer;
+
+	vertexBuffers.push_back(mesh.vertexBuffer.vertexBuffer);
+	indexBuffers.push_back(mesh.vertexBuffer.indexBuffer);
+	indexCounts.push_back(mesh.vertexBuffer.nbIndices);
+	instanceBuffers.push_back(isInstancied ? instanceBuffer.instanceBuffer : VK_NULL_HANDLE);
+	instanceCounts.push_back(isInstancied ? instanceBuffer.nInstances : 1);
+	firstInstances.push_back(isInstancied ? instanceBuffer.firstInstance : 0);
+	descriptorSets.push_back(mesh.descriptorSet);
+	indirectBuffers.push_back(mesh.indirectBuffer);
+	meshTaskCounts.push_back(mesh.meshTaskCount);
+	pushConstantOffsets.push_back(static_cast<uint32_t>(pushConstantData.size()));
+	pushConstantSizes.push_back(static_cast<uint32_t>(mesh.pushConstants.size()));
+	pushConstantData.insert(pushConstantData.end(), mesh.pushConstants.begin(), mesh.pushConstants.end());
+}
+
+int Wolf::Renderer::getMeshID(int id) const
+{
+	if (!m_autoInstancing)
+		return id;
+
+	// Instance ID -> mesh, a merged mesh is shared by every instance and can't be changed for one of them
+	const int meshID = m_instanceIDs[id].first;
+	if (m_instanceTransforms[meshID].size() > 1)
+	{
+		Debug::sendError("Instance " + std::to_string(id) + " is merged with other instances, its vertex buffer and descriptor set can't be updated alone");
+		return -1;
+	}
+	return meshID;
 }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <utility>
+#include <map>
+#include <cstring>
 
 #include "DescriptorSet.h"
 #include "VulkanHelper.h"
@@ -11,9 +13,18 @@
 #include "InstanceTemplate.h"
 #include "Pipeline.h"
 #include "Mesh.h"
+#include "BindlessTextures.h"
 
 namespace Wolf
 {
+	struct IndirectBuffer
+	{
+		VkBuffer drawCommandBuffer = VK_NULL_HANDLE; // VkDrawIndexedIndirectCommand array
+		VkBuffer countBuffer = VK_NULL_HANDLE; // optional, requires VK_KHR_draw_indirect_count
+		uint32_t maxDrawCount = 0;
+		VkDeviceSize offset = 0; // of the first command in drawCommandBuffer
+	};
+
 	struct RendererCreateInfo
 	{
 		int renderPassID;
@@ -28,12 +39,15 @@ namespace Wolf
 
 		// Descriptor set layout
 		std::vector<DescriptorLayout> descriptorSetLayout;
+
+		// Texture table bound at set BINDLESS_DESCRIPTOR_SET, meshes only bind their own set 0
+		BindlessTextures* bindlessTextures = nullptr;
 	};
 	
 	class Renderer
 	{
 	public:
-		Renderer(VkDevice device, RendererCreateInfo rendererCreateInfo);
+		Renderer(VkDevice device, VkPhysicalDevice physicalDevice, RendererCreateInfo rendererCreateInfo);
 		~Renderer();
 
 		struct AddMeshInfo
@@ -47,35 +61,82 @@ namespace Wolf
 			VertexBuffer vertexBuffer;
 			InstanceBuffer instanceBuffer;
 
+			// Only used by renderers created with InstanceTemplate::TRANSFORM, identical meshes are merged in one instanced draw
+			glm::mat4 instanceTransform = glm::mat4(1.0f);
+
+			// GPU-driven draws, vertex and index buffers must contain every object referenced by the commands
+			IndirectBuffer indirectBuffer;
+
+			// Mesh shader pipelines, number of task workgroups: set from the meshlet count by setMeshlets, required by mesh shader renderers
+			uint32_t meshTaskCount = 0;
+			void setMeshlets(const MeshletBuffers& meshletBuffers) { meshTaskCount = getMeshletTaskCount(meshletBuffers.meshletCount); }
+
 			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
 
 			DescriptorSetCreateInfo descriptorSetCreateInfo;
 
+			// Per-draw data pushed at offset 0 (ex: model matrix, material ID), meshes can then share a descriptor set.
+			// Only the bytes covered by RenderingPipelineCreateInfo::pushConstantRanges are pushed (nothing without ranges), padded to a multiple of 4 bytes
+			std::vector<uint8_t> pushConstants;
+			template<typename T>
+			void setPushConstants(const T& data)
+			{
+				pushConstants.resize(sizeof(T));
+				memcpy(pushConstants.data(), &data, sizeof(T));
+			}
+
 			bool needDescriptorSet() const
 			{
 				return !descriptorSetCreateInfo.descriptorBuffers.empty() || !descriptorSetCreateInfo.descriptorImages.empty();
 			}
 		};
-		int addMesh(AddMeshInfo addMeshInfo);
+		int addMesh(AddMeshInfo addMeshInfo, bool* outMerged = nullptr);
 
+		// id: returned by addMesh (instance ID with auto instancing, rejected if the instance was merged)
 		void updateVertexBuffer(int id, VertexBuffer& vertexBuffer);
+		void updateDescriptorSet(int id, const DescriptorSetCreateInfo& descriptorSetCreateInfo); // the set must not be used by pending command buffers
+		void updateInstanceTransform(int instanceID, const glm::mat4& transform);
 
-		void create(VkDescriptorPool descriptorPool);
+		void create(DescriptorPool* descriptorPool);
 
 		void setViewport(std::array<float, 2> viewportScale, std::array<float, 2> viewportOffset);	
 
+		// Recording data only, kept apart from creation info (AddMeshInfo)
+		struct DrawList
+		{
+			std::vector<VkBuffer> vertexBuffers;
+			std::vector<VkBuffer> indexBuffers;
+			std::vector<uint32_t> indexCounts;
+			std::vector<VkBuffer> instanceBuffers; // VK_NULL_HANDLE when not instanced
+			std::vector<uint32_t> instanceCounts;
+			std::vector<uint32_t> firstInstances;
+			std::vector<VkDescriptorSet> descriptorSets;
+			std::vector<IndirectBuffer> indirectBuffers;
+			std::vector<uint32_t> meshTaskCounts;
+			std::vector<uint32_t> pushConstantOffsets; // in pushConstantData
+			std::vector<uint32_t> pushConstantSizes; // 0 = nothing pushed
+			std::vector<uint8_t> pushConstantData;
+
+			size_t size() const { return vertexBuffers.size(); }
+			void clear();
+			void addDraw(const AddMeshInfo& mesh, const InstanceBuffer& instanceBuffer);
+		};
+
 		VkPipeline getPipeline() { return m_pipeline->getPipeline(); }
-		std::vector<std::tuple<VertexBuffer, InstanceBuffer, VkDescriptorSet>> getMeshes(int framebufferID = 0);
-		std::vector<AddMeshInfo> getMeshInfos() const { return m_meshes; }
+		const DrawList& getDrawList(int framebufferID = 0);
+		std::vector<AddMeshInfo> getMeshInfos() const;
 		VkPipelineLayout getPipelineLayout() const { return m_pipeline->getPipelineLayout(); }
 		RendererCreateInfo getRendererCreateInfoStructure();
+		const RenderingPipelineCreateInfo& getPipelineCreateInfo() const { return m_renderingPipelineCreate; }
 		bool useMeshShader() const { return m_pipeline->useMeshShader(); }
+		VkDescriptorSet getBindlessDescriptorSet() const { return m_bindlessTextures ? m_bindlessTextures->getDescriptorSet() : VK_NULL_HANDLE; }
 
 		//void setPipelineCreated(bool status) { m_pipelineCreated = status; }
 
 	private:
 		VkDevice m_device;
-		VkDescriptorPool m_descriptorPool;
+		VkPhysicalDevice m_physicalDevice;
+		DescriptorPool* m_descriptorPool = nullptr;
 		
 		// Information for pipeline
 		RenderingPipelineCreateInfo m_renderingPipelineCreate;
@@ -83,15 +144,38 @@ namespace Wolf
 		// Descriptor set layout
 		std::vector<DescriptorLayout> m_descriptorLayouts;
 		VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+		BindlessTextures* m_bindlessTextures = nullptr;
 
 		// Meshes
 		std::vector<AddMeshInfo> m_meshes;
 
+		// Automatic instancing
+		bool m_autoInstancing = false;
+		std::map<std::tuple<int, VkBuffer, VkBuffer, VkDescriptorSet>, std::vector<int>> m_meshesByGeometry;
+		std::vector<std::vector<glm::mat4>> m_instanceTransforms; // per mesh
+		std::vector<uint32_t> m_firstInstances; // per mesh
+		std::vector<std::pair<int, uint32_t>> m_instanceIDs; // mesh, index in mesh
+		VkBuffer m_instanceTransformBuffer = VK_NULL_HANDLE;
+		VkDeviceMemory m_instanceTransformBufferMemory = VK_NULL_HANDLE;
+		glm::mat4* m_mappedInstanceTransforms = nullptr;
+		uint32_t m_instanceTransformCapacity = 0;
+		bool m_instanceLayoutDirty = false; // instances added since last create
+
+		// Draw lists, one per framebuffer, sorted by state key
+		std::vector<DrawList> m_drawLists;
+		std::vector<std::pair<uint64_t, uint32_t>> m_sortedMeshes;
+		bool m_drawListsDirty = true;
+		bool m_sortDrawLists = true;
+		uint16_t m_pipelineSortID;
+		static uint16_t s_pipelineSortCount;
+
 		// Pipeline
 		std::unique_ptr<Pipeline> m_pipeline = nullptr;
 
 	private:
-		void createDescriptorSetLayout(const std::vector<DescriptorLayout>& descriptorLayouts);
+		void buildDrawLists();
+		void createInstanceTransformBuffer();
+		int getMeshID(int id) const; // -1 if the mesh can't be changed alone
 	};
 
 }
@@ -2,8 +2,13 @@
 #include <random>
 
 Wolf::SSAO::SSAO(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, int commandBufferID, VkExtent2D extent,
-	glm::mat4 projection, Image* depth, Image* normal, float near, float far)
+	glm::mat4 projection, Image* depth, Image* normal, float near, float far, uint32_t resolutionDivisor, bool temporalAccumulation,
+	UniformBuffer* renderScaleData)
 {
+	m_resolutionDivisor = glm::max(resolutionDivisor, 1u);
+	m_temporalAccumulation = temporalAccumulation;
+	const bool lowResMode = m_resolutionDivisor > 1 || m_temporalAccumulation;
+
 	// Data
 	const std::uniform_real_distribution<float> randomFloats(0.0, 1.0); // random floats between 0.0 - 1.0
 	std::random_device rd;
@@ -40,9 +45,113 @@ Wolf::SSAO::SSAO(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, int com
 	m_uboData.invProjection = glm::inverse(projection);
 	m_uboData.projParams.x = far / (far - near);
 	m_uboData.projParams.y = (-far * near) / (far - near);
+	m_uboData.reprojection = projection;
+	m_uboData.frameParams = glm::vec4(1.0f, 0.0f, 0.0f, static_cast<float>(m_resolutionDivisor));
 
 	m_uniformBuffer = engineInstance->createUniformBufferObject(&m_uboData, sizeof(UBOData));
 
+	if (lowResMode)
+	{
+		const VkExtent2D lowResExtent = { (engineInstance->getWindowSize().width + m_resolutionDivisor - 1) / m_resolutionDivisor,
+			(engineInstance->getWindowSize().height + m_resolutionDivisor - 1) / m_resolutionDivisor };
+
+		auto createStorageImage = [&](VkExtent2D imageExtent, VkFormat format, VkImageUsageFlags usage)
+		{
+			Image::CreateImageInfo createImageInfo;
+			createImageInfo.extent = { imageExtent.width, imageExtent.height, 1 };
+			createImageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | usage;
+			createImageInfo.format = format;
+			createImageInfo.sampleCount = VK_SAMPLE_COUNT_1_BIT;
+			createImageInfo.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+			createImageInfo.mipLevels = 1;
+			Image* image = engineInstance->createImage(createImageInfo);
+			image->setImageLayout(VK_IMAGE_LAYOUT_GENERAL, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+			return image;
+		};
+		m_outputImage = createStorageImage(lowResExtent, VK_FORMAT_R8_UNORM, 0);
+		m_lowResDepthImage = createStorageImage(lowResExtent, VK_FORMAT_R16_SFLOAT, 0);
+		// Accumulation needs more precision than the output
+		m_accumulatedImage = createStorageImage(lowResExtent, VK_FORMAT_R16_UNORM, VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+		m_historyImage = createStorageImage(lowResExtent, VK_FORMAT_R16_UNORM, VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+		m_upsampledImage = createStorageImage(engineInstance->getWindowSize(), VK_FORMAT_R8_UNORM, 0);
+
+		// AO at low resolution
+		Scene::ComputePassCreateInfo computePassCreateInfo;
+		computePassCreateInfo.name = "SSAO low resolution";
+		computePassCreateInfo.extent = lowResExtent;
+		computePassCreateInfo.dispatchGroups = { 16, 16, 1 };
+		computePassCreateInfo.computeShaderPath = "Shaders/SSAO/lowRes.spv";
+		computePassCreateInfo.commandBufferID = commandBufferID;
+		computePassCreateInfo.afterRecord = computeBarrier;
+		computePassCreateInfo.dynamicResolution = renderScaleData != nullptr;
+
+		DescriptorSetGenerator descriptorSetGenerator;
+		descriptorSetGenerator.addImages({ depth }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0);
+		descriptorSetGenerator.addImages({ normal }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1);
+		descriptorSetGenerator.addImages({ m_outputImage }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 2);
+		descriptorSetGenerator.addUniformBuffer(m_uniformBuffer, VK_SHADER_STAGE_COMPUTE_BIT, 3);
+		descriptorSetGenerator.addImages({ m_lowResDepthImage }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 4);
+		if (renderScaleData)
+			descriptorSetGenerator.addUniformBuffer(renderScaleData, VK_SHADER_STAGE_COMPUTE_BIT, 5);
+
+		computePassCreateInfo.descriptorSetCreateInfo = descriptorSetGenerator.getDescritorSetCreateInfo();
+
+		m_computePassID = scene->addComputePass(computePassCreateInfo);
+
+		// Temporal accumulation, the result is copied to the history for next frame
+		{
+			Scene::ComputePassCreateInfo temporalComputePassCreateInfo;
+			temporalComputePassCreateInfo.name = "SSAO temporal accumulation";
+			temporalComputePassCreateInfo.extent = lowResExtent;
+			temporalComputePassCreateInfo.dispatchGroups = { 16, 16, 1 };
+			temporalComputePassCreateInfo.computeShaderPath = "Shaders/SSAO/temporal.spv";
+			temporalComputePassCreateInfo.commandBufferID = commandBufferID;
+			temporalComputePassCreateInfo.afterRecord = copyToHistory;
+			temporalComputePassCreateInfo.dataForAfterRecordCallback = this;
+			temporalComputePassCreateInfo.dynamicResolution = renderScaleData != nullptr;
+
+			DescriptorSetGenerator temporalDescriptorSetGenerator;
+			temporalDescriptorSetGenerator.addImages({ m_outputImage }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0);
+			temporalDescriptorSetGenerator.addImages({ m_lowResDepthImage }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1);
+			temporalDescriptorSetGenerator.addImages({ m_historyImage }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 2);
+			temporalDescriptorSetGenerator.addImages({ m_accumulatedImage }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 3);
+			temporalDescriptorSetGenerator.addUniformBuffer(m_uniformBuffer, VK_SHADER_STAGE_COMPUTE_BIT, 4);
+			if (renderScaleData)
+				temporalDescriptorSetGenerator.addUniformBuffer(renderScaleData, VK_SHADER_STAGE_COMPUTE_BIT, 5);
+
+			temporalComputePassCreateInfo.descriptorSetCreateInfo = temporalDescriptorSetGenerator.getDescritorSetCreateInfo();
+
+			m_temporalComputePassID = scene->addComputePass(temporalComputePassCreateInfo);
+		}
+
+		// Depth aware upsample
+		{
+			Scene::ComputePassCreateInfo upsampleComputePassCreateInfo;
+			upsampleComputePassCreateInfo.name = "SSAO bilateral upsample";
+			upsampleComputePassCreateInfo.extent = engineInstance->getWindowSize();
+			upsampleComputePassCreateInfo.dispatchGroups = { 16, 16, 1 };
+			upsampleComputePassCreateInfo.computeShaderPath = "Shaders/SSAO/bilateralUpsample.spv";
+			upsampleComputePassCreateInfo.commandBufferID = commandBufferID;
+			upsampleComputePassCreateInfo.dynamicResolution = renderScaleData != nullptr;
+
+			DescriptorSetGenerator upsampleDescriptorSetGenerator;
+			upsampleDescriptorSetGenerator.addImages({ m_accumulatedImage }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0);
+			upsampleDescriptorSetGenerator.addImages({ m_lowResDepthImage }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1);
+			upsampleDescriptorSetGenerator.addImages({ depth }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 2);
+			upsampleDescriptorSetGenerator.addImages({ m_upsampledImage }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 3);
+			upsampleDescriptorSetGenerator.addUniformBuffer(m_uniformBuffer, VK_SHADER_STAGE_COMPUTE_BIT, 4);
+			if (renderScaleData)
+				upsampleDescriptorSetGenerator.addUniformBuffer(renderScaleData, VK_SHADER_STAGE_COMPUTE_BIT, 5);
+
+			upsampleComputePassCreateInfo.descriptorSetCreateInfo = upsampleDescriptorSetGenerator.getDescritorSetCreateInfo();
+
+			m_upsampleComputePassID = scene->addComputePass(upsampleComputePassCreateInfo);
+		}
+
+		return;
+	}
+
 	Image::CreateImageInfo createImageInfo;
 	createImageInfo.extent = { engineInstance->getWindowSize().width, engineInstance->getWindowSize().height, 1 };
 	createImageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT;
@@ -58,12 +167,15 @@ Wolf::SSAO::SSAO(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, int com
 	computePassCreateInfo.dispatchGroups = { 16, 16, 1 };
 	computePassCreateInfo.computeShaderPath = "Shaders/SSAO/comp.spv";
 	computePassCreateInfo.commandBufferID = commandBufferID;
+	computePassCreateInfo.dynamicResolution = renderScaleData != nullptr;
 
 	DescriptorSetGenerator descriptorSetGenerator;
 	descriptorSetGenerator.addImages({ depth }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0);
 	descriptorSetGenerator.addImages({ normal }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 1);
 	descriptorSetGenerator.addImages({ m_outputImage }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 2);
 	descriptorSetGenerator.addUniformBuffer(m_uniformBuffer, VK_SHADER_STAGE_COMPUTE_BIT, 3);
+	if (renderScaleData)
+		descriptorSetGenerator.addUniformBuffer(renderScaleData, VK_SHADER_STAGE_COMPUTE_BIT, 5);
 
 	computePassCreateInfo.descriptorSetCreateInfo = descriptorSetGenerator.getDescritorSetCreateInfo();
 	
@@ -71,3 +183,52 @@ Wolf::SSAO::SSAO(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, int com
 
 	m_blur = std::make_unique<Blur>(engineInstance, scene, commandBufferID, m_outputImage, nullptr);
 }
+
+void Wolf::SSAO::update(glm::mat4 view)
+{
+	if (!m_temporalAccumulation && m_resolutionDivisor == 1)
+		return;
+
+	// Kernel rotated by the golden angle every frame, the temporal pass integrates the rotations
+	const float angle = static_cast<float>(m_frameIndex) * 2.39996323f;
+	m_uboData.reprojection = m_uboData.projection * m_previousView * glm::inverse(view);
+	m_uboData.frameParams = glm::vec4(glm::cos(angle), glm::sin(angle), m_temporalAccumulation && m_frameIndex > 0 ? 0.9f : 0.0f,
+		static_cast<float>(m_resolutionDivisor));
+	m_uniformBuffer->updateData(&m_uboData);
+
+	m_previousView = view;
+	m_frameIndex++;
+}
+
+void Wolf::SSAO::computeBarrier(void* data, VkCommandBuffer commandBuffer)
+{
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void Wolf::SSAO::copyToHistory(void* data, VkCommandBuffer commandBuffer)
+{
+	SSAO* ssao = static_cast<SSAO*>(data);
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier,
+		0, nullptr, 0, nullptr);
+
+	VkImageCopy region = {};
+	region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.extent = ssao->m_accumulatedImage->getExtent();
+	vkCmdCopyImage(commandBuffer, ssao->m_accumulatedImage->getImage(), VK_IMAGE_LAYOUT_GENERAL, ssao->m_historyImage->getImage(), VK_IMAGE_LAYOUT_GENERAL, 1, &region);
+
+	// History is read by the temporal pass of next frame
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
@@ -8,13 +8,27 @@ namespace Wolf
 	class SSAO
 	{
 	public:
+		// resolutionDivisor > 1 or temporalAccumulation: AO is computed at 1/resolutionDivisor with a kernel rotated every frame, accumulated with the
+		// reprojected history and upsampled to full resolution with depth weights (R8 output, R16 history) instead of being blurred.
+		// renderScaleData: passes follow the scene render scale, the buffer is bound last (binding 5)
 		SSAO(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, int commandBufferID, VkExtent2D extent, glm::mat4 projection,
-			Image* depth, Image* normal, float near, float far);
+			Image* depth, Image* normal, float near, float far, uint32_t resolutionDivisor = 1, bool temporalAccumulation = false, UniformBuffer* renderScaleData = nullptr);
 
-		Image* getOutputImage() { return m_blur->getOutputImage(); }
+		// Needed for temporal reprojection
+		void update(glm::mat4 view);
+		void resetAccumulation() { m_frameIndex = 0; } // ex: render scale changed
 
-		std::vector<int> getCommandBufferIDs() { return m_blur->getCommandBufferIDs(); }
-		std::vector<std::pair<int, int>> getCommandBufferSynchronisation() { return m_blur->getCommandBufferSynchronisation(); }
+		Image* getOutputImage() { return m_blur ? m_blur->getOutputImage() : m_upsampledImage; }
+
+		std::vector<int> getCommandBufferIDs() { return m_blur ? m_blur->getCommandBufferIDs() : std::vector<int>(); }
+		std::vector<std::pair<int, int>> getCommandBufferSynchronisation()
+		{
+			return m_blur ? m_blur->getCommandBufferSynchronisation() : std::vector<std::pair<int, int>>();
+		}
+
+	private:
+		static void computeBarrier(void* data, VkCommandBuffer commandBuffer);
+		static void copyToHistory(void* data, VkCommandBuffer commandBuffer);
 
 	private:
 		int m_computePassID;
@@ -28,10 +42,26 @@ namespace Wolf
 			glm::vec4 power = glm::vec4(6.0f);
 			std::array<glm::vec4, 16> samples;
 			std::array<glm::vec4, 16> noise;
+
+			glm::mat4 reprojection; // current view space -> previous clip space
+			glm::vec4 frameParams; // kernel rotation cos, sin, history weight (0 resets), resolution divisor
 		};
 		UBOData m_uboData;
 		UniformBuffer* m_uniformBuffer;
 
 		std::unique_ptr<Blur> m_blur;
+
+		/* Low resolution and temporal mode */
+		uint32_t m_resolutionDivisor = 1;
+		bool m_temporalAccumulation = false;
+		uint32_t m_frameIndex = 0;
+		glm::mat4 m_previousView = glm::mat4(1.0f);
+
+		Image* m_lowResDepthImage = nullptr; // linear depth of the AO samples, for the upsample weights
+		Image* m_accumulatedImage = nullptr;
+		Image* m_historyImage = nullptr;
+		Image* m_upsampledImage = nullptr;
+		int m_temporalComputePassID = -1;
+		int m_upsampleComputePassID = -1;
 	};
 }
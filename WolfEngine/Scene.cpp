@@ -1,6 +1,7 @@
 #include "Scene.h"
 
 #include <utility>
+#include <algorithm>
 #include "InputVertexTemplate.h"
 #include "Debug.h"
 
@@ -10,6 +11,7 @@ Wolf::Scene::Scene(SceneCreateInfo createInfo, VkDevice device, VkPhysicalDevice
 	m_physicalDevice = physicalDevice;
 	m_swapChainImages = std::move(swapChainImages);
 	m_swapChainCommandType = createInfo.swapChainCommandType;
+	m_enableGPUTimings = createInfo.enableGPUTimings;
 
 	m_graphicsCommandPool = graphicsCommandPool;
 	m_computeCommandPool = computeCommandPool;
@@ -25,12 +27,19 @@ Wolf::Scene::Scene(SceneCreateInfo createInfo, VkDevice device, VkPhysicalDevice
 	m_physicalDevice = physicalDevice;
 	m_swapChainImages = std::move(ovrSwapChainImages);
 	m_swapChainCommandType = createInfo.swapChainCommandType;
+	m_enableGPUTimings = createInfo.enableGPUTimings;
 
 	m_graphicsCommandPool = graphicsCommandPool;
 	m_computeCommandPool = computeCommandPool;
 	m_windowSwapChainImages = std::move(windowSwapChainImages);
 }
 
+Wolf::Scene::~Scene()
+{
+	if (m_timestampQueryPool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(m_device, m_timestampQueryPool, nullptr);
+}
+
 int Wolf::Scene::addRenderPass(Wolf::Scene::RenderPassCreateInfo createInfo, int forceID)
 {
 	if(createInfo.outputIsSwapChain)
@@ -85,6 +94,9 @@ int Wolf::Scene::addRenderPass(Wolf::Scene::RenderPassCreateInfo createInfo, int
 		sceneRenderPass.renderPass = std::make_unique<RenderPass>(m_device,
 			m_physicalDevice, m_graphicsCommandPool, m_graphicsQueue, attachments, std::vector<VkExtent2D>(createInfo.framebufferCount, createInfo.extent));
 
+	sceneRenderPass.extent = createInfo.extent;
+	sceneRenderPass.dynamicResolution = createInfo.dynamicResolution && !createInfo.outputIsSwapChain;
+
 	sceneRenderPass.beforeRecord = createInfo.beforeRecord;
 	sceneRenderPass.dataForBeforeRecordCallback = createInfo.dataForBeforeRecordCallback;
 	sceneRenderPass.afterRecord = createInfo.afterRecord;
@@ -101,7 +113,7 @@ int Wolf::Scene::addComputePass(ComputePassCreateInfo createInfo)
 	{
 		m_sceneComputePasses.back().computePasses.resize(1);
 		m_sceneComputePasses.back().computePasses[0] = std::make_unique<ComputePass>(m_device, m_physicalDevice, m_computeCommandPool, createInfo.computeShaderPath, 
-			createInfo.descriptorSetCreateInfo);
+			createInfo.descriptorSetCreateInfo, createInfo.specializationConstants);
 
 		updateDescriptorPool(createInfo.descriptorSetCreateInfo);
 	}
@@ -131,7 +143,7 @@ int Wolf::Scene::addComputePass(ComputePassCreateInfo createInfo)
 			tempDescriptorSetCreateInfo.descriptorImages = images;
 
 			m_sceneComputePasses.back().computePasses[i] = std::make_unique<ComputePass>(m_device, m_physicalDevice, m_computeCommandPool, createInfo.computeShaderPath,
-				tempDescriptorSetCreateInfo);
+				tempDescriptorSetCreateInfo, createInfo.specializationConstants);
 			
 			updateDescriptorPool(createInfo.descriptorSetCreateInfo);
 		}
@@ -141,6 +153,7 @@ int Wolf::Scene::addComputePass(ComputePassCreateInfo createInfo)
 	
 	m_sceneComputePasses.back().extent = createInfo.extent;
 	m_sceneComputePasses.back().dispatchGroups = createInfo.dispatchGroups;
+	m_sceneComputePasses.back().dynamicResolution = createInfo.dynamicResolution && !createInfo.outputIsSwapChain;
 
 	m_sceneComputePasses.back().beforeRecord = createInfo.beforeRecord;
 	m_sceneComputePasses.back().dataForBeforeRecordCallback = createInfo.dataForBeforeRecordCallback;
@@ -250,6 +263,10 @@ int Wolf::Scene::addRenderer(RendererCreateInfo createInfo)
 	}
 #endif
 
+	// Viewport follows the render scale
+	if (m_sceneRenderPasses[createInfo.renderPassID].dynamicResolution)
+		createInfo.pipelineCreateInfo.dynamicViewport = true;
+
 	// Set input attribute and binding descriptions from template
 	{
 		std::vector<VkVertexInputBindingDescription> vertexInputBindingDescriptionsToAdd;
@@ -286,17 +303,35 @@ int Wolf::Scene::addRenderer(RendererCreateInfo createInfo)
 			createInfo.pipelineCreateInfo.vertexInputAttributeDescriptions.push_back(vertexInputAttributeDescription);
 	}
 
-	switch (createInfo.instanceTemplate)
+	// Instance binding may already be there when the renderer is rebuilt from its own create info (resize)
+	bool instanceBindingPresent = false;
+	for (VkVertexInputBindingDescription& inputBindingDescription : createInfo.pipelineCreateInfo.vertexInputBindingDescriptions)
+		if (inputBindingDescription.binding == 1)
+			instanceBindingPresent = true;
+
+	if (!instanceBindingPresent)
 	{
-	case InstanceTemplate::SINGLE_ID:
-		std::vector<VkVertexInputAttributeDescription> inputAttributeDescriptions = InstanceSingleID::getAttributeDescriptions(1, 2);
-		std::vector<VkVertexInputBindingDescription> inputBindingDescriptions = { InstanceSingleID::getBindingDescription(1) };
+		std::vector<VkVertexInputAttributeDescription> inputAttributeDescriptions;
+		std::vector<VkVertexInputBindingDescription> inputBindingDescriptions;
+
+		switch (createInfo.instanceTemplate)
+		{
+		case InstanceTemplate::SINGLE_ID:
+			inputAttributeDescriptions = InstanceSingleID::getAttributeDescriptions(1, 2);
+			inputBindingDescriptions = { InstanceSingleID::getBindingDescription(1) };
+			break;
+		case InstanceTemplate::TRANSFORM:
+			inputAttributeDescriptions = InstanceTransform::getAttributeDescriptions(1, static_cast<uint32_t>(createInfo.pipelineCreateInfo.vertexInputAttributeDescriptions.size()));
+			inputBindingDescriptions = { InstanceTransform::getBindingDescription(1) };
+			break;
+		case InstanceTemplate::NO:
+			break;
+		}
 
 		for (VkVertexInputAttributeDescription& inputAttributeDescription : inputAttributeDescriptions)
 			createInfo.pipelineCreateInfo.vertexInputAttributeDescriptions.push_back(inputAttributeDescription);
 		for (VkVertexInputBindingDescription& inputBindingDescription : inputBindingDescriptions)
 			createInfo.pipelineCreateInfo.vertexInputBindingDescriptions.push_back(inputBindingDescription);
-		break;
 	}
 
 	if (createInfo.pipelineCreateInfo.extent.width == 0)
@@ -304,7 +339,7 @@ int Wolf::Scene::addRenderer(RendererCreateInfo createInfo)
 
 	createInfo.pipelineCreateInfo.renderPass = m_sceneRenderPasses[createInfo.renderPassID].renderPass->getRenderPass();
 
-	auto* const r = new Renderer(m_device, createInfo);
+	auto* const r = new Renderer(m_device, m_physicalDevice, createInfo);
 	
 	if(createInfo.forceRendererID < 0)
 		m_sceneRenderPasses[createInfo.renderPassID].renderers.push_back(std::unique_ptr<Renderer>(r));
@@ -320,28 +355,82 @@ int Wolf::Scene::addRenderer(RendererCreateInfo createInfo)
 	return static_cast<int>(m_sceneRenderPasses[createInfo.renderPassID].renderers.size() - 1);
 }
 
-void Wolf::Scene::addMesh(Renderer::AddMeshInfo addMeshInfo)
+int Wolf::Scene::addMesh(Renderer::AddMeshInfo addMeshInfo)
 {
-	updateDescriptorPool(addMeshInfo.descriptorSetCreateInfo);
+	bool merged;
+	const int meshID = m_sceneRenderPasses[addMeshInfo.renderPassID].renderers[addMeshInfo.rendererID]->addMesh(addMeshInfo, &merged);
+
+	// Merged instances share the descriptor set of the first one
+	if (!merged)
+		updateDescriptorPool(addMeshInfo.descriptorSetCreateInfo);
 
-	m_sceneRenderPasses[addMeshInfo.renderPassID].renderers[addMeshInfo.rendererID]->addMesh(addMeshInfo);
+	return meshID;
 }
 
 void Wolf::Scene::updateVertexBuffer(int renderPassID, int rendererID, int meshID, VertexBuffer& vertexBuffer)
 {
 	m_sceneRenderPasses[renderPassID].renderers[rendererID]->updateVertexBuffer(meshID, vertexBuffer);
+	if (m_sceneRenderPasses[renderPassID].commandBufferID == -1)
+		m_swapChainRecordNeeded = true;
+	else
+		m_recordNeeded = true;
+}
+
+void Wolf::Scene::updateInstanceTransform(int renderPassID, int rendererID, int instanceID, const glm::mat4& transform)
+{
+	m_sceneRenderPasses[renderPassID].renderers[rendererID]->updateInstanceTransform(instanceID, transform);
 }
 
-void Wolf::Scene::addText(AddTextInfo addTextInfo)
+int Wolf::Scene::addText(AddTextInfo addTextInfo)
 {	
 	// Build text
 	const VkExtent2D outputExtent = m_sceneRenderPasses[addTextInfo.renderPassID].outputs[0].attachment.extent;
 	addTextInfo.text->build(outputExtent, addTextInfo.font, addTextInfo.size);
 
+	const DescriptorSetCreateInfo descriptorSetCreateInfo = getTextDescriptorSetCreateInfo(addTextInfo);
+
+	Renderer::AddMeshInfo addMeshInfo{};
+	addMeshInfo.descriptorSetCreateInfo = descriptorSetCreateInfo;
+	addMeshInfo.vertexBuffer = addTextInfo.text->getVertexBuffer();
+	
+	const int meshID = m_sceneRenderPasses[addTextInfo.renderPassID].renderers[addTextInfo.rendererID]->addMesh(addMeshInfo);
+
+	// Update descriptor pools needs
+	updateDescriptorPool(addMeshInfo.descriptorSetCreateInfo);
+
+	return meshID;
+}
+
+void Wolf::Scene::updateText(const AddTextInfo& addTextInfo, int meshID)
+{
+	if (!addTextInfo.text->requiresReallocation())
+	{
+		addTextInfo.text->update();
+		return;
+	}
+
+	// Buffers are replaced, command buffers may be pending
+	vkDeviceWaitIdle(m_device);
+	addTextInfo.text->update();
+
+	Renderer* renderer = m_sceneRenderPasses[addTextInfo.renderPassID].renderers[addTextInfo.rendererID].get();
+	VertexBuffer vertexBuffer = addTextInfo.text->getVertexBuffer();
+	renderer->updateVertexBuffer(meshID, vertexBuffer);
+	renderer->updateDescriptorSet(meshID, getTextDescriptorSetCreateInfo(addTextInfo));
+
+	// Old buffers and descriptor set are destroyed: every command buffer drawing the text is recorded again (UI is usually in the swapchain ones)
+	if (m_sceneRenderPasses[addTextInfo.renderPassID].commandBufferID == -1)
+		recordSwapChainCommandBuffers();
+	else
+		recordSceneCommandBuffers();
+}
+
+Wolf::DescriptorSetCreateInfo Wolf::Scene::getTextDescriptorSetCreateInfo(const AddTextInfo& addTextInfo)
+{
 	DescriptorSetGenerator descriptorSetGenerator;
 
-	// Uniform Buffer
-	descriptorSetGenerator.addUniformBuffer(addTextInfo.text->getUBO(), VK_SHADER_STAGE_VERTEX_BIT, 0);
+	// Per string data
+	descriptorSetGenerator.addBuffer(addTextInfo.text->getTextDataBuffer(), VK_SHADER_STAGE_VERTEX_BIT, 0);
 
 	// Images
 	descriptorSetGenerator.addImages(addTextInfo.font->getImages(), VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_SHADER_STAGE_FRAGMENT_BIT, 2);
@@ -357,19 +446,15 @@ void Wolf::Scene::addText(AddTextInfo addTextInfo)
 	for (auto& image : addTextInfo.descriptorSetCreateInfo.descriptorImages)
 		descriptorSetCreateInfo.descriptorImages.push_back(image);
 
-	Renderer::AddMeshInfo addMeshInfo{};
-	addMeshInfo.descriptorSetCreateInfo = descriptorSetCreateInfo;
-	addMeshInfo.vertexBuffer = addTextInfo.text->getVertexBuffer();
-	
-	m_sceneRenderPasses[addTextInfo.renderPassID].renderers[addTextInfo.rendererID]->addMesh(addMeshInfo);
-
-	// Update descriptor pools needs
-	updateDescriptorPool(descriptorSetCreateInfo);
+	return descriptorSetCreateInfo;
 }
 
 void Wolf::Scene::record()
 {
-	m_descriptorPool.allocate(m_device);
+	m_descriptorPool.initialize(m_device);
+
+	if (m_enableGPUTimings)
+		createTimestampQueryPool();
 	
 	for(SceneRenderPass& sceneRenderPass : m_sceneRenderPasses)
 	{
@@ -379,7 +464,7 @@ void Wolf::Scene::record()
 
 		// Renderers creation
 		for (std::unique_ptr<Renderer>& renderer : sceneRenderPass.renderers)
-			if(renderer.get()) renderer->create(m_descriptorPool.getDescriptorPool());
+			if(renderer.get()) renderer->create(&m_descriptorPool);
 	}
 
 	for (SceneComputePass& sceneComputePass : m_sceneComputePasses)
@@ -389,13 +474,13 @@ void Wolf::Scene::record()
 #endif // DEBUG
 
 		for(size_t i(0); i < sceneComputePass.computePasses.size(); ++i)
-			sceneComputePass.computePasses[i]->create(m_descriptorPool.getDescriptorPool());
+			sceneComputePass.computePasses[i]->create(&m_descriptorPool);
 	}
 
 	for(SceneRayTracingPass& sceneRayTracingPass : m_sceneRayTracingPasses)
 	{
 		for (size_t i(0); i < sceneRayTracingPass.rayTracingPasses.size(); ++i)
-			sceneRayTracingPass.rayTracingPasses[i]->create(m_descriptorPool.getDescriptorPool());
+			sceneRayTracingPass.rayTracingPasses[i]->create(&m_descriptorPool);
 	}
 	
 	// As a scene is designed to be renderer on a screen, we need to create a command buffer for each swapchain image
@@ -406,7 +491,28 @@ void Wolf::Scene::record()
 			m_swapChainCommandBuffers[i] = std::make_unique<CommandBuffer>(m_device, m_graphicsCommandPool);
 		else 
 			m_swapChainCommandBuffers[i] = std::make_unique<CommandBuffer>(m_device, m_computeCommandPool);
-		
+	}
+	recordSwapChainCommandBuffers();
+
+	m_swapChainCompleteSemaphore = std::make_unique<Semaphore>();
+	m_swapChainCompleteSemaphore->initialize(m_device);
+	
+	// Other command buffers
+	recordSceneCommandBuffers();
+
+#ifndef NDEBUG
+	for (SceneRenderPass& sceneRenderPass : m_sceneRenderPasses)
+		Debug::sendInfo("Render pass " + sceneRenderPass.name + ": " + std::to_string(sceneRenderPass.stats.drawCount) + " draws, " + 
+			std::to_string(sceneRenderPass.stats.bindCount) + " binds, " + std::to_string(sceneRenderPass.stats.skippedBindCount) + " skipped binds");
+#endif // NDEBUG
+}
+
+void Wolf::Scene::recordSwapChainCommandBuffers()
+{
+	m_swapChainRecordNeeded = false;
+
+	for (size_t i(0); i < m_swapChainCommandBuffers.size(); ++i)
+	{
 		m_swapChainCommandBuffers[i]->beginCommandBuffer();
 
 		if(m_swapChainCommandType == CommandType::GRAPHICS)
@@ -424,53 +530,10 @@ void Wolf::Scene::record()
 					else
 						m_sceneRenderPasses[j].renderPass->beginRenderPass(0, clearValues, m_swapChainCommandBuffers[i]->getCommandBuffer());
 
-					for (std::unique_ptr<Renderer>& renderer : m_sceneRenderPasses[j].renderers)
-					{
-						if (!renderer.get())
-							return;
-
-						vkCmdBindPipeline(m_swapChainCommandBuffers[i]->getCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->getPipeline());
-						const VkDeviceSize offsets[1] = { 0 };
-
-						/*VkViewport viewport;
-						viewport.x = 0;
-						viewport.y = 0;
-						viewport.height = 100;
-						viewport.width = 100;
-						viewport.minDepth = 0.0f;
-						viewport.maxDepth = 1.0f;
-						vkCmdSetViewport(m_swapChainCommandBuffers[i]->getCommandBuffer(), 0, 1, &viewport);*/
-
-						std::vector<std::tuple<VertexBuffer, InstanceBuffer, VkDescriptorSet>> meshesToRender = renderer->getMeshes();
-						for (std::tuple<VertexBuffer, InstanceBuffer, VkDescriptorSet>& mesh : meshesToRender)
-						{
-							bool isInstancied = std::get<1>(mesh).nInstances > 0 && std::get<1>(mesh).instanceBuffer;
-
-							if(std::get<0>(mesh).vertexBuffer != VK_NULL_HANDLE)
-								vkCmdBindVertexBuffers(m_swapChainCommandBuffers[i]->getCommandBuffer(), 0, 1, &std::get<0>(mesh).vertexBuffer, offsets);
-							if (std::get<0>(mesh).indexBuffer != VK_NULL_HANDLE)
-								vkCmdBindIndexBuffer(m_swapChainCommandBuffers[i]->getCommandBuffer(), std::get<0>(mesh).indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-
-							if (isInstancied)
-								vkCmdBindVertexBuffers(m_swapChainCommandBuffers[i]->getCommandBuffer(), 1, 1, &std::get<1>(mesh).instanceBuffer, offsets);
-
-							if (std::get<2>(mesh) != VK_NULL_HANDLE) // render can be done without descriptor set
-								vkCmdBindDescriptorSets(m_swapChainCommandBuffers[i]->getCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS,
-									renderer->getPipelineLayout(), 0, 1, &std::get<2>(mesh), 0, nullptr);
-
-							if (renderer->useMeshShader())
-							{
-								vkCmdDrawMeshTasksNV(m_swapChainCommandBuffers[i]->getCommandBuffer(), 1, 0);
-							}
-							else
-							{
-								if (!isInstancied)
-									vkCmdDrawIndexed(m_swapChainCommandBuffers[i]->getCommandBuffer(), std::get<0>(mesh).nbIndices, 1, 0, 0, 0);
-								else
-									vkCmdDrawIndexed(m_swapChainCommandBuffers[i]->getCommandBuffer(), std::get<0>(mesh).nbIndices, std::get<1>(meshesToRender[j]).nInstances, 0, 0, 0);
-							}
-						}
-					}
+					// Every swapchain command buffer records the same draws, stats count the first one
+					if (i == 0)
+						m_sceneRenderPasses[j].stats = RenderPassStats();
+					recordRenderers(m_swapChainCommandBuffers[i]->getCommandBuffer(), m_sceneRenderPasses[j], 0, i == 0);
 
 					m_sceneRenderPasses[j].renderPass->endRenderPass(m_swapChainCommandBuffers[i]->getCommandBuffer());
 
@@ -605,15 +668,28 @@ void Wolf::Scene::record()
 		
 		m_swapChainCommandBuffers[i]->endCommandBuffer();
 	}
+}
+
+void Wolf::Scene::recordSceneCommandBuffers()
+{
+	m_recordNeeded = false;
+
+	// Stats of the render passes recorded below, swapchain render passes are recorded by recordSwapChainCommandBuffers()
+	for (SceneRenderPass& sceneRenderPass : m_sceneRenderPasses)
+		if (sceneRenderPass.commandBufferID >= 0)
+			sceneRenderPass.stats = RenderPassStats();
 
-	m_swapChainCompleteSemaphore = std::make_unique<Semaphore>();
-	m_swapChainCompleteSemaphore->initialize(m_device);
-	
-	// Other command buffers
 	for(size_t i(0); i < m_sceneCommandBuffers.size(); ++i)
 	{
 		m_sceneCommandBuffers[i].commandBuffer->beginCommandBuffer();
 
+		if (m_timestampQueryPool != VK_NULL_HANDLE)
+		{
+			vkCmdResetQueryPool(m_sceneCommandBuffers[i].commandBuffer->getCommandBuffer(), m_timestampQueryPool, m_sceneCommandBuffers[i].firstTimestampQuery, 2);
+			vkCmdWriteTimestamp(m_sceneCommandBuffers[i].commandBuffer->getCommandBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestampQueryPool,
+				m_sceneCommandBuffers[i].firstTimestampQuery);
+		}
+
 		for (auto& sceneRenderPass : m_sceneRenderPasses)
 		{
 			if (sceneRenderPass.commandBufferID == static_cast<int>(i))
@@ -630,8 +706,8 @@ void Wolf::Scene::record()
 					sceneComputePass.beforeRecord(sceneComputePass.dataForBeforeRecordCallback, m_sceneCommandBuffers[sceneComputePass.commandBufferID].commandBuffer->getCommandBuffer());
 				
 				for(size_t j(0); j < sceneComputePass.computePasses.size(); ++j)
-					sceneComputePass.computePasses[j]->record(m_sceneCommandBuffers[sceneComputePass.commandBufferID].commandBuffer->getCommandBuffer(), sceneComputePass.extent, 
-						sceneComputePass.dispatchGroups);
+					sceneComputePass.computePasses[j]->record(m_sceneCommandBuffers[sceneComputePass.commandBufferID].commandBuffer->getCommandBuffer(), 
+						sceneComputePass.dynamicResolution ? getScaledExtent(sceneComputePass.extent) : sceneComputePass.extent, sceneComputePass.dispatchGroups);
 
 				if (sceneComputePass.afterRecord)
 					sceneComputePass.afterRecord(sceneComputePass.dataForAfterRecordCallback, m_sceneCommandBuffers[sceneComputePass.commandBufferID].commandBuffer->getCommandBuffer());
@@ -652,6 +728,10 @@ void Wolf::Scene::record()
 					sceneRayTracingPass.afterRecord(sceneRayTracingPass.dataForAfterRecordCallback, m_sceneCommandBuffers[sceneRayTracingPass.commandBufferID].commandBuffer->getCommandBuffer());
 			}
 		}
+
+		if (m_timestampQueryPool != VK_NULL_HANDLE)
+			vkCmdWriteTimestamp(m_sceneCommandBuffers[i].commandBuffer->getCommandBuffer(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestampQueryPool,
+				m_sceneCommandBuffers[i].firstTimestampQuery + 1);
 		
 		m_sceneCommandBuffers[i].commandBuffer->endCommandBuffer();
 	}
@@ -667,48 +747,268 @@ inline void Wolf::Scene::recordRenderPass(SceneRenderPass& sceneRenderPass)
 		if(output.clearValue.color.float32[0] >= 0.0f)
 			clearValues.push_back(output.clearValue);
 
+	// Queries are reset in the command buffer as it is submitted every frame
+	if (m_timestampQueryPool != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(m_sceneCommandBuffers[sceneRenderPass.commandBufferID].commandBuffer->getCommandBuffer(), m_timestampQueryPool, sceneRenderPass.firstTimestampQuery, 2);
+		vkCmdWriteTimestamp(m_sceneCommandBuffers[sceneRenderPass.commandBufferID].commandBuffer->getCommandBuffer(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestampQueryPool,
+			sceneRenderPass.firstTimestampQuery);
+	}
+
 	const int framebufferCount = sceneRenderPass.renderPass->getFramebufferCount();
 	for (int framebufferID = 0; framebufferID < framebufferCount; ++framebufferID)
 	{
-		sceneRenderPass.renderPass->beginRenderPass(framebufferID, clearValues, m_sceneCommandBuffers[sceneRenderPass.commandBufferID].commandBuffer->getCommandBuffer());
+		sceneRenderPass.renderPass->beginRenderPass(framebufferID, clearValues, m_sceneCommandBuffers[sceneRenderPass.commandBufferID].commandBuffer->getCommandBuffer(),
+			sceneRenderPass.dynamicResolution ? getScaledExtent(sceneRenderPass.extent) : VkExtent2D{ 0, 0 });
 
-		for (std::unique_ptr<Renderer>& renderer : sceneRenderPass.renderers)
+		recordRenderers(m_sceneCommandBuffers[sceneRenderPass.commandBufferID].commandBuffer->getCommandBuffer(), sceneRenderPass, framebufferID);
+
+		sceneRenderPass.renderPass->endRenderPass(m_sceneCommandBuffers[sceneRenderPass.commandBufferID].commandBuffer->getCommandBuffer());
+	}
+
+	if (m_timestampQueryPool != VK_NULL_HANDLE)
+		vkCmdWriteTimestamp(m_sceneCommandBuffers[sceneRenderPass.commandBufferID].commandBuffer->getCommandBuffer(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestampQueryPool,
+			sceneRenderPass.firstTimestampQuery + 1);
+
+	if (sceneRenderPass.afterRecord)
+		sceneRenderPass.afterRecord(sceneRenderPass.dataForAfterRecordCallback, m_sceneCommandBuffers[sceneRenderPass.commandBufferID].commandBuffer->getCommandBuffer());
+}
+
+inline void Wolf::Scene::recordRenderers(VkCommandBuffer commandBuffer, SceneRenderPass& sceneRenderPass, int framebufferID, bool countStats)
+{
+	// Last bound state, binds with the same value are skipped
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	VkPipelineLayout boundPipelineLayout = VK_NULL_HANDLE;
+	VkDescriptorSet boundDescriptorSet = VK_NULL_HANDLE;
+	VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+	VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+	VkBuffer boundInstanceBuffer = VK_NULL_HANDLE;
+
+	RenderPassStats ignoredStats;
+	RenderPassStats& stats = countStats ? sceneRenderPass.stats : ignoredStats;
+	const VkDeviceSize offsets[1] = { 0 };
+
+	for (std::unique_ptr<Renderer>& renderer : sceneRenderPass.renderers)
+	{
+		if (!renderer.get())
+			continue;
+
+		if (renderer->getPipeline() != boundPipeline)
 		{
-			vkCmdBindPipeline(m_sceneCommandBuffers[sceneRenderPass.commandBufferID].commandBuffer->getCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->getPipeline());
-			const VkDeviceSize offsets[1] = { 0 };
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->getPipeline());
+			boundPipeline = renderer->getPipeline();
+			stats.bindCount++;
 
-			std::vector<std::tuple<VertexBuffer, InstanceBuffer, VkDescriptorSet>> meshesToRender = renderer->getMeshes(framebufferID);
-			for (std::tuple<VertexBuffer, InstanceBuffer, VkDescriptorSet>& mesh : meshesToRender)
+			if (sceneRenderPass.dynamicResolution)
 			{
-				bool isInstancied = std::get<1>(mesh).nInstances > 0 && std::get<1>(mesh).instanceBuffer;
+				const RenderingPipelineCreateInfo& pipelineCreateInfo = renderer->getPipelineCreateInfo();
+				const VkExtent2D scaledExtent = getScaledExtent(pipelineCreateInfo.extent.width > 0 ? pipelineCreateInfo.extent : sceneRenderPass.extent);
+
+				VkViewport viewport = {};
+				viewport.x = scaledExtent.width * pipelineCreateInfo.viewportOffset[0];
+				viewport.y = scaledExtent.height * pipelineCreateInfo.viewportOffset[1];
+				viewport.width = scaledExtent.width * pipelineCreateInfo.viewportScale[0];
+				viewport.height = scaledExtent.height * pipelineCreateInfo.viewportScale[1];
+				viewport.minDepth = 0.0f;
+				viewport.maxDepth = 1.0f;
+				vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+
+				const VkRect2D scissor = { { 0, 0 }, scaledExtent };
+				vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+			}
+		}
+		else
+			stats.skippedBindCount++;
 
-				vkCmdBindVertexBuffers(m_sceneCommandBuffers[sceneRenderPass.commandBufferID].commandBuffer->getCommandBuffer(), 0, 1, &std::get<0>(mesh).vertexBuffer, offsets);
-				vkCmdBindIndexBuffer(m_sceneCommandBuffers[sceneRenderPass.commandBufferID].commandBuffer->getCommandBuffer(), std::get<0>(mesh).indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+		// Descriptor sets bound with another layout can't be relied on
+		if (renderer->getPipelineLayout() != boundPipelineLayout)
+		{
+			boundPipelineLayout = renderer->getPipelineLayout();
+			boundDescriptorSet = VK_NULL_HANDLE;
 
-				if (isInstancied)
-					vkCmdBindVertexBuffers(m_sceneCommandBuffers[sceneRenderPass.commandBufferID].commandBuffer->getCommandBuffer(), 1, 1, &std::get<1>(mesh).instanceBuffer, offsets);
+			// Texture table is shared by every mesh of the renderer
+			const VkDescriptorSet bindlessDescriptorSet = renderer->getBindlessDescriptorSet();
+			if (bindlessDescriptorSet != VK_NULL_HANDLE)
+			{
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, boundPipelineLayout, BINDLESS_DESCRIPTOR_SET, 1, &bindlessDescriptorSet, 0, nullptr);
+				stats.bindCount++;
+			}
+		}
 
-				if (std::get<2>(mesh) != VK_NULL_HANDLE) // render can be done without descriptor set
-					vkCmdBindDescriptorSets(m_sceneCommandBuffers[sceneRenderPass.commandBufferID].commandBuffer->getCommandBuffer(), VK_PIPELINE_BIND_POINT_GRAPHICS,
-						renderer->getPipelineLayout(), 0, 1, &std::get<2>(mesh), 0, nullptr);
+		const Renderer::DrawList& drawList = renderer->getDrawList(framebufferID);
+		for (size_t k(0); k < drawList.size(); ++k)
+		{
+			if (drawList.vertexBuffers[k] != VK_NULL_HANDLE)
+			{
+				if (drawList.vertexBuffers[k] != boundVertexBuffer)
+				{
+					vkCmdBindVertexBuffers(commandBuffer, 0, 1, &drawList.vertexBuffers[k], offsets);
+					boundVertexBuffer = drawList.vertexBuffers[k];
+					stats.bindCount++;
+				}
+				else
+					stats.skippedBindCount++;
+			}
+			if (drawList.indexBuffers[k] != VK_NULL_HANDLE)
+			{
+				if (drawList.indexBuffers[k] != boundIndexBuffer)
+				{
+					vkCmdBindIndexBuffer(commandBuffer, drawList.indexBuffers[k], 0, VK_INDEX_TYPE_UINT32);
+					boundIndexBuffer = drawList.indexBuffers[k];
+					stats.bindCount++;
+				}
+				else
+					stats.skippedBindCount++;
+			}
+
+			if (drawList.instanceBuffers[k] != VK_NULL_HANDLE)
+			{
+				if (drawList.instanceBuffers[k] != boundInstanceBuffer)
+				{
+					vkCmdBindVertexBuffers(commandBuffer, 1, 1, &drawList.instanceBuffers[k], offsets);
+					boundInstanceBuffer = drawList.instanceBuffers[k];
+					stats.bindCount++;
+				}
+				else
+					stats.skippedBindCount++;
+			}
 
-				if (!isInstancied)
-					vkCmdDrawIndexed(m_sceneCommandBuffers[sceneRenderPass.commandBufferID].commandBuffer->getCommandBuffer(), std::get<0>(mesh).nbIndices, 1, 0, 0, 0);
+			if (drawList.descriptorSets[k] != VK_NULL_HANDLE) // render can be done without descriptor set
+			{
+				if (drawList.descriptorSets[k] != boundDescriptorSet)
+				{
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, renderer->getPipelineLayout(), 0, 1, &drawList.descriptorSets[k], 0, nullptr);
+					boundDescriptorSet = drawList.descriptorSets[k];
+					stats.bindCount++;
+				}
 				else
-					vkCmdDrawIndexed(m_sceneCommandBuffers[sceneRenderPass.commandBufferID].commandBuffer->getCommandBuffer(), std::get<0>(mesh).nbIndices, std::get<1>(mesh).nInstances, 0, 0, 0);
+					stats.skippedBindCount++;
 			}
+
+			// Each range receives its part of the payload with its own stages
+			if (drawList.pushConstantSizes[k] > 0)
+			{
+				for (const VkPushConstantRange& pushConstantRange : renderer->getPipelineCreateInfo().pushConstantRanges)
+				{
+					if (pushConstantRange.offset >= drawList.pushConstantSizes[k])
+						continue;
+					const uint32_t size = std::min(pushConstantRange.size, drawList.pushConstantSizes[k] - pushConstantRange.offset);
+					vkCmdPushConstants(commandBuffer, renderer->getPipelineLayout(), pushConstantRange.stageFlags, pushConstantRange.offset, size,
+						drawList.pushConstantData.data() + drawList.pushConstantOffsets[k] + pushConstantRange.offset);
+				}
+			}
+
+			if (renderer->useMeshShader())
+				vkCmdDrawMeshTasksNV(commandBuffer, drawList.meshTaskCounts[k], 0);
+			else if (drawList.indirectBuffers[k].drawCommandBuffer != VK_NULL_HANDLE)
+				recordIndirectDraw(commandBuffer, drawList.indirectBuffers[k]);
+			else
+				vkCmdDrawIndexed(commandBuffer, drawList.indexCounts[k], drawList.instanceCounts[k], 0, 0, drawList.firstInstances[k]);
+
+			stats.drawCount++;
 		}
+	}
+}
 
-		sceneRenderPass.renderPass->endRenderPass(m_sceneCommandBuffers[sceneRenderPass.commandBufferID].commandBuffer->getCommandBuffer());
+void Wolf::Scene::createTimestampQueryPool()
+{
+	if (m_timestampQueryPool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(m_device, m_timestampQueryPool, nullptr);
+	m_timestampQueryPool = VK_NULL_HANDLE;
+
+	if (m_sceneRenderPasses.empty() && m_sceneCommandBuffers.empty())
+		return;
+
+	// Render passes then command buffers, begin and end queries
+	VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+	queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolCreateInfo.queryCount = static_cast<uint32_t>(m_sceneRenderPasses.size() + m_sceneCommandBuffers.size()) * 2;
+
+	if (vkCreateQueryPool(m_device, &queryPoolCreateInfo, nullptr, &m_timestampQueryPool) != VK_SUCCESS)
+	{
+		Debug::sendWarning("Can't create timestamp query pool, GPU timings disabled");
+		m_timestampQueryPool = VK_NULL_HANDLE;
+		return;
 	}
 
-	if (sceneRenderPass.afterRecord)
-		sceneRenderPass.afterRecord(sceneRenderPass.dataForAfterRecordCallback, m_sceneCommandBuffers[sceneRenderPass.commandBufferID].commandBuffer->getCommandBuffer());
+	for (size_t i(0); i < m_sceneRenderPasses.size(); ++i)
+		m_sceneRenderPasses[i].firstTimestampQuery = static_cast<uint32_t>(i) * 2;
+	for (size_t i(0); i < m_sceneCommandBuffers.size(); ++i)
+		m_sceneCommandBuffers[i].firstTimestampQuery = static_cast<uint32_t>(m_sceneRenderPasses.size() + i) * 2;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(m_physicalDevice, &properties);
+	m_timestampPeriod = properties.limits.timestampPeriod;
+}
+
+float Wolf::Scene::getRenderPassGPUTime(int renderPassID) const
+{
+	if (m_timestampQueryPool == VK_NULL_HANDLE || m_sceneRenderPasses[renderPassID].commandBufferID < 0)
+		return -1.0f;
+
+	std::array<uint64_t, 2> timestamps{};
+	if (vkGetQueryPoolResults(m_device, m_timestampQueryPool, m_sceneRenderPasses[renderPassID].firstTimestampQuery, 2, sizeof(timestamps), timestamps.data(), sizeof(uint64_t),
+		VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+		return -1.0f;
+
+	return static_cast<float>(timestamps[1] - timestamps[0]) * m_timestampPeriod / 1000000.0f;
+}
+
+float Wolf::Scene::getCommandBufferGPUTime(int commandBufferID) const
+{
+	if (m_timestampQueryPool == VK_NULL_HANDLE || commandBufferID < 0)
+		return -1.0f;
+
+	std::array<uint64_t, 2> timestamps{};
+	if (vkGetQueryPoolResults(m_device, m_timestampQueryPool, m_sceneCommandBuffers[commandBufferID].firstTimestampQuery, 2, sizeof(timestamps), timestamps.data(),
+		sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+		return -1.0f;
+
+	return static_cast<float>(timestamps[1] - timestamps[0]) * m_timestampPeriod / 1000000.0f;
+}
+
+void Wolf::Scene::setRenderScale(float renderScale)
+{
+	renderScale = glm::clamp(renderScale, 0.1f, 1.0f);
+	if (renderScale == m_renderScale)
+		return;
+	m_renderScale = renderScale;
+
+	// Command buffers may be pending
+	vkDeviceWaitIdle(m_device);
+	recordSceneCommandBuffers();
+}
+
+VkExtent2D Wolf::Scene::getScaledExtent(VkExtent2D extent) const
+{
+	return { glm::max(static_cast<uint32_t>(static_cast<float>(extent.width) * m_renderScale + 0.5f), 1u),
+		glm::max(static_cast<uint32_t>(static_cast<float>(extent.height) * m_renderScale + 0.5f), 1u) };
+}
+
+inline void Wolf::Scene::recordIndirectDraw(VkCommandBuffer commandBuffer, const IndirectBuffer& indirectBuffer)
+{
+	if (indirectBuffer.countBuffer != VK_NULL_HANDLE)
+		vkCmdDrawIndexedIndirectCountKHR(commandBuffer, indirectBuffer.drawCommandBuffer, indirectBuffer.offset, indirectBuffer.countBuffer, 0, indirectBuffer.maxDrawCount,
+			sizeof(VkDrawIndexedIndirectCommand));
+	else
+		vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer.drawCommandBuffer, indirectBuffer.offset, indirectBuffer.maxDrawCount, sizeof(VkDrawIndexedIndirectCommand));
 }
 
 void Wolf::Scene::frame(Queue graphicsQueue, Queue computeQueue, uint32_t swapChainImageIndex, Semaphore* imageAvailableSemaphore, std::vector<int> commandBufferIDs,
                         const std::vector<std::pair<int, int>>& commandBufferSynchronization, bool submitSwapchainCommandBuffer)
 {
+	// Command buffers can be skipped on some frames (ex: cached shadow cascades), their semaphores won't be signaled
+	auto isSubmitted = [&commandBufferIDs](int commandBufferID) { return std::find(commandBufferIDs.begin(), commandBufferIDs.end(), commandBufferID) != commandBufferIDs.end(); };
+
+	// Command buffers may be pending
+	if (m_recordNeeded || m_swapChainRecordNeeded)
+		vkDeviceWaitIdle(m_device);
+	if (m_swapChainRecordNeeded)
+		recordSwapChainCommandBuffers();
+	if (m_recordNeeded)
+		recordSceneCommandBuffers();
+
 	for(auto& commandBufferID : commandBufferIDs)
 	{
 		if (commandBufferID < 0)
@@ -717,7 +1017,7 @@ void Wolf::Scene::frame(Queue graphicsQueue, Queue computeQueue, uint32_t swapCh
 		std::vector<Semaphore*> waitSemaphores;
 		for (auto& commandBufferWaiting : commandBufferSynchronization)
 		{
-			if (commandBufferWaiting.second == commandBufferID)
+			if (commandBufferWaiting.second == commandBufferID && isSubmitted(commandBufferWaiting.first))
 			{
 				waitSemaphores.push_back(m_sceneCommandBuffers[commandBufferWaiting.first].semaphore.get());
 			}
@@ -747,6 +1047,8 @@ void Wolf::Scene::frame(Queue graphicsQueue, Queue computeQueue, uint32_t swapCh
 				Debug::sendError("No command buffer can't wait from swapchain command buffer");
 			else if (commandBufferWaiting.first < 0)
 				Debug::sendError("Invalid command buffer ID");
+			else if (!isSubmitted(commandBufferWaiting.first))
+				continue;
 			waitSemaphoreSwapChain.push_back(m_sceneCommandBuffers[commandBufferWaiting.first].semaphore.get());
 		}
 	}
@@ -27,10 +27,12 @@ namespace Wolf
 		struct	SceneCreateInfo
 		{
 			CommandType swapChainCommandType = CommandType::GRAPHICS;
+			bool enableGPUTimings = false; // timestamp queries around offscreen render passes and command buffers
 		};
 		
 		Scene(SceneCreateInfo createInfo, VkDevice device, VkPhysicalDevice physicalDevice, std::vector<Image*> swapChainImages, VkCommandPool graphicsCommandPool, VkCommandPool computeCommandPool);
 		Scene(SceneCreateInfo createInfo, VkDevice device, VkPhysicalDevice physicalDevice, std::vector<Image*> ovrSwapChainImages, std::vector<Image*> windowSwapChainImages, VkCommandPool graphicsCommandPool, VkCommandPool computeCommandPool);
+		~Scene();
 
 		struct RenderPassOutput
 		{
@@ -48,6 +50,7 @@ namespace Wolf
 			std::vector<RenderPassOutput> outputs;
 			VkExtent2D extent = { 0, 0 };
 			int framebufferCount = 1;
+			bool dynamicResolution = false; // only the top left getRenderScale() part of the outputs is rendered
 
 			std::function<void(void*, VkCommandBuffer)> beforeRecord = nullptr; void* dataForBeforeRecordCallback = nullptr;
 			std::function<void(void*, VkCommandBuffer)> afterRecord = nullptr; void* dataForAfterRecordCallback = nullptr;
@@ -64,6 +67,8 @@ namespace Wolf
 			std::string name = "Unknown compute pass";
 			
 			std::string computeShaderPath;
+			std::vector<uint32_t> specializationConstants; // constant_id = index
+			bool dynamicResolution = false; // dispatch covers extent * getRenderScale()
 
 			DescriptorSetCreateInfo descriptorSetCreateInfo;
 
@@ -108,9 +113,12 @@ namespace Wolf
 
 		int addRenderer(RendererCreateInfo createInfo);
 
-		void addMesh(Renderer::AddMeshInfo addMeshInfo);
+		// Returns the instance ID for renderers using InstanceTemplate::TRANSFORM, the mesh ID otherwise
+		int addMesh(Renderer::AddMeshInfo addMeshInfo);
 
+		// Command buffers are recorded again at the beginning of the next frame
 		void updateVertexBuffer(int renderPassID, int rendererID, int meshID, VertexBuffer& vertexBuffer);
+		void updateInstanceTransform(int renderPassID, int rendererID, int instanceID, const glm::mat4& transform);
 
 		struct AddTextInfo
 		{
@@ -123,7 +131,9 @@ namespace Wolf
 			// Info to add
 			DescriptorSetCreateInfo descriptorSetCreateInfo;
 		};
-		void addText(AddTextInfo addTextInfo);
+		int addText(AddTextInfo addTextInfo); // returns the mesh ID for updateText
+		// Applies Text::updateWString/setColor... in place, records again only if the text buffers had to grow
+		void updateText(const AddTextInfo& addTextInfo, int meshID);
 		
 		void record();
 		
@@ -132,6 +142,24 @@ namespace Wolf
 
 		void resize(std::vector<Image*> swapChainImages);
 
+		// Dynamic resolution: targets keep their size, passes created with dynamicResolution only cover scale * extent.
+		// A new scale waits for the device and records the scene command buffers again, quantize it (see DynamicResolution)
+		void setRenderScale(float renderScale);
+		float getRenderScale() const { return m_renderScale; }
+		VkExtent2D getScaledExtent(VkExtent2D extent) const;
+
+		struct RenderPassStats
+		{
+			uint32_t drawCount = 0;
+			uint32_t bindCount = 0;
+			uint32_t skippedBindCount = 0;
+		};
+		RenderPassStats getRenderPassStats(int renderPassID) const { return m_sceneRenderPasses[renderPassID].stats; } // last recording, one command buffer (every framebuffer of the pass)
+		float getRenderPassGPUTime(int renderPassID) const; // ms, negative when timings are disabled or not available yet
+		float getCommandBufferGPUTime(int commandBufferID) const; // ms, last submission of the command buffer
+
+		// Growable, sets can be allocated and freed at any time after record() (first pool is sized from the passes and meshes added before)
+		DescriptorPool* getDescriptorPool() { return &m_descriptorPool; }
 		VkSemaphore getSwapChainSemaphore() const { return m_swapChainCompleteSemaphore->getSemaphore(); }
 		Image* getRenderPassOutput(int renderPassID, int textureID, int framebufferID = 0) { return m_sceneRenderPasses[renderPassID].renderPass->getImages(framebufferID)[textureID]; }
 
@@ -158,6 +186,7 @@ namespace Wolf
 			std::unique_ptr<CommandBuffer> commandBuffer;
 			std::unique_ptr<Semaphore> semaphore;
 			CommandType type;
+			uint32_t firstTimestampQuery = 0;
 
 			SceneCommandBuffer(CommandType type)
 			{
@@ -177,9 +206,15 @@ namespace Wolf
 			// Output
 			std::vector<RenderPassOutput> outputs;
 			bool outputIsSwapChain = false;
+			VkExtent2D extent = { 0, 0 };
+			bool dynamicResolution = false;
 
 			std::vector<std::unique_ptr<Renderer>> renderers;
 
+			// Filled at record
+			RenderPassStats stats;
+			uint32_t firstTimestampQuery = 0;
+
 			std::function<void(void*, VkCommandBuffer)> beforeRecord = nullptr; void* dataForBeforeRecordCallback = nullptr;
 			std::function<void(void*, VkCommandBuffer)> afterRecord = nullptr; void* dataForAfterRecordCallback = nullptr;
 
@@ -204,6 +239,7 @@ namespace Wolf
 			uint32_t outputBinding = 0;
 			VkExtent2D extent;
 			VkExtent3D dispatchGroups;
+			bool dynamicResolution = false;
 
 			std::function<void(void*, VkCommandBuffer)> beforeRecord = nullptr; void* dataForBeforeRecordCallback = nullptr;
 			std::function<void(void*, VkCommandBuffer)> afterRecord = nullptr; void* dataForAfterRecordCallback = nullptr;
@@ -254,8 +290,26 @@ namespace Wolf
 		// VR
 		bool m_useOVR = false;
 
+		// GPU timings
+		bool m_enableGPUTimings = false;
+		VkQueryPool m_timestampQueryPool = VK_NULL_HANDLE;
+		float m_timestampPeriod = 1.0f;
+
+		// Dynamic resolution
+		float m_renderScale = 1.0f;
+
+		// Vertex buffers changed since the last recording (ex: LOD switch)
+		bool m_recordNeeded = false;
+		bool m_swapChainRecordNeeded = false;
+
 	private:
 		inline void updateDescriptorPool(DescriptorSetCreateInfo& descriptorSetCreateInfo);
+		static DescriptorSetCreateInfo getTextDescriptorSetCreateInfo(const AddTextInfo& addTextInfo);
+		void createTimestampQueryPool();
+		void recordSwapChainCommandBuffers();
+		void recordSceneCommandBuffers();
 		inline void recordRenderPass(SceneRenderPass& sceneRenderPasse);
+		inline void recordRenderers(VkCommandBuffer commandBuffer, SceneRenderPass& sceneRenderPass, int framebufferID, bool countStats = true);
+		inline void recordIndirectDraw(VkCommandBuffer commandBuffer, const IndirectBuffer& indirectBuffer);
 	};
 }
@@ -0,0 +1,156 @@
+#include "ShadowAtlas.h"
+
+Wolf::ShadowAtlas::ShadowAtlas(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, const Model* model, uint32_t tileCount, uint32_t tileSize, uint32_t lod, bool cullCasters)
+{
+	m_engineInstance = engineInstance;
+	m_scene = scene;
+	m_tileCount = glm::clamp(tileCount, 1u, SHADOW_ATLAS_MAX_TILES);
+	m_columnCount = m_tileCount > 1 ? 2 : 1;
+	m_rowCount = m_tileCount > 2 ? 2 : 1;
+	m_cullCasters = cullCasters;
+
+	// Command Buffer creation
+	Scene::CommandBufferCreateInfo commandBufferCreateInfo;
+	commandBufferCreateInfo.commandType = Scene::CommandType::GRAPHICS;
+	commandBufferCreateInfo.finalPipelineStage = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+	m_commandBufferID = scene->addCommandBuffer(commandBufferCreateInfo);
+
+	// Data
+	m_lightSpaceMatrices.fill(glm::mat4(1.0f));
+	for (uint32_t i(0); i < SHADOW_ATLAS_MAX_TILES; ++i)
+	{
+		const uint32_t tile = glm::min(i, m_tileCount - 1);
+		const glm::vec2 tileMin(-1.0f + 2.0f * static_cast<float>(tile % m_columnCount) / static_cast<float>(m_columnCount),
+			-1.0f + 2.0f * static_cast<float>(tile / m_columnCount) / static_cast<float>(m_rowCount));
+		const glm::vec2 tileMax = tileMin + glm::vec2(2.0f / static_cast<float>(m_columnCount), 2.0f / static_cast<float>(m_rowCount));
+		m_uboData.tileBounds[i] = glm::vec4(tileMin, tileMax);
+		m_uboData.tileLightSpaceMatrices[i] = getTileMatrix(i);
+	}
+	m_uniformBuffer = engineInstance->createUniformBufferObject(&m_uboData, sizeof(UBOData));
+
+	// Render Pass Creation
+	const VkExtent2D extent = { m_columnCount * tileSize, m_rowCount * tileSize };
+
+	Scene::RenderPassCreateInfo renderPassCreateInfo{};
+	renderPassCreateInfo.name = "Shadow Atlas";
+	renderPassCreateInfo.commandBufferID = m_commandBufferID;
+	renderPassCreateInfo.outputIsSwapChain = false;
+
+	// Read as storage image by the shadow mask like the cascade depth passes
+	Scene::RenderPassOutput renderPassOutput;
+	renderPassOutput.attachment = Attachment(extent, VK_FORMAT_D32_SFLOAT, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_LAYOUT_GENERAL, VK_ATTACHMENT_STORE_OP_STORE,
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+	renderPassOutput.clearValue = { 1.0f };
+	renderPassCreateInfo.outputs = { renderPassOutput };
+
+	m_renderPassID = m_scene->addRenderPass(renderPassCreateInfo);
+
+	// Renderer
+	RendererCreateInfo rendererCreateInfo;
+
+	ShaderCreateInfo vertexShaderCreateInfo{};
+	vertexShaderCreateInfo.filename = "Shaders/CSM/atlasVert.spv";
+	vertexShaderCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+	rendererCreateInfo.pipelineCreateInfo.shaderCreateInfos.push_back(vertexShaderCreateInfo);
+
+	rendererCreateInfo.inputVerticesTemplate = InputVertexTemplate::FULL_3D_MATERIAL;
+	rendererCreateInfo.instanceTemplate = InstanceTemplate::NO;
+	rendererCreateInfo.renderPassID = m_renderPassID;
+	rendererCreateInfo.pipelineCreateInfo.extent = extent;
+	rendererCreateInfo.pipelineCreateInfo.alphaBlending = { false };
+
+	const VkPushConstantRange firstTilePushConstantRange = { VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(uint32_t) };
+	rendererCreateInfo.pipelineCreateInfo.pushConstantRanges.push_back(firstTilePushConstantRange);
+
+	DescriptorSetGenerator descriptorSetGenerator;
+	descriptorSetGenerator.addUniformBuffer(m_uniformBuffer, VK_SHADER_STAGE_VERTEX_BIT, 0);
+
+	rendererCreateInfo.descriptorSetLayout = descriptorSetGenerator.getDescriptorLayouts();
+
+	m_rendererID = scene->addRenderer(rendererCreateInfo);
+
+	// Draw commands
+	const HardwareCapabilities hardwareCapabilities = engineInstance->getHardwareCapabilities();
+	m_useFirstInstance = hardwareCapabilities.multiDrawIndirectAvailable && hardwareCapabilities.drawIndirectFirstInstanceAvailable;
+
+	const VertexBuffer vertexBuffer = model->getLODVertexBuffers(lod)[0];
+	const std::vector<std::vector<MeshCluster>> clusters = model->getLODClusters(lod);
+	if (!clusters.empty() && !clusters[0].empty() && hardwareCapabilities.multiDrawIndirectAvailable)
+		m_clusters = clusters[0];
+	else
+	{
+		m_clusters = { { 0, vertexBuffer.nbIndices, glm::vec4(0.0f) } };
+		m_cullCasters = false;
+	}
+
+	m_drawCommandBuffer = engineInstance->createBuffer(sizeof(VkDrawIndexedIndirectCommand) * m_tileCount * m_clusters.size(), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	updateDrawCommands();
+
+	const uint32_t meshCount = m_useFirstInstance ? 1 : m_tileCount;
+	const uint32_t drawCountPerMesh = (m_tileCount / meshCount) * static_cast<uint32_t>(m_clusters.size());
+	for (uint32_t i(0); i < meshCount; ++i)
+	{
+		Renderer::AddMeshInfo addMeshInfo{};
+		addMeshInfo.vertexBuffer = vertexBuffer;
+		addMeshInfo.renderPassID = m_renderPassID;
+		addMeshInfo.rendererID = m_rendererID;
+		addMeshInfo.indirectBuffer.drawCommandBuffer = m_drawCommandBuffer->getBuffer();
+		addMeshInfo.indirectBuffer.maxDrawCount = drawCountPerMesh;
+		addMeshInfo.indirectBuffer.offset = sizeof(VkDrawIndexedIndirectCommand) * i * drawCountPerMesh;
+		addMeshInfo.setPushConstants(m_useFirstInstance ? 0u : i);
+
+		addMeshInfo.descriptorSetCreateInfo = descriptorSetGenerator.getDescritorSetCreateInfo();
+
+		m_meshIDs.push_back(m_scene->addMesh(addMeshInfo));
+	}
+}
+
+void Wolf::ShadowAtlas::update(const std::vector<glm::mat4>& lightSpaceMatrices)
+{
+	for (uint32_t tile(0); tile < m_tileCount && tile < lightSpaceMatrices.size(); ++tile)
+	{
+		m_lightSpaceMatrices[tile] = lightSpaceMatrices[tile];
+		m_uboData.tileLightSpaceMatrices[tile] = getTileMatrix(tile) * m_lightSpaceMatrices[tile];
+	}
+	m_uniformBuffer->updateData(&m_uboData);
+
+	updateDrawCommands();
+}
+
+glm::mat4 Wolf::ShadowAtlas::getTileMatrix(uint32_t tile) const
+{
+	const glm::vec4 bounds = m_uboData.tileBounds[glm::min(tile, m_tileCount - 1)];
+
+	glm::mat4 tileMatrix(1.0f);
+	tileMatrix[0][0] = (bounds.z - bounds.x) * 0.5f;
+	tileMatrix[1][1] = (bounds.w - bounds.y) * 0.5f;
+	tileMatrix[3][0] = (bounds.x + bounds.z) * 0.5f;
+	tileMatrix[3][1] = (bounds.y + bounds.w) * 0.5f;
+
+	return tileMatrix;
+}
+
+void Wolf::ShadowAtlas::updateDrawCommands()
+{
+	VkDrawIndexedIndirectCommand* drawCommands;
+	m_drawCommandBuffer->map(reinterpret_cast<void**>(&drawCommands));
+
+	m_visibleCasterCount = 0;
+	for (uint32_t tile(0); tile < m_tileCount; ++tile)
+	{
+		const std::array<glm::vec4, 5> planes = computeShadowCasterPlanes(m_lightSpaceMatrices[tile]);
+		for (size_t i(0); i < m_clusters.size(); ++i)
+		{
+			VkDrawIndexedIndirectCommand& drawCommand = drawCommands[tile * m_clusters.size() + i];
+			drawCommand.indexCount = m_clusters[i].indexCount;
+			drawCommand.firstIndex = m_clusters[i].firstIndex;
+			drawCommand.vertexOffset = 0;
+			drawCommand.firstInstance = m_useFirstInstance ? tile : 0;
+			drawCommand.instanceCount = m_cullCasters && isSphereOutside(m_clusters[i].boundingSphere, planes.data(), static_cast<uint32_t>(planes.size())) ? 0 : 1;
+			m_visibleCasterCount += drawCommand.instanceCount;
+		}
+	}
+
+	m_drawCommandBuffer->unmap();
+}
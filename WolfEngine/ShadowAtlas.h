@@ -0,0 +1,61 @@
+#pragma once
+
+#include "WolfEngine.h"
+#include "UniformBuffer.h"
+#include "Model.h"
+
+namespace Wolf
+{
+	constexpr uint32_t SHADOW_ATLAS_MAX_TILES = 4;
+
+	// Renders several light views in one depth image (2x2 tiles) with a single render pass.
+	// Every draw is instanced once per tile, the vertex shader moves the geometry to the tile (push constant uint firstTile + gl_InstanceIndex) and clips it to the tile bounds.
+	// firstInstance selects the tile when the device supports multiDrawIndirect and drawIndirectFirstInstance, otherwise each tile is its own mesh with firstTile pushed
+	// (one whole mesh draw per tile, without caster culling, when multiDrawIndirect is missing).
+	class ShadowAtlas
+	{
+	public:
+		ShadowAtlas(Wolf::WolfInstance* engineInstance, Wolf::Scene* scene, const Model* model, uint32_t tileCount, uint32_t tileSize, uint32_t lod = 0, bool cullCasters = true);
+
+		void update(const std::vector<glm::mat4>& lightSpaceMatrices);
+
+		// NDC of a full shadow map -> NDC of its tile, compose with the light matrix to sample the atlas
+		glm::mat4 getTileMatrix(uint32_t tile) const;
+
+		int getCommandBufferID() const { return m_commandBufferID; }
+		Image* getResult() { return m_scene->getRenderPassOutput(m_renderPassID, 0); }
+		uint32_t getVisibleCasterCount() const { return m_visibleCasterCount; }
+
+	private:
+		void updateDrawCommands();
+
+	private:
+		Wolf::WolfInstance* m_engineInstance;
+		Wolf::Scene* m_scene;
+
+		int m_commandBufferID = -2;
+		int m_renderPassID = -1;
+		int m_rendererID = -1;
+		std::vector<int> m_meshIDs; // one per tile when firstInstance can't select the tile
+
+		uint32_t m_tileCount;
+		uint32_t m_columnCount;
+		uint32_t m_rowCount;
+
+		struct UBOData
+		{
+			std::array<glm::mat4, SHADOW_ATLAS_MAX_TILES> tileLightSpaceMatrices; // light matrix with the tile transform
+			std::array<glm::vec4, SHADOW_ATLAS_MAX_TILES> tileBounds; // NDC min xy, max xy, for gl_ClipDistance
+		};
+		UBOData m_uboData;
+		UniformBuffer* m_uniformBuffer;
+		std::array<glm::mat4, SHADOW_ATLAS_MAX_TILES> m_lightSpaceMatrices;
+
+		// One indirect draw per tile and cluster (the whole mesh when the model has no clusters)
+		Buffer* m_drawCommandBuffer = nullptr;
+		bool m_useFirstInstance;
+		std::vector<MeshCluster> m_clusters;
+		bool m_cullCasters;
+		uint32_t m_visibleCasterCount = 0;
+	};
+}
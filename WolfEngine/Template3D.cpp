@@ -3,7 +3,7 @@
 #include <utility>
 
 Wolf::Template3D::Template3D(Wolf::WolfInstance* wolfInstance, Wolf::Scene* scene, std::string modelFilename,
-                             std::string mtlFolder, float ratio) : m_wolfInstance(wolfInstance), m_scene(scene)
+                             std::string mtlFolder, float ratio, bool useDepthPrePass, float targetFrameTime) : m_wolfInstance(wolfInstance), m_scene(scene)
 {
 	// Model creation
 	Model::ModelCreateInfo modelCreateInfo{};
@@ -13,6 +13,7 @@ Wolf::Template3D::Template3D(Wolf::WolfInstance* wolfInstance, Wolf::Scene* scen
 	Model::ModelLoadingInfo modelLoadingInfo;
 	modelLoadingInfo.filename = std::move(modelFilename);
 	modelLoadingInfo.mtlFolder = std::move(mtlFolder);
+	modelLoadingInfo.bindlessTextures = wolfInstance->getBindlessTextures();
 	model->loadObj(modelLoadingInfo);
 
 	// Data
@@ -21,6 +22,15 @@ Wolf::Template3D::Template3D(Wolf::WolfInstance* wolfInstance, Wolf::Scene* scen
 		m_projectionMatrix[1][1] *= -1;
 		m_viewMatrix = glm::lookAt(glm::vec3(-2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 		m_modelMatrix = glm::scale(glm::mat4(1.0f), glm::vec3(0.01f));
+
+		// Targets are allocated at window size, the maximum scale
+		if (targetFrameTime > 0.0f)
+		{
+			m_dynamicResolution = std::make_unique<DynamicResolution>(targetFrameTime);
+			const VkExtent2D scaledExtent = m_scene->getScaledExtent(m_wolfInstance->getWindowSize());
+			m_renderScaleData.scale = glm::vec4(m_scene->getRenderScale(), scaledExtent.width, scaledExtent.height, 0.0f);
+			m_uboRenderScale = m_wolfInstance->createUniformBufferObject(&m_renderScaleData, sizeof(RenderScaleUBO));
+		}
 	}
 
 	// Draw
@@ -31,7 +41,8 @@ Wolf::Template3D::Template3D(Wolf::WolfInstance* wolfInstance, Wolf::Scene* scen
 		commandBufferCreateInfo.commandType = Scene::CommandType::GRAPHICS;
 		m_gBufferCommandBufferID = scene->addCommandBuffer(commandBufferCreateInfo);
 		
-		m_GBuffer = std::make_unique<GBuffer>(wolfInstance, scene, m_gBufferCommandBufferID, wolfInstance->getWindowSize(), VK_SAMPLE_COUNT_1_BIT, model, glm::mat4(1.0f), true);
+		m_GBuffer = std::make_unique<GBuffer>(wolfInstance, scene, m_gBufferCommandBufferID, wolfInstance->getWindowSize(), VK_SAMPLE_COUNT_1_BIT, model, glm::mat4(1.0f), true,
+			useDepthPrePass, m_dynamicResolution != nullptr);
 
 		Image* depth = m_GBuffer->getDepth();
 		Image* albedo = m_GBuffer->getAlbedo();
@@ -41,21 +52,23 @@ Wolf::Template3D::Template3D(Wolf::WolfInstance* wolfInstance, Wolf::Scene* scen
 		commandBufferCreateInfo.finalPipelineStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 		commandBufferCreateInfo.commandType = Scene::CommandType::COMPUTE;
 		m_SSAOCommandBufferID = scene->addCommandBuffer(commandBufferCreateInfo);
-		m_ssao = std::make_unique<SSAO>(wolfInstance, scene, m_SSAOCommandBufferID, wolfInstance->getWindowSize(), m_projectionMatrix, depth, normalRoughnessMetal, 0.1f, 100.0f);
+		m_ssao = std::make_unique<SSAO>(wolfInstance, scene, m_SSAOCommandBufferID, wolfInstance->getWindowSize(), m_projectionMatrix, depth, normalRoughnessMetal, 0.1f, 100.0f,
+			2, true, m_uboRenderScale);
 
 		// CSM
 		m_cascadedShadowMapping = std::make_unique<CascadedShadowMapping>(wolfInstance, scene, model, 0.1f, 100.0f, 32.f, glm::radians(45.0f), m_wolfInstance->getWindowSize(), 
-			depth, m_projectionMatrix);
+			depth, m_projectionMatrix, { nullptr }, CASCADE_COUNT, false, false, m_uboRenderScale);
 
 		// Light Propagation Volume
 		m_lightPropagationVolumes = std::make_unique<LightPropagationVolumes>(wolfInstance, scene, model, m_projectionMatrix, m_modelMatrix, m_lightDir, m_cascadedShadowMapping->getCascadeSplits(),
-			m_cascadedShadowMapping->getDepthTextures());
+			m_cascadedShadowMapping->getDepthTextures(), 32, 3, 64.0f, { 2, 1, 1 });
 
 		// Direct Lighting
 		m_directLightingSSRBloomCommandBufferID = scene->addCommandBuffer(commandBufferCreateInfo);
 		m_directLighting = std::make_unique<DirectLightingPBR>(wolfInstance, scene, m_directLightingSSRBloomCommandBufferID, m_wolfInstance->getWindowSize(), depth,
 			albedo, normalRoughnessMetal, m_cascadedShadowMapping->getOutputShadowMaskTexture(), m_cascadedShadowMapping->getOutputVolumetricLightMaskImage(),
-			m_ssao->getOutputImage(), m_lightPropagationVolumes->getPropagationImage(), m_projectionMatrix, 0.1f, 100.0f);
+			m_ssao->getOutputImage(), m_lightPropagationVolumes->getPropagationImage(), m_projectionMatrix, 0.1f, 100.0f,
+			m_lightPropagationVolumes->getSamplingUniformBuffer(), m_uboRenderScale);
 
 		// Merge
 		Scene::ComputePassCreateInfo mergeComputePassCreateInfo;
@@ -66,6 +79,11 @@ Wolf::Template3D::Template3D(Wolf::WolfInstance* wolfInstance, Wolf::Scene* scen
 
 		DescriptorSetGenerator mergeDescriptorSetGenerator;
 		mergeDescriptorSetGenerator.addImages({ m_directLighting->getOutputImage() }, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT, 0);
+		if (m_uboRenderScale) // upscales the rendered part to the swapchain
+		{
+			mergeComputePassCreateInfo.computeShaderPath = "Shaders/Merge/upscale.spv";
+			mergeDescriptorSetGenerator.addUniformBuffer(m_uboRenderScale, VK_SHADER_STAGE_COMPUTE_BIT, 2);
+		}
 
 		mergeComputePassCreateInfo.descriptorSetCreateInfo = mergeDescriptorSetGenerator.getDescritorSetCreateInfo();
 		mergeComputePassCreateInfo.outputBinding = 1;
@@ -81,13 +99,63 @@ void Wolf::Template3D::update(glm::mat4 view, glm::vec3 cameraPosition, glm::vec
 	m_viewMatrix = view;
 	updateMVP();
 	m_cascadedShadowMapping->updateMatrices(m_lightDir, cameraPosition, cameraOrientation, m_modelMatrix, glm::inverse(m_viewMatrix * m_modelMatrix));
+	m_ssao->update(m_viewMatrix);
+
+	// LPV cascades follow the camera
+	m_lightPropagationVolumes->update(view, m_cascadedShadowMapping->getLightSpaceMatrices(), m_modelMatrix, m_cascadedShadowMapping->getCascadeSplits());
 
-	glm::mat4 voxelProjection = glm::ortho(-32.0f, 32.0f, -4.0f, 16.0f, 0.0f, 64.0f) *
-		glm::lookAt(glm::vec3(0.0f, 0.0f, -32.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-	
 	m_directLighting->update(glm::transpose(glm::inverse(m_viewMatrix)) * glm::vec4(m_lightDir, 1.0f),
-		voxelProjection * glm::inverse(m_viewMatrix));
-	m_lightPropagationVolumes->update(view, m_cascadedShadowMapping->getLightSpaceMatrices(), m_modelMatrix);
+		m_lightPropagationVolumes->getViewToVoxel(0));
+
+	if (m_dynamicResolution)
+		updateRenderScale();
+
+#ifndef NDEBUG
+	logLPVCosts();
+#endif
+}
+
+void Wolf::Template3D::logLPVCosts()
+{
+	// Voxelization used to run every frame (before), it now only runs when the scene moved (after). Requires SceneCreateInfo::enableGPUTimings
+	if (++m_frameIndex % 600 != 0)
+		return;
+
+	const float voxelizationTime = m_lightPropagationVolumes->getVoxelizationGPUTime();
+	const float injectionTime = m_lightPropagationVolumes->getInjectionGPUTime();
+	if (voxelizationTime < 0.0f || injectionTime < 0.0f)
+		return;
+
+	const float voxelizedFrameRatio = m_lightPropagationVolumes->getVoxelizedFrameRatio();
+	Debug::sendInfo("LPV: voxelization " + std::to_string(voxelizationTime) + " ms per frame before, " + std::to_string(voxelizationTime * voxelizedFrameRatio) +
+		" ms on average after (voxelized " + std::to_string(100.0f * voxelizedFrameRatio) + "% of frames, " +
+		std::to_string(m_lightPropagationVolumes->getVoxelizedClusterCount()) + " clusters), injection " + std::to_string(injectionTime) + " ms");
+}
+
+void Wolf::Template3D::updateRenderScale()
+{
+	// Sum of the command buffers submitted last frame, they mostly run one after the other
+	float gpuFrameTime = 0.0f;
+	for (int commandBufferID : m_submittedCommandBuffers)
+	{
+		const float commandBufferTime = m_scene->getCommandBufferGPUTime(commandBufferID);
+		if (commandBufferTime < 0.0f)
+		{
+			gpuFrameTime = -1.0f;
+			break;
+		}
+		gpuFrameTime += commandBufferTime;
+	}
+
+	if (!m_dynamicResolution->update(m_submittedCommandBuffers.empty() ? -1.0f : gpuFrameTime))
+		return;
+
+	m_scene->setRenderScale(m_dynamicResolution->getScale());
+	m_ssao->resetAccumulation();
+
+	const VkExtent2D scaledExtent = m_scene->getScaledExtent(m_wolfInstance->getWindowSize());
+	m_renderScaleData.scale = glm::vec4(m_scene->getRenderScale(), scaledExtent.width, scaledExtent.height, 0.0f);
+	m_uboRenderScale->updateData(&m_renderScaleData);
 }
 
 std::vector<int> Wolf::Template3D::getCommandBufferToSubmit()
@@ -105,6 +173,8 @@ std::vector<int> Wolf::Template3D::getCommandBufferToSubmit()
 	for(auto& commandBuffer : lpvCommandBuffers)
 		r.push_back(commandBuffer);
 	r.push_back(m_directLightingSSRBloomCommandBufferID);
+
+	m_submittedCommandBuffers = r; // GPU time is read back next frame
 	return r;
 }
 
@@ -121,12 +191,17 @@ std::vector<std::pair<int, int>> Wolf::Template3D::getCommandBufferSynchronisati
 	r.emplace_back(m_cascadedShadowMapping->getCascadeCommandBuffers().back(), m_directLightingSSRBloomCommandBufferID);
 
 	std::vector<std::pair<int, int>> ssaoSynchronisation = m_ssao->getCommandBufferSynchronisation();
-	r.emplace_back(m_SSAOCommandBufferID, ssaoSynchronisation[0].first);
-	for (auto& sync : ssaoSynchronisation)
+	if (ssaoSynchronisation.empty()) // blur is recorded in the SSAO command buffer (or not used)
+		r.emplace_back(m_SSAOCommandBufferID, m_directLightingSSRBloomCommandBufferID);
+	else
 	{
-		r.push_back(sync);
+		r.emplace_back(m_SSAOCommandBufferID, ssaoSynchronisation[0].first);
+		for (auto& sync : ssaoSynchronisation)
+		{
+			r.push_back(sync);
+		}
+		r.emplace_back(ssaoSynchronisation.back().second, m_directLightingSSRBloomCommandBufferID);
 	}
-	r.emplace_back(ssaoSynchronisation.back().second, m_directLightingSSRBloomCommandBufferID);
 
 	std::vector<std::pair<int, int>> lpvSync = m_lightPropagationVolumes->getCommandBufferSynchronisations();
 	for (auto& sync : lpvSync)
@@ -135,7 +210,6 @@ std::vector<std::pair<int, int>> Wolf::Template3D::getCommandBufferSynchronisati
 	}
 	
 	r.emplace_back(m_lightPropagationVolumes->getCommandBufferIDs().back(), m_directLightingSSRBloomCommandBufferID);
-	r.emplace_back(m_lightPropagationVolumes->getCommandBufferIDs()[1], m_directLightingSSRBloomCommandBufferID);
 	
 	return r;
 }
@@ -8,22 +8,29 @@
 #include "SSAO.h"
 #include "DirectLightingPBR.h"
 #include "LightPropagationVolumes.h"
+#include "DynamicResolution.h"
 
 namespace Wolf
 {
 	class Template3D
 	{
 	public:
-		Template3D(Wolf::WolfInstance* wolfInstance, Wolf::Scene* scene, std::string modelFilename, std::string mtlFolder, float ratio);
+		// targetFrameTime > 0 (ms): dynamic resolution, screen effects render a scaled part of their targets and Merge upscales it.
+		// Requires SceneCreateInfo::enableGPUTimings
+		Template3D(Wolf::WolfInstance* wolfInstance, Wolf::Scene* scene, std::string modelFilename, std::string mtlFolder, float ratio, bool useDepthPrePass = false,
+			float targetFrameTime = 0.0f);
 
 		void update(glm::mat4 view, glm::vec3 cameraPosition, glm::vec3 cameraOrientation);
 
 		// Getters
 		std::vector<int> getCommandBufferToSubmit();
 		std::vector<std::pair<int, int>> getCommandBufferSynchronisation();
+		float getRenderScale() const { return m_scene->getRenderScale(); }
 
 	private:
 		void updateMVP();
+		void updateRenderScale();
+		void logLPVCosts(); // debug output every 600 frames
 		
 	private:
 		Wolf::WolfInstance* m_wolfInstance;
@@ -49,9 +56,20 @@ namespace Wolf
 		std::unique_ptr<DirectLightingPBR> m_directLighting;
 
 		std::unique_ptr<LightPropagationVolumes> m_lightPropagationVolumes;
+		uint32_t m_frameIndex = 0;
 
 		// Merge
 		int m_mergeComputePassID = -1;
+
+		// Dynamic resolution
+		std::unique_ptr<DynamicResolution> m_dynamicResolution;
+		struct RenderScaleUBO
+		{
+			glm::vec4 scale; // scale, rendered width, rendered height
+		};
+		RenderScaleUBO m_renderScaleData;
+		UniformBuffer* m_uboRenderScale = nullptr;
+		std::vector<int> m_submittedCommandBuffers;
 	};
 }
 
@@ -3,7 +3,7 @@
 #include <glm/gtx/matrix_decompose.hpp>
 
 Wolf::Template3D_VR::Template3D_VR(Wolf::WolfInstance* wolfInstance, Wolf::Scene* scene, std::string modelFilename,
-	std::string mtlFolder) : m_wolfInstance(wolfInstance), m_scene(scene)
+	std::string mtlFolder, bool useMultiview) : m_wolfInstance(wolfInstance), m_scene(scene)
 {
 	// Model creation
 	Model::ModelCreateInfo modelCreateInfo{};
@@ -27,17 +27,19 @@ Wolf::Template3D_VR::Template3D_VR(Wolf::WolfInstance* wolfInstance, Wolf::Scene
 		commandBufferCreateInfo.commandType = Scene::CommandType::GRAPHICS;
 		m_gBufferCommandBufferID = scene->addCommandBuffer(commandBufferCreateInfo);
 
-		m_GBuffer = std::make_unique<GBufferStereoscopic>(wolfInstance, scene, m_gBufferCommandBufferID, wolfInstance->getWindowSize(), VK_SAMPLE_COUNT_1_BIT, model, glm::mat4(1.0f), true);
+		m_GBuffer = std::make_unique<GBufferStereoscopic>(wolfInstance, scene, m_gBufferCommandBufferID, wolfInstance->getWindowSize(), VK_SAMPLE_COUNT_1_BIT, model, glm::mat4(1.0f), true,
+			useMultiview);
 	}
 
 	Image* depth = m_GBuffer->getDepth();
 	Image* albedo = m_GBuffer->getAlbedo();
 	Image* normalRoughnessMetal = m_GBuffer->getNormalRoughnessMetal();
+	const bool layeredGBuffer = m_GBuffer->isMultiview(); // false if multiview is not supported
 
 	// CSM
 	{
 		m_cascadedShadowMapping = std::make_unique<CascadedShadowMappingStereoscopic>(wolfInstance, scene, model, 0.2f, 100.0f, 32.f, glm::radians(45.0f), m_wolfInstance->getWindowSize(),
-			depth, m_wolfInstance->getVRProjMatrices());
+			depth, m_wolfInstance->getVRProjMatrices(), layeredGBuffer);
 	}
 
 	// Direct Lighting
@@ -50,7 +52,7 @@ Wolf::Template3D_VR::Template3D_VR(Wolf::WolfInstance* wolfInstance, Wolf::Scene
  		m_directLightingCommandBufferID = scene->addCommandBuffer(commandBufferCreateInfo);
  		m_directLighting = std::make_unique<DirectLightingStereoscopic>(wolfInstance, scene, m_directLightingCommandBufferID, m_wolfInstance->getWindowSize(), depth,
  			albedo, normalRoughnessMetal, m_cascadedShadowMapping->getOutputShadowMaskImage(), m_cascadedShadowMapping->getOutputVolumetricLightMaskTexture(),
- 			nullptr, nullptr, m_wolfInstance->getVRProjMatrices(), 0.2f, 100.0f);
+ 			nullptr, nullptr, m_wolfInstance->getVRProjMatrices(), 0.2f, 100.0f, layeredGBuffer);
  	}
 
 	// Tone mapping
@@ -10,7 +10,7 @@ namespace Wolf
 	class Template3D_VR
 	{
 	public:
-		Template3D_VR(Wolf::WolfInstance* wolfInstance, Wolf::Scene* scene, std::string modelFilename, std::string mtlFolder);
+		Template3D_VR(Wolf::WolfInstance* wolfInstance, Wolf::Scene* scene, std::string modelFilename, std::string mtlFolder, bool useMultiview = false);
 
 		void update();
 
@@ -1,18 +1,28 @@
 #include "Text.h"
 #include "Debug.h"
 
+#include <algorithm>
+
+namespace
+{
+	constexpr uint32_t MIN_QUAD_CAPACITY = 256;
+	constexpr uint32_t MIN_TEXT_CAPACITY = 16;
+}
+
 Wolf::Text::Text(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, Queue graphicsQueue)
 {
 	m_device = device;
 	m_physicalDevice = physicalDevice;
 	m_commandPool = commandPool;
 	m_graphicsQueue = graphicsQueue;
-
-	m_ubo = std::make_unique<UniformBuffer>(m_device, m_physicalDevice, &m_uboData, sizeof(m_uboData));
 }
 
 Wolf::Text::~Text()
 {
+	if (m_mappedVertices)
+		m_vertexBuffer->unmap();
+	if (m_mappedTextData)
+		m_textDataBuffer->unmap();
 	m_texts.clear();
 }
 
@@ -26,128 +36,219 @@ int Wolf::Text::addWString(std::wstring text, glm::vec2 position, glm::vec3 colo
 void Wolf::Text::updateWString(int textID, std::wstring text)
 {
 #ifdef _DEBUG
-	if (textID < 0 || textID > m_texts.size())
+	if (textID < 0 || textID >= m_texts.size())
 	{
 		Debug::sendError("Wrong text ID");
 	}
 #endif
+	if (m_texts[textID].textValue == text)
+		return;
 	m_texts[textID].textValue = text;
+	m_texts[textID].verticesDirty = true;
 }
 
 void Wolf::Text::build(VkExtent2D outputExtent, Font* font, float size)
 {
-	std::vector<Vertex2DTexturedWithMaterial> vertices;
-	int maxSizeY = font->getMaxSizeY();
-	float scale = (outputExtent.height / static_cast<float>(maxSizeY))* size * 2.0f;
+	m_outputExtent = outputExtent;
+	m_font = font;
+	m_size = size;
 
-	int textID = 0;
-	for (const TextStructure& text : m_texts)
+	for (TextStructure& text : m_texts)
 	{
-		float offsetX = 0.0f;
-		glm::vec2 offset = /*glm::vec3(-1.0f, -1.0f, 0.0f) +*/ text.position;
+		text.verticesDirty = true;
+		text.dataDirty = true;
+	}
 
-		for (const wchar_t& character : text.textValue)
-		{
-			if (character == ' ')
-				offsetX += font->getXSize('a') * 0.5f;
-			else
-			{
-				glm::vec2 topLeft = { offsetX, maxSizeY - font->getYSize(character) + font->getBearingY(character) };
-				glm::vec2 topRight = { offsetX + font->getXSize(character), maxSizeY - font->getYSize(character) + font->getBearingY(character) };
-				glm::vec2 botLeft = { offsetX, maxSizeY + font->getBearingY(character) };
-				glm::vec2 botRight = { offsetX + font->getXSize(character), maxSizeY + font->getBearingY(character) };
-
-				Vertex2DTexturedWithMaterial vertex;
-				vertex.pos = scale * topLeft / glm::vec2(outputExtent.width, outputExtent.height) + offset;
-				vertex.texCoord = glm::vec2(0.0f, 0.0f);
-				vertex.IDs = glm::uvec3(font->getMaterialID(character), textID, 0);
-				vertices.push_back(vertex);
-
-				vertex.pos = scale * topRight / glm::vec2(outputExtent.width, outputExtent.height) + offset;
-				vertex.texCoord = glm::vec2(1.0f, 0.0f);
-				vertex.IDs = glm::uvec3(font->getMaterialID(character), textID, 0);
-				vertices.push_back(vertex);
-
-				vertex.pos = scale * botLeft / glm::vec2(outputExtent.width, outputExtent.height) + offset;
-				vertex.texCoord = glm::vec2(0.0f, 1.0f);
-				vertex.IDs = glm::uvec3(font->getMaterialID(character), textID, 0);
-				vertices.push_back(vertex);
-
-				vertex.pos = scale * botRight / glm::vec2(outputExtent.width, outputExtent.height) + offset;
-				vertex.texCoord = glm::vec2(1.0f, 1.0f);
-				vertex.IDs = glm::uvec3(font->getMaterialID(character), textID, 0);
-				vertices.push_back(vertex);
-
-				offsetX += font->getXSize(character);
-				offsetX += font->getXSize('a') * 0.1f;
-			}
-		}
+	update();
+}
 
-		textID++;
-	}
+bool Wolf::Text::requiresReallocation() const
+{
+	if (!m_vertexBuffer || m_texts.size() > m_textCapacity)
+		return true;
 
-	std::vector<uint32_t> indices;
-	std::vector<uint32_t> indicesPattern = { 0, 2, 1, 1, 2, 3 };
-	for (uint32_t i(0); i < vertices.size(); i += 4)
+	uint32_t usedQuads = m_usedQuads;
+	for (const TextStructure& text : m_texts)
 	{
-		for (const uint32_t& indicePattern : indicesPattern)
-			indices.push_back(indicePattern + i);
+		if (!text.verticesDirty)
+			continue;
+		const uint32_t quadCount = getQuadCount(text.textValue);
+		if (quadCount > text.quadCapacity)
+			usedQuads += getSlotSize(quadCount);
 	}
 
-	m_mesh.loadFromVertices(m_device, m_physicalDevice, m_commandPool, m_graphicsQueue, vertices, indices);
+	return usedQuads > m_quadCapacity;
+}
+
+void Wolf::Text::update()
+{
+	if (!m_font)
+		return;
+
+	if (requiresReallocation())
+		reallocate();
 
-	for (int i(0); i < m_texts.size(); ++i)
+	m_dirtyTextIDs.clear();
+	m_dirtyStrings.clear();
+	for (uint32_t i(0); i < m_texts.size(); ++i)
 	{
-		m_uboData.color[i] = glm::vec4(m_texts[i].color, 0.0f);
-		m_uboData.posOffset[i] = glm::vec4(0.0f);
+		TextStructure& text = m_texts[i];
+		if (text.verticesDirty)
+		{
+			// Slot too small: moved at the end, the old one is left degenerate
+			const uint32_t quadCount = getQuadCount(text.textValue);
+			if (quadCount > text.quadCapacity)
+			{
+				if (text.quadCapacity > 0)
+					memset(m_mappedVertices + 4 * text.firstQuad, 0, 4 * sizeof(Vertex2DTexturedWithMaterial) * text.quadCapacity);
+				text.firstQuad = m_usedQuads;
+				text.quadCapacity = getSlotSize(quadCount);
+				m_usedQuads += text.quadCapacity;
+			}
+
+			m_dirtyTextIDs.push_back(i);
+			m_dirtyStrings.push_back(&text.textValue);
+			text.verticesDirty = false;
+		}
+		if (text.dataDirty)
+		{
+			writeTextData(i);
+			text.dataDirty = false;
+		}
 	}
-	m_ubo->updateData(&m_uboData);
+
+	// Changed strings are laid out in one batch
+	m_font->layout(m_dirtyStrings.data(), m_dirtyStrings.size(), m_glyphLayout);
+	for (uint32_t i(0); i < m_dirtyTextIDs.size(); ++i)
+		writeString(m_dirtyTextIDs[i], i);
 }
 
 float Wolf::Text::simulateSizeX(std::wstring text, VkExtent2D outputExtent, Font* font, float maxSize)
 {
-	float offsetX = 0.0f;
 	int maxSizeY = font->getMaxSizeY();
 	float scale = (outputExtent.height / static_cast<float>(maxSizeY))* maxSize * 2.0f;
 
-	for (const wchar_t& character : text)
-	{
-		if (character == ' ')
-			offsetX += font->getXSize('a') * 0.5f;
-		else
-		{
-			offsetX += font->getXSize(character);
-			offsetX += font->getXSize('a') * 0.1f;
-		}
-	}
+	return scale * font->getWidth(text) / outputExtent.width;
+}
 
-	return scale * offsetX / outputExtent.width;
+Wolf::VertexBuffer Wolf::Text::getVertexBuffer() const
+{
+	if (!m_vertexBuffer)
+		return { VK_NULL_HANDLE, 0, VK_NULL_HANDLE, 0 };
+	return { m_vertexBuffer->getBuffer(), 4 * m_quadCapacity, m_indexBuffer->getBuffer(), 6 * m_quadCapacity };
 }
 
 void Wolf::Text::setColor(VkDevice device, unsigned ID, glm::vec3 color)
 {
 	m_texts[ID].color = color;
-	updateUBO(device);
+	writeTextData(ID);
 }
 
 void Wolf::Text::translate(VkDevice device, unsigned ID, glm::vec2 offset)
 {
 	m_texts[ID].posOffset += offset;
-	updateUBO(device);
+	writeTextData(ID);
 }
 
 void Wolf::Text::setPosOffset(VkDevice device, unsigned ID, glm::vec2 offset)
 {
 	m_texts[ID].posOffset = offset;
-	updateUBO(device);
+	writeTextData(ID);
 }
 
-void Wolf::Text::updateUBO(VkDevice device)
+uint32_t Wolf::Text::getQuadCount(const std::wstring& text)
 {
-	for (int i(0); i < m_texts.size(); ++i)
+	return static_cast<uint32_t>(text.size() - std::count(text.begin(), text.end(), L' '));
+}
+
+void Wolf::Text::reallocate()
+{
+	// Slots are compacted
+	uint32_t quadCount = 0;
+	for (const TextStructure& text : m_texts)
+		quadCount += getSlotSize(getQuadCount(text.textValue));
+
+	if (quadCount > m_quadCapacity || !m_vertexBuffer)
 	{
-		m_uboData.color[i] = glm::vec4(m_texts[i].color, 0.0f);
-		m_uboData.posOffset[i] = glm::vec4(m_texts[i].posOffset, 0.0f, 0.0f);
+		if (m_mappedVertices)
+			m_vertexBuffer->unmap();
+
+		m_quadCapacity = std::max(MIN_QUAD_CAPACITY, 2 * quadCount);
+		m_vertexBuffer = std::make_unique<Buffer>(m_device, m_physicalDevice, m_commandPool, m_graphicsQueue, 4 * sizeof(Vertex2DTexturedWithMaterial) * m_quadCapacity,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		m_vertexBuffer->map(reinterpret_cast<void**>(&m_mappedVertices));
+
+		m_indexBuffer = std::make_unique<Buffer>(m_device, m_physicalDevice, m_commandPool, m_graphicsQueue, 6 * sizeof(uint32_t) * m_quadCapacity,
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		uint32_t* indices;
+		m_indexBuffer->map(reinterpret_cast<void**>(&indices));
+		const std::array<uint32_t, 6> indicesPattern = { 0, 2, 1, 1, 2, 3 };
+		for (uint32_t i(0); i < m_quadCapacity; ++i)
+		{
+			for (uint32_t j(0); j < indicesPattern.size(); ++j)
+				indices[6 * i + j] = indicesPattern[j] + 4 * i;
+		}
+		m_indexBuffer->unmap();
 	}
-	m_ubo->updateData(&m_uboData);
+	memset(m_mappedVertices, 0, 4 * sizeof(Vertex2DTexturedWithMaterial) * m_quadCapacity);
+
+	m_usedQuads = 0;
+	for (TextStructure& text : m_texts)
+	{
+		text.quadCapacity = 0;
+		text.verticesDirty = true;
+	}
+
+	if (m_texts.size() > m_textCapacity || !m_textDataBuffer)
+	{
+		if (m_mappedTextData)
+			m_textDataBuffer->unmap();
+
+		m_textCapacity = std::max(MIN_TEXT_CAPACITY, 2 * static_cast<uint32_t>(m_texts.size()));
+		m_textDataBuffer = std::make_unique<Buffer>(m_device, m_physicalDevice, m_commandPool, m_graphicsQueue, sizeof(TextData) * m_textCapacity,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+		m_textDataBuffer->map(reinterpret_cast<void**>(&m_mappedTextData));
+
+		for (TextStructure& text : m_texts)
+			text.dataDirty = true;
+	}
+}
+
+void Wolf::Text::writeString(uint32_t textID, uint32_t layoutID)
+{
+	const TextStructure& text = m_texts[textID];
+	const float scale = (m_outputExtent.height / static_cast<float>(m_font->getMaxSizeY())) * m_size * 2.0f;
+	const glm::vec2 toScreen = scale / glm::vec2(m_outputExtent.width, m_outputExtent.height);
+
+	Vertex2DTexturedWithMaterial* vertices = m_mappedVertices + 4 * text.firstQuad;
+	const uint32_t firstGlyph = m_glyphLayout.firstGlyphs[layoutID];
+	const uint32_t quadCount = m_glyphLayout.firstGlyphs[layoutID + 1] - firstGlyph;
+	for (uint32_t i(0); i < quadCount; ++i)
+	{
+		const uint32_t glyph = firstGlyph + i;
+		const glm::vec2 topLeft = glm::vec2(m_glyphLayout.minX[glyph], m_glyphLayout.minY[glyph]) * toScreen + text.position;
+		const glm::vec2 botRight = glm::vec2(m_glyphLayout.maxX[glyph], m_glyphLayout.maxY[glyph]) * toScreen + text.position;
+
+		const Font::Glyph& fontGlyph = m_font->getGlyph(m_glyphLayout.glyphIndices[glyph]);
+		const glm::uvec3 IDs = glm::uvec3(fontGlyph.page, textID, 0);
+
+		Vertex2DTexturedWithMaterial* quad = vertices + 4 * i;
+		quad[0] = { topLeft, fontGlyph.uvMin, IDs };
+		quad[1] = { glm::vec2(botRight.x, topLeft.y), glm::vec2(fontGlyph.uvMax.x, fontGlyph.uvMin.y), IDs };
+		quad[2] = { glm::vec2(topLeft.x, botRight.y), glm::vec2(fontGlyph.uvMin.x, fontGlyph.uvMax.y), IDs };
+		quad[3] = { botRight, fontGlyph.uvMax, IDs };
+	}
+
+	// Remaining quads of the slot don't produce fragments
+	memset(vertices + 4 * quadCount, 0, 4 * sizeof(Vertex2DTexturedWithMaterial) * (text.quadCapacity - quadCount));
+}
+
+void Wolf::Text::writeTextData(uint32_t textID)
+{
+	// Texts added since the last update are written by the next one
+	if (textID >= m_textCapacity)
+		return;
+
+	m_mappedTextData[textID].color = glm::vec4(m_texts[textID].color, 0.0f);
+	m_mappedTextData[textID].posOffset = glm::vec4(m_texts[textID].posOffset, 0.0f, 0.0f);
 }
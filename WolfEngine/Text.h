@@ -2,11 +2,14 @@
 
 #include "Mesh.h"
 #include "Font.h"
-#include "UniformBuffer.h"
+#include "Buffer.h"
 #include "InputVertexTemplate.h"
 
 namespace Wolf
 {
+	// Strings live in slots of persistent host visible buffers: updates rewrite the changed strings in place, without allocation.
+	// Unused quads of a slot are degenerate, the whole vertex buffer is drawn so that the recorded draw stays valid.
+	// Per string data (binding 0, vertex stage) is a storage buffer: struct { vec4 color; vec4 posOffset; } texts[], indexed by vertex IDs.y
 	class Text : public VulkanElement
 	{
 	public:
@@ -15,19 +18,28 @@ namespace Wolf
 
 		int addWString(std::wstring text, glm::vec2 position, glm::vec3 color);
 		void updateWString(int textID, std::wstring text);
-		void build(VkExtent2D outputExtent, Font* font, float size);
+		void build(VkExtent2D outputExtent, Font* font, float size); // first layout, then updateWString + update (see Scene::updateText)
+
+		// Strings changed since the last update are written in their slots, reallocation only happens when the buffers are too small
+		bool requiresReallocation() const;
+		void update();
 
 		float simulateSizeX(std::wstring text, VkExtent2D outputExtent, Font* font, float maxSize);
 
-		VertexBuffer getVertexBuffer() { return m_mesh.getVertexBuffer(); }
-		UniformBuffer* getUBO() const { return m_ubo.get(); }
+		VertexBuffer getVertexBuffer() const;
+		Buffer* getTextDataBuffer() const { return m_textDataBuffer.get(); }
 
 		void setColor(VkDevice device, unsigned int ID, glm::vec3 color);
 		void translate(VkDevice device, unsigned int ID, glm::vec2 offset);
 		void setPosOffset(VkDevice device, unsigned int ID, glm::vec2 offset);
 
 	private:
-		void updateUBO(VkDevice device);
+		static uint32_t getQuadCount(const std::wstring& text);
+		static uint32_t getSlotSize(uint32_t quadCount) { return quadCount + std::max(quadCount / 2, 4u); } // room for strings growing a bit (ex: counters)
+
+		void reallocate();
+		void writeString(uint32_t textID, uint32_t layoutID); // layoutID: string in m_glyphLayout
+		void writeTextData(uint32_t textID);
 
 	private:
 		struct TextStructure
@@ -37,18 +49,35 @@ namespace Wolf
 			std::wstring textValue;
 			glm::vec3 color;
 
+			uint32_t firstQuad = 0;
+			uint32_t quadCapacity = 0;
+			bool verticesDirty = true;
+			bool dataDirty = true;
+
 			TextStructure(const glm::vec2 pos, std::wstring text, glm::vec3 color) : position(pos), textValue(std::move(text)), color(color) {}
 		};
 		std::vector<TextStructure> m_texts;
 
-		Mesh<Vertex2DTexturedWithMaterial> m_mesh;
-		std::unique_ptr<UniformBuffer> m_ubo;
+		Font* m_font = nullptr;
+		Font::GlyphLayout m_glyphLayout;
+		std::vector<uint32_t> m_dirtyTextIDs;
+		std::vector<const std::wstring*> m_dirtyStrings;
+		VkExtent2D m_outputExtent = { 0, 0 };
+		float m_size = 0.0f;
+
+		std::unique_ptr<Buffer> m_vertexBuffer;
+		std::unique_ptr<Buffer> m_indexBuffer;
+		Vertex2DTexturedWithMaterial* m_mappedVertices = nullptr;
+		uint32_t m_quadCapacity = 0;
+		uint32_t m_usedQuads = 0;
 
-		struct TextUBO
+		struct TextData
 		{
-			std::array<glm::vec4, 128> color;
-			std::array<glm::vec4, 128> posOffset;
+			glm::vec4 color;
+			glm::vec4 posOffset;
 		};
-		TextUBO m_uboData;
+		std::unique_ptr<Buffer> m_textDataBuffer;
+		TextData* m_mappedTextData = nullptr;
+		uint32_t m_textCapacity = 0;
 	};
 }
@@ -1,6 +1,8 @@
 #include "Vulkan.h"
 #include "Debug.h"
 
+#include <algorithm>
+
 static VkDevice s_global_device = VK_NULL_HANDLE;
 
 VKAPI_ATTR void VKAPI_CALL
@@ -13,6 +15,52 @@ vkCmdDrawMeshTasksNV(VkCommandBuffer                             commandBuffer,
 	return call(commandBuffer, taskCount, firstTask);
 }
 
+VKAPI_ATTR void VKAPI_CALL
+vkCmdDrawIndexedIndirectCountKHR(VkCommandBuffer                  commandBuffer,
+	VkBuffer                                    buffer,
+	VkDeviceSize                                offset,
+	VkBuffer                                    countBuffer,
+	VkDeviceSize                                countBufferOffset,
+	uint32_t                                    maxDrawCount,
+	uint32_t                                    stride)
+{
+	static const auto call = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+		vkGetDeviceProcAddr(s_global_device, "vkCmdDrawIndexedIndirectCountKHR"));
+	return call(commandBuffer, buffer, offset, countBuffer, countBufferOffset, maxDrawCount, stride);
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkCreateDescriptorUpdateTemplateKHR(VkDevice                device,
+	const VkDescriptorUpdateTemplateCreateInfo*         pCreateInfo,
+	const VkAllocationCallbacks*                        pAllocator,
+	VkDescriptorUpdateTemplate*                         pDescriptorUpdateTemplate)
+{
+	static const auto call = reinterpret_cast<PFN_vkCreateDescriptorUpdateTemplateKHR>(
+		vkGetDeviceProcAddr(s_global_device, "vkCreateDescriptorUpdateTemplateKHR"));
+	return call(device, pCreateInfo, pAllocator, pDescriptorUpdateTemplate);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkDestroyDescriptorUpdateTemplateKHR(VkDevice                 device,
+	VkDescriptorUpdateTemplate                          descriptorUpdateTemplate,
+	const VkAllocationCallbacks*                        pAllocator)
+{
+	static const auto call = reinterpret_cast<PFN_vkDestroyDescriptorUpdateTemplateKHR>(
+		vkGetDeviceProcAddr(s_global_device, "vkDestroyDescriptorUpdateTemplateKHR"));
+	return call(device, descriptorUpdateTemplate, pAllocator);
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkUpdateDescriptorSetWithTemplateKHR(VkDevice                 device,
+	VkDescriptorSet                                     descriptorSet,
+	VkDescriptorUpdateTemplate                          descriptorUpdateTemplate,
+	const void*                                         pData)
+{
+	static const auto call = reinterpret_cast<PFN_vkUpdateDescriptorSetWithTemplateKHR>(
+		vkGetDeviceProcAddr(s_global_device, "vkUpdateDescriptorSetWithTemplateKHR"));
+	return call(device, descriptorSet, descriptorUpdateTemplate, pData);
+}
+
 Wolf::Vulkan::Vulkan(GLFWwindow* glfwWindowPointer, bool useOVR)
 {
 	if (useOVR)
@@ -47,6 +95,10 @@ Wolf::Vulkan::Vulkan(GLFWwindow* glfwWindowPointer, bool useOVR)
 		"VK_KHR_external_semaphore_win32", VK_KHR_GET_MEMORY_REQUIREMENTS_2_EXTENSION_NAME, "VK_KHR_external_fence", "VK_KHR_external_fence_win32" };
 	m_raytracingDeviceExtensions = { VK_NV_RAY_TRACING_EXTENSION_NAME };
 	m_meshShaderDeviceExtensions = { VK_NV_MESH_SHADER_EXTENSION_NAME };
+	m_drawIndirectCountDeviceExtensions = { VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME };
+	m_descriptorIndexingDeviceExtensions = { VK_KHR_MAINTENANCE3_EXTENSION_NAME, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME };
+	m_descriptorUpdateTemplateDeviceExtensions = { VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME };
+	m_multiviewDeviceExtensions = { VK_KHR_MULTIVIEW_EXTENSION_NAME };
 
 	pickPhysicalDevice();
 	createDevice();
@@ -81,7 +133,13 @@ void Wolf::Vulkan::createInstance()
 	appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 	appInfo.pEngineName = "Wolf Engine";
 	appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-	appInfo.apiVersion = VK_API_VERSION_1_0;
+	// Vulkan 1.1 when the loader supports it (subgroup operations), 1.0 loaders don't have vkEnumerateInstanceVersion
+	m_instanceApiVersion = VK_API_VERSION_1_0;
+	PFN_vkEnumerateInstanceVersion vkEnumerateInstanceVersion = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+	uint32_t loaderApiVersion;
+	if (vkEnumerateInstanceVersion && vkEnumerateInstanceVersion(&loaderApiVersion) == VK_SUCCESS && loaderApiVersion >= VK_API_VERSION_1_1)
+		m_instanceApiVersion = VK_API_VERSION_1_1;
+	appInfo.apiVersion = m_instanceApiVersion;
 
 	VkInstanceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -148,6 +206,10 @@ void Wolf::Vulkan::pickPhysicalDevice()
 		{
 			m_hardwareCapabilities.rayTracingAvailable = isDeviceSuitable(device, m_surface, m_raytracingDeviceExtensions, m_hardwareCapabilities);
 			m_hardwareCapabilities.meshShaderAvailable = isDeviceSuitable(device, m_surface, m_meshShaderDeviceExtensions, m_hardwareCapabilities);
+			m_hardwareCapabilities.drawIndirectCountAvailable = isDeviceSuitable(device, m_surface, m_drawIndirectCountDeviceExtensions, m_hardwareCapabilities);
+			m_hardwareCapabilities.bindlessTexturesAvailable = isDeviceSuitable(device, m_surface, m_descriptorIndexingDeviceExtensions, m_hardwareCapabilities);
+			m_hardwareCapabilities.descriptorUpdateTemplateAvailable = isDeviceSuitable(device, m_surface, m_descriptorUpdateTemplateDeviceExtensions, m_hardwareCapabilities);
+			m_hardwareCapabilities.multiviewAvailable = isDeviceSuitable(device, m_surface, m_multiviewDeviceExtensions, m_hardwareCapabilities);
 
 			if (m_hardwareCapabilities.rayTracingAvailable)
 				for (int i(0); i < m_raytracingDeviceExtensions.size(); ++i)
@@ -157,6 +219,22 @@ void Wolf::Vulkan::pickPhysicalDevice()
 				for (int i(0); i < m_meshShaderDeviceExtensions.size(); ++i)
 					m_deviceExtensions.push_back(m_meshShaderDeviceExtensions[i]);
 
+			if (m_hardwareCapabilities.drawIndirectCountAvailable)
+				for (int i(0); i < m_drawIndirectCountDeviceExtensions.size(); ++i)
+					m_deviceExtensions.push_back(m_drawIndirectCountDeviceExtensions[i]);
+
+			if (m_hardwareCapabilities.bindlessTexturesAvailable)
+				for (int i(0); i < m_descriptorIndexingDeviceExtensions.size(); ++i)
+					m_deviceExtensions.push_back(m_descriptorIndexingDeviceExtensions[i]);
+
+			if (m_hardwareCapabilities.descriptorUpdateTemplateAvailable)
+				for (int i(0); i < m_descriptorUpdateTemplateDeviceExtensions.size(); ++i)
+					m_deviceExtensions.push_back(m_descriptorUpdateTemplateDeviceExtensions[i]);
+
+			if (m_hardwareCapabilities.multiviewAvailable)
+				for (int i(0); i < m_multiviewDeviceExtensions.size(); ++i)
+					m_deviceExtensions.push_back(m_multiviewDeviceExtensions[i]);
+
 			m_physicalDevice = device;
 			m_maxMsaaSamples = getMaxUsableSampleCount(m_physicalDevice);
 
@@ -203,14 +281,49 @@ void Wolf::Vulkan::createDevice()
 	deviceFeatures.sampleRateShading = VK_TRUE;
 	deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;*/
 
+	// Only chained when VK_KHR_multiview is enabled, otherwise stereo passes fall back to one renderer per eye
+	VkPhysicalDeviceMultiviewFeaturesKHR multiviewFeatures = {};
+	multiviewFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES_KHR;
+
 	VkPhysicalDeviceDescriptorIndexingFeaturesEXT descIndexFeatures = {};
 	descIndexFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	descIndexFeatures.pNext = m_hardwareCapabilities.multiviewAvailable ? &multiviewFeatures : nullptr;
 
 	VkPhysicalDeviceFeatures2 supportedFeatures = {};
 	supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
 	supportedFeatures.pNext = &descIndexFeatures;
 	supportedFeatures.features.shaderStorageImageMultisample = VK_TRUE;
 	vkGetPhysicalDeviceFeatures2(m_physicalDevice, &supportedFeatures);
+	m_hardwareCapabilities.multiDrawIndirectAvailable = supportedFeatures.features.multiDrawIndirect == VK_TRUE;
+	m_hardwareCapabilities.drawIndirectFirstInstanceAvailable = supportedFeatures.features.drawIndirectFirstInstance == VK_TRUE;
+	m_hardwareCapabilities.multiviewAvailable = m_hardwareCapabilities.multiviewAvailable && multiviewFeatures.multiview == VK_TRUE;
+	m_hardwareCapabilities.bindlessTexturesAvailable = m_hardwareCapabilities.bindlessTexturesAvailable && descIndexFeatures.runtimeDescriptorArray &&
+		descIndexFeatures.shaderSampledImageArrayNonUniformIndexing && descIndexFeatures.descriptorBindingPartiallyBound &&
+		descIndexFeatures.descriptorBindingSampledImageUpdateAfterBind && descIndexFeatures.descriptorBindingUpdateUnusedWhilePending &&
+		descIndexFeatures.descriptorBindingVariableDescriptorCount;
+
+	// Subgroup properties are Vulkan 1.1: not queried when the instance or the device is 1.0, subgroupQuadAvailable stays false (Blur reduces in shared memory only)
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(m_physicalDevice, &deviceProperties);
+	if (std::min(m_instanceApiVersion, deviceProperties.apiVersion) >= VK_API_VERSION_1_1)
+	{
+		PFN_vkGetPhysicalDeviceProperties2KHR vkGetPhysicalDeviceProperties2KHR =
+			reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2KHR>(vkGetInstanceProcAddr(m_instance, "vkGetPhysicalDeviceProperties2KHR"));
+
+		VkPhysicalDeviceSubgroupProperties subgroupProperties = {};
+		subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+
+		VkPhysicalDeviceProperties2KHR properties = {};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+		properties.pNext = &subgroupProperties;
+		if (vkGetPhysicalDeviceProperties2KHR)
+		{
+			vkGetPhysicalDeviceProperties2KHR(m_physicalDevice, &properties);
+			m_hardwareCapabilities.subgroupSize = subgroupProperties.subgroupSize;
+			m_hardwareCapabilities.subgroupQuadAvailable = (subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+				(subgroupProperties.supportedOperations & VK_SUBGROUP_FEATURE_QUAD_BIT);
+		}
+	}
 
 	VkDeviceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -68,6 +68,7 @@ namespace Wolf
 	private:
 		/* Vulkan attributes */
 		VkInstance m_instance;
+		uint32_t m_instanceApiVersion = VK_API_VERSION_1_0;
 		VkSurfaceKHR m_surface;
 		VkPhysicalDevice m_physicalDevice;
 		VkDevice m_device;
@@ -95,6 +96,16 @@ namespace Wolf
 		std::vector<const char*> m_meshShaderDeviceExtensions = std::vector<const char*>();
 		VkPhysicalDeviceMeshShaderPropertiesNV m_meshShaderProperties = {};
 
+		/* Indirect Draw */
+		std::vector<const char*> m_drawIndirectCountDeviceExtensions = std::vector<const char*>();
+
+		/* Multiview */
+		std::vector<const char*> m_multiviewDeviceExtensions = std::vector<const char*>();
+
+		/* Bindless */
+		std::vector<const char*> m_descriptorIndexingDeviceExtensions = std::vector<const char*>();
+		std::vector<const char*> m_descriptorUpdateTemplateDeviceExtensions = std::vector<const char*>();
+
 		/* Properties */
 		VkSampleCountFlagBits m_maxMsaaSamples = VK_SAMPLE_COUNT_1_BIT;
 		HardwareCapabilities m_hardwareCapabilities;
@@ -29,6 +29,14 @@ struct HardwareCapabilities
 {
 	bool rayTracingAvailable = false;
 	bool meshShaderAvailable = false;
+	bool drawIndirectCountAvailable = false;
+	bool multiDrawIndirectAvailable = false; // drawCount > 1 in indirect draws
+	bool drawIndirectFirstInstanceAvailable = false; // nonzero firstInstance in indirect draw commands
+	bool multiviewAvailable = false;
+	bool descriptorUpdateTemplateAvailable = false;
+	bool bindlessTexturesAvailable = false; // descriptor indexing: partially bound, update after bind, variable count sampled image arrays
+	uint32_t subgroupSize = 0;
+	bool subgroupQuadAvailable = false; // quad operations in compute shaders
 	VkDeviceSize VRAMSize = 0;
 };
 
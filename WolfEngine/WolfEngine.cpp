@@ -25,6 +25,15 @@ Wolf::WolfInstance::WolfInstance(WolfInstanceCreateInfo createInfo)
 	{
 		m_ovr = std::make_unique<OVR>(m_vulkan->getDevice(), m_graphicsCommandPool.getCommandPool(), m_vulkan->getGraphicsQueue(), m_vulkan->getOVRSession(), m_vulkan->getGraphicsLuid());
 	}
+
+	setDescriptorUpdateTemplatesEnabled(m_vulkan->getHardwareCapabilities().descriptorUpdateTemplateAvailable);
+
+	if (m_vulkan->getHardwareCapabilities().bindlessTexturesAvailable)
+	{
+		m_bindlessTextures = std::make_unique<BindlessTextures>(m_vulkan->getDevice());
+		m_bindlessSampler = std::make_unique<Sampler>(m_vulkan->getDevice(), VK_SAMPLER_ADDRESS_MODE_REPEAT, 16.0f, VK_FILTER_LINEAR);
+		m_bindlessTextures->setSampler(m_bindlessSampler.get());
+	}
 }
 
 Wolf::Scene* Wolf::WolfInstance::createScene(Scene::SceneCreateInfo createInfo)
@@ -50,6 +59,12 @@ Wolf::Buffer* Wolf::WolfInstance::createBuffer(VkDeviceSize size, VkBufferUsageF
 	return m_buffers.back().get();
 }
 
+std::unique_ptr<Wolf::Buffer> Wolf::WolfInstance::createStagingBuffer(VkDeviceSize size)
+{
+	return std::make_unique<Buffer>(m_vulkan->getDevice(), m_vulkan->getPhysicalDevice(), m_graphicsCommandPool.getCommandPool(), m_vulkan->getGraphicsQueue(), size,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
 Wolf::Image* Wolf::WolfInstance::createImageFromFile(std::string filename)
 {
 	m_images.push_back(std::make_unique<Image>(m_vulkan->getDevice(), m_vulkan->getPhysicalDevice(), m_graphicsCommandPool.getCommandPool(), m_vulkan->getGraphicsQueue(), 
@@ -72,10 +87,10 @@ Wolf::Sampler* Wolf::WolfInstance::createSampler(VkSamplerAddressMode addressMod
 	return m_samplers.back().get();
 }
 
-Wolf::Font* Wolf::WolfInstance::createFont(int ySize, std::string path)
+Wolf::Font* Wolf::WolfInstance::createFont(int ySize, std::string path, bool signedDistanceField, const std::wstring& extraCharacters)
 {
 	m_fonts.push_back(std::make_unique<Font>(m_vulkan->getDevice(), m_vulkan->getPhysicalDevice(), m_graphicsCommandPool.getCommandPool(), m_vulkan->getGraphicsQueue(),
-		ySize, path));
+		ySize, path, signedDistanceField, extraCharacters));
 
 	return m_fonts[m_fonts.size() - 1].get();
 }
@@ -13,6 +13,7 @@
 #include "OVR.h"
 #include "AccelerationStructure.h"
 #include "Buffer.h"
+#include "BindlessTextures.h"
 
 #include "Model2D.h"
 #include "Model2DTextured.h"
@@ -48,6 +49,7 @@ namespace Wolf
 		Instance<T>* createInstanceBuffer();
 		UniformBuffer* createUniformBufferObject(void* data, VkDeviceSize size);
 		Buffer* createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memoryPropertyFlags);
+		std::unique_ptr<Buffer> createStagingBuffer(VkDeviceSize size); // host visible transfer source owned by the caller, destroyed once the copy is done
 
 		// Image creation
 		Image* createImageFromFile(std::string filename);
@@ -56,7 +58,7 @@ namespace Wolf
 		// Sampler creation
 		Sampler* createSampler(VkSamplerAddressMode addressMode, float mipLevels, VkFilter filter, float maxAnisotropy = 16.0f, float minLod = 0.0f, float mipLodBias = 0.0f);
 		
-		Font* createFont(int ySize, std::string path);
+		Font* createFont(int ySize, std::string path, bool signedDistanceField = false, const std::wstring& extraCharacters = L""); // SDF: ySize is the base size, ~48 serves every text size
 		Text* createText();
 
 		AccelerationStructure* createAccelerationStructure(std::vector<BottomLevelAccelerationStructure::GeometryInfo> geometryInfos, 
@@ -81,6 +83,8 @@ namespace Wolf
 		std::array < glm::vec3, 2>& getVREyeDirections() { return m_ovr->getEyeDirections(); }
 		void setVRPlayerPosition(glm::vec3 playerPosition) { m_ovr->setPlayerPos(playerPosition); }
 		VkExtent2D getWindowSize();
+		HardwareCapabilities getHardwareCapabilities() { return m_vulkan->getHardwareCapabilities(); }
+		BindlessTextures* getBindlessTextures() { return m_bindlessTextures.get(); } // nullptr if descriptor indexing isn't supported
 
 	private:
 		static void windowResizeCallback(void* systemManagerInstance, int width, int height)
@@ -109,6 +113,9 @@ namespace Wolf
 		std::vector<std::unique_ptr<AccelerationStructure>> m_accelerationStructures;
 		std::vector<std::unique_ptr<Buffer>> m_buffers;
 
+		std::unique_ptr<BindlessTextures> m_bindlessTextures;
+		std::unique_ptr<Sampler> m_bindlessSampler;
+
 		bool m_needResize = false;
 
 	private:
@@ -0,0 +1,151 @@
+// CPU checks of the font layout (see FontLayout.h) on synthetic metrics: glyph table, dense and sparse kerning, layout against getWidth,
+// and layout time of 256 strings of 32 characters. Returns the number of failed checks
+
+#include <iostream>
+#include <cmath>
+#include <chrono>
+#include <string>
+
+#include "FontLayout.h"
+
+namespace
+{
+	int failureCount = 0;
+
+	void check(bool condition, const std::string& message)
+	{
+		if (!condition)
+		{
+			std::cout << "FAILED: " << message << std::endl;
+			failureCount++;
+		}
+	}
+
+	// Metrics are filled by Font from FreeType, here they are generated
+	class TestFontLayout : public Wolf::FontLayout
+	{
+	public:
+		TestFontLayout(int ySize, const std::wstring& extraCharacters)
+		{
+			m_maxYSize = ySize;
+			m_sdfSpread = 2;
+
+			for (wchar_t c = FIRST_CHARACTER; c <= LAST_CHARACTER; ++c)
+				addGlyph(c);
+			for (const wchar_t c : extraCharacters)
+			{
+				m_extraGlyphIndices[c] = static_cast<uint32_t>(m_glyphs.size());
+				addGlyph(c);
+			}
+
+			m_spaceAdvance = static_cast<float>(getXSize('a')) * 0.5f;
+			m_letterSpacing = static_cast<float>(getXSize('a')) * 0.1f;
+
+			// Some pairs of every kind
+			m_kerning.resize(BASIC_GLYPH_COUNT * BASIC_GLYPH_COUNT, 0.0f);
+			m_kerning[getGlyphIndex('A') * BASIC_GLYPH_COUNT + getGlyphIndex('V')] = -3.0f;
+			m_kerning[getGlyphIndex('T') * BASIC_GLYPH_COUNT + getGlyphIndex('o')] = -2.0f;
+			if (!extraCharacters.empty())
+			{
+				const uint32_t extraGlyphIndex = getGlyphIndex(extraCharacters[0]);
+				m_extraKerning[getKerningKey(getGlyphIndex('T'), extraGlyphIndex)] = -1.5f;
+				m_extraKerning[getKerningKey(extraGlyphIndex, extraGlyphIndex)] = 0.5f;
+			}
+		}
+
+	private:
+		void addGlyph(wchar_t c)
+		{
+			Glyph glyph;
+			glyph.xSize = 8 + static_cast<unsigned int>(c) % 7;
+			glyph.ySize = static_cast<unsigned int>(m_maxYSize) - static_cast<unsigned int>(c) % 5;
+			glyph.bearingX = 1;
+			glyph.bearingY = static_cast<int>(c) % 3;
+			m_glyphs.push_back(glyph);
+		}
+	};
+
+	void checkKerning(const TestFontLayout& font, const std::wstring& extraCharacters)
+	{
+		check(font.getKerning(font.getGlyphIndex('A'), font.getGlyphIndex('V')) == -3.0f, "Dense kerning pair lost");
+		check(font.getKerning(font.getGlyphIndex('V'), font.getGlyphIndex('A')) == 0.0f, "Dense kerning is not ordered");
+		check(font.getKerning(font.getGlyphIndex('T'), font.getGlyphIndex(extraCharacters[0])) == -1.5f, "Sparse kerning pair lost");
+		check(font.getKerning(font.getGlyphIndex(extraCharacters[0]), font.getGlyphIndex('T')) == 0.0f, "Sparse kerning is not ordered");
+		check(font.getKerning(font.getGlyphIndex(extraCharacters[1]), font.getGlyphIndex(extraCharacters[1])) == 0.0f, "Missing sparse pair is not 0");
+		check(font.getGlyphIndex(L'\x4E2D') == Wolf::FontLayout::INVALID_GLYPH, "Unknown character found in the glyph table");
+	}
+
+	void checkLayout(const TestFontLayout& font, const std::vector<std::wstring>& strings)
+	{
+		std::vector<const std::wstring*> stringPointers;
+		for (const std::wstring& string : strings)
+			stringPointers.push_back(&string);
+
+		Wolf::FontLayout::GlyphLayout output;
+		font.layout(stringPointers.data(), stringPointers.size(), output);
+
+		check(output.firstGlyphs.size() == strings.size() + 1 && output.widths.size() == strings.size(), "Layout string count");
+		const float spread = static_cast<float>(font.getSDFSpread());
+		for (size_t i(0); i < strings.size() && i + 1 < output.firstGlyphs.size(); ++i)
+		{
+			const std::string name = "String " + std::to_string(i);
+			check(std::abs(output.widths[i] - font.getWidth(strings[i])) < 1e-4f, name + ": layout width differs from getWidth");
+
+			// Spaces and unknown characters don't produce quads
+			uint32_t glyphCount = 0;
+			for (const wchar_t character : strings[i])
+				if (font.getGlyphIndex(character) != Wolf::FontLayout::INVALID_GLYPH)
+					glyphCount++;
+			check(output.firstGlyphs[i + 1] - output.firstGlyphs[i] == glyphCount, name + ": glyph count");
+
+			for (uint32_t glyph(output.firstGlyphs[i]); glyph < output.firstGlyphs[i + 1]; ++glyph)
+			{
+				const Wolf::FontLayout::Glyph& fontGlyph = font.getGlyph(output.glyphIndices[glyph]);
+				check(std::abs(output.maxX[glyph] - output.minX[glyph] - static_cast<float>(fontGlyph.xSize) - 2.0f * spread) < 1e-4f, name + ": quad width");
+				check(std::abs(output.maxY[glyph] - output.minY[glyph] - static_cast<float>(fontGlyph.ySize) - 2.0f * spread) < 1e-4f, name + ": quad height");
+				check(glyph == output.firstGlyphs[i] || output.minX[glyph] > output.minX[glyph - 1], name + ": quads not advancing");
+			}
+		}
+	}
+
+	// Strings going through the whole glyph table, with a space every 8 characters
+	void measureLayoutTime(const TestFontLayout& font, const std::wstring& extraCharacters, uint32_t stringCount, uint32_t iterations)
+	{
+		std::wstring characters;
+		for (wchar_t c = Wolf::FontLayout::FIRST_CHARACTER; c <= Wolf::FontLayout::LAST_CHARACTER; ++c)
+			characters.push_back(c);
+		characters += extraCharacters;
+
+		std::vector<std::wstring> strings(stringCount);
+		std::vector<const std::wstring*> stringPointers(stringCount);
+		size_t characterIndex = 0;
+		for (uint32_t i(0); i < stringCount; ++i)
+		{
+			for (uint32_t j(0); j < 32; ++j)
+				strings[i].push_back(j % 8 == 7 ? L' ' : characters[characterIndex++ % characters.size()]);
+			stringPointers[i] = &strings[i];
+		}
+
+		Wolf::FontLayout::GlyphLayout output;
+		font.layout(stringPointers.data(), stringPointers.size(), output); // allocations
+		const auto start = std::chrono::steady_clock::now();
+		for (uint32_t i(0); i < iterations; ++i)
+			font.layout(stringPointers.data(), stringPointers.size(), output);
+		const double layoutTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+		std::cout << "Font layout: " << stringCount << " strings of 32 characters in " << layoutTime << " ms" << std::endl;
+	}
+}
+
+int runFontLayoutTests()
+{
+	const std::wstring extraCharacters = L"\xE9\xE8\xE0\xE7";
+	const TestFontLayout font(48, extraCharacters);
+
+	checkKerning(font, extraCharacters);
+	checkLayout(font, { L"AVATAR", L"To be", L"", L"   ", L"T\xE9\xE9 \xE7a", L"a\x4E2Db" });
+	measureLayoutTime(font, extraCharacters, 256, 64);
+
+	std::cout << (failureCount == 0 ? "All font layout checks passed" : std::to_string(failureCount) + " font layout checks failed") << std::endl;
+	return failureCount;
+}
@@ -0,0 +1,166 @@
+// CPU checks of the meshlet builder (see MeshletBuilder.h): limits, triangle coverage, bounds, normal cones, and build time of a reference mesh.
+// Returns the number of failed checks
+
+#include <iostream>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <array>
+#include <random>
+#include <string>
+
+#include "MeshletBuilder.h"
+
+namespace
+{
+	int failureCount = 0;
+
+	void check(bool condition, const std::string& message)
+	{
+		if (!condition)
+		{
+			std::cout << "FAILED: " << message << std::endl;
+			failureCount++;
+		}
+	}
+
+	// UV sphere, counter clockwise triangles seen from outside
+	void buildSphere(uint32_t stackCount, uint32_t sliceCount, std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices)
+	{
+		const float pi = 3.14159265f;
+		for (uint32_t stack(0); stack <= stackCount; ++stack)
+		{
+			const float phi = pi * static_cast<float>(stack) / static_cast<float>(stackCount);
+			for (uint32_t slice(0); slice <= sliceCount; ++slice)
+			{
+				const float theta = 2.0f * pi * static_cast<float>(slice) / static_cast<float>(sliceCount);
+				positions.emplace_back(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta));
+			}
+		}
+
+		for (uint32_t stack(0); stack < stackCount; ++stack)
+		{
+			for (uint32_t slice(0); slice < sliceCount; ++slice)
+			{
+				const uint32_t i0 = stack * (sliceCount + 1) + slice;
+				const uint32_t i1 = i0 + sliceCount + 1;
+				if (stack > 0)
+					indices.insert(indices.end(), { i0, i0 + 1, i1 });
+				if (stack < stackCount - 1)
+					indices.insert(indices.end(), { i0 + 1, i1 + 1, i1 });
+			}
+		}
+	}
+
+	// Same triangle and winding, whatever the first vertex
+	std::array<uint32_t, 3> canonicalTriangle(uint32_t i0, uint32_t i1, uint32_t i2)
+	{
+		if (i1 < i0 && i1 < i2)
+			return { i1, i2, i0 };
+		if (i2 < i0 && i2 < i1)
+			return { i2, i0, i1 };
+		return { i0, i1, i2 };
+	}
+
+	void checkMeshlets(const std::string& name, const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const Wolf::MeshletData meshletData = Wolf::buildMeshlets(positions, indices);
+		const double buildTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		const Wolf::MeshletStats stats = Wolf::computeMeshletStats(meshletData, positions.size());
+
+		std::vector<std::array<uint32_t, 3>> meshletTriangles;
+		std::mt19937 generator(42);
+		std::uniform_real_distribution<float> distribution(-4.0f, 4.0f);
+		for (size_t m(0); m < meshletData.meshlets.size(); ++m)
+		{
+			const Wolf::Meshlet& meshlet = meshletData.meshlets[m];
+			const std::string meshletName = name + " meshlet " + std::to_string(m);
+
+			// Limits and layout
+			check(meshlet.vertexCount > 0 && meshlet.vertexCount <= Wolf::MESHLET_MAX_VERTICES, meshletName + ": " + std::to_string(meshlet.vertexCount) + " vertices");
+			check(meshlet.triangleCount > 0 && meshlet.triangleCount <= Wolf::MESHLET_MAX_TRIANGLES, meshletName + ": " + std::to_string(meshlet.triangleCount) + " triangles");
+			check(meshlet.triangleOffset % 4 == 0, meshletName + ": triangle offset not aligned to 4 bytes");
+			check(meshlet.vertexOffset + meshlet.vertexCount <= meshletData.vertexIndices.size() &&
+				meshlet.triangleOffset + 3 * meshlet.triangleCount <= meshletData.triangleIndices.size(), meshletName + ": out of the meshlet data");
+
+			// Bounding sphere contains every vertex
+			const glm::vec3 center = glm::vec3(meshlet.boundingSphere);
+			const float radius = meshlet.boundingSphere.w;
+			for (uint32_t v(0); v < meshlet.vertexCount; ++v)
+			{
+				const uint32_t vertex = meshletData.vertexIndices[meshlet.vertexOffset + v];
+				check(vertex < positions.size(), meshletName + ": vertex index out of the mesh");
+				check(glm::length(positions[vertex] - center) <= radius * 1.0001f + 1e-6f, meshletName + ": vertex outside of the bounding sphere");
+			}
+
+			// Cone: normalized axis, cutoff in [0, 1]
+			const glm::vec3 axis = glm::vec3(meshlet.cone);
+			check(std::abs(glm::length(axis) - 1.0f) < 1e-3f, meshletName + ": cone axis not normalized");
+			check(meshlet.cone.w >= 0.0f && meshlet.cone.w <= 1.0f, meshletName + ": cone cutoff out of [0, 1]");
+
+			std::vector<std::array<glm::vec3, 3>> triangles;
+			for (uint32_t t(0); t < meshlet.triangleCount; ++t)
+			{
+				std::array<uint32_t, 3> triangle;
+				for (uint32_t k(0); k < 3; ++k)
+				{
+					const uint8_t localVertex = meshletData.triangleIndices[meshlet.triangleOffset + 3 * t + k];
+					check(localVertex < meshlet.vertexCount, meshletName + ": local vertex index out of the meshlet");
+					triangle[k] = meshletData.vertexIndices[meshlet.vertexOffset + std::min<uint32_t>(localVertex, meshlet.vertexCount - 1)];
+				}
+				meshletTriangles.push_back(canonicalTriangle(triangle[0], triangle[1], triangle[2]));
+				triangles.push_back({ positions[triangle[0]], positions[triangle[1]], positions[triangle[2]] });
+			}
+
+			// A meshlet culled by its cone must only contain back faces for that camera
+			for (int i(0); i < 16; ++i)
+			{
+				const glm::vec3 cameraPosition(distribution(generator), distribution(generator), distribution(generator));
+				if (!Wolf::isMeshletBackfacing(meshlet, cameraPosition))
+					continue;
+				for (const std::array<glm::vec3, 3>& triangle : triangles)
+				{
+					const glm::vec3 normal = glm::cross(triangle[1] - triangle[0], triangle[2] - triangle[0]);
+					check(glm::dot(triangle[0] - cameraPosition, normal) >= -1e-5f, meshletName + ": front face culled by the cone");
+				}
+			}
+		}
+
+		// Every triangle exactly once, winding kept
+		std::vector<std::array<uint32_t, 3>> meshTriangles;
+		for (size_t i(0); i < indices.size(); i += 3)
+			meshTriangles.push_back(canonicalTriangle(indices[i], indices[i + 1], indices[i + 2]));
+		std::sort(meshTriangles.begin(), meshTriangles.end());
+		std::sort(meshletTriangles.begin(), meshletTriangles.end());
+		check(meshTriangles == meshletTriangles, name + ": meshlet triangles differ from the mesh triangles");
+
+		std::cout << name << ": " << indices.size() / 3 << " triangles -> " << stats.meshletCount << " meshlets in " << buildTime << " ms (" << stats.averageVertexCount <<
+			" vertices, " << stats.averageTriangleCount << " triangles on average, vertex reuse " << stats.vertexReuse << ", " << stats.cullableConeCount << " cullable cones)" << std::endl;
+	}
+}
+
+int runMeshletTests()
+{
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+		buildSphere(8, 16, positions, indices);
+		checkMeshlets("Small sphere", positions, indices);
+	}
+
+	// Reference mesh for timings
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<uint32_t> indices;
+		buildSphere(256, 512, positions, indices);
+		checkMeshlets("Reference sphere", positions, indices);
+	}
+
+	// Degenerate inputs
+	check(Wolf::buildMeshlets({}, {}).meshlets.empty(), "Empty mesh produced meshlets");
+	check(Wolf::computeMeshletStats({}, 0).meshletCount == 0, "Empty meshlet data produced stats");
+
+	std::cout << (failureCount == 0 ? "All meshlet checks passed" : std::to_string(failureCount) + " meshlet checks failed") << std::endl;
+	return failureCount;
+}
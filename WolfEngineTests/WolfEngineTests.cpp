@@ -0,0 +1,13 @@
+// CPU tests of the engine parts that don't need a device, returns the number of failed checks
+
+int runMeshletTests();
+int runFontLayoutTests();
+
+int main()
+{
+	int failureCount = 0;
+	failureCount += runMeshletTests();
+	failureCount += runFontLayoutTests();
+
+	return failureCount;
+}